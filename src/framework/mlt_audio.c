@@ -774,3 +774,144 @@ mlt_channel_layout mlt_audio_channel_layout_default(int channels)
     }
     return mlt_channel_independent;
 }
+
+/** \brief Audio FIFO class
+ *
+ * A byte ring buffer for queuing interleaved audio between a producer of
+ * samples and a consumer that takes them in different sized chunks. Reads and
+ * writes copy at most two segments and never move the queued data. The buffer
+ * only grows when a write does not fit. It is not thread safe.
+ */
+
+struct mlt_audio_fifo_s
+{
+    uint8_t *buffer;
+    int size; /**< capacity of buffer in bytes */
+    int head; /**< offset of the oldest queued byte */
+    int used; /**< number of queued bytes */
+};
+
+/** Create a new audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param size the initial capacity in bytes, which may be 0
+ * \return a new audio FIFO or NULL on error
+ */
+
+mlt_audio_fifo mlt_audio_fifo_new(int size)
+{
+    mlt_audio_fifo self = calloc(1, sizeof(struct mlt_audio_fifo_s));
+    if (self && size > 0) {
+        self->buffer = malloc(size);
+        if (self->buffer)
+            self->size = size;
+    }
+    return self;
+}
+
+/** Destroy an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self the Audio FIFO object
+ */
+
+void mlt_audio_fifo_close(mlt_audio_fifo self)
+{
+    if (self) {
+        free(self->buffer);
+        free(self);
+    }
+}
+
+/** Get the number of queued bytes.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self the Audio FIFO object
+ * \return the number of bytes available to read
+ */
+
+int mlt_audio_fifo_used(mlt_audio_fifo self)
+{
+    return self ? self->used : 0;
+}
+
+/** Append data to an audio FIFO.
+ *
+ * The capacity is at least doubled when the data does not fit.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self the Audio FIFO object
+ * \param data the bytes to append
+ * \param size the number of bytes to append
+ * \return the number of bytes appended, which is less than size only if memory is exhausted
+ */
+
+int mlt_audio_fifo_write(mlt_audio_fifo self, const void *data, int size)
+{
+    if (!self || !data || size <= 0)
+        return 0;
+
+    if (self->size - self->used < size) {
+        int new_size = self->size * 2 > self->used + size ? self->size * 2 : self->used + size;
+        uint8_t *buffer = malloc(new_size);
+        if (!buffer)
+            return 0;
+        // Unwrap the queued data to the start of the new buffer.
+        int used = self->used;
+        mlt_audio_fifo_read(self, buffer, used);
+        free(self->buffer);
+        self->buffer = buffer;
+        self->size = new_size;
+        self->head = 0;
+        self->used = used;
+    }
+
+    int tail = (self->head + self->used) % self->size;
+    int first = self->size - tail < size ? self->size - tail : size;
+    memcpy(self->buffer + tail, data, first);
+    memcpy(self->buffer, (const uint8_t *) data + first, size - first);
+    self->used += size;
+
+    return size;
+}
+
+/** Take data from the front of an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self the Audio FIFO object
+ * \param data the buffer to receive the bytes, or NULL to discard them
+ * \param size the maximum number of bytes to take
+ * \return the number of bytes taken
+ */
+
+int mlt_audio_fifo_read(mlt_audio_fifo self, void *data, int size)
+{
+    if (!self || size <= 0)
+        return 0;
+    if (size > self->used)
+        size = self->used;
+
+    if (data && size > 0) {
+        int first = self->size - self->head < size ? self->size - self->head : size;
+        memcpy(data, self->buffer + self->head, first);
+        memcpy((uint8_t *) data + first, self->buffer, size - first);
+    }
+    self->used -= size;
+    self->head = self->used ? (self->head + size) % self->size : 0;
+
+    return size;
+}
+
+/** Discard all queued data in an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self the Audio FIFO object
+ */
+
+void mlt_audio_fifo_clear(mlt_audio_fifo self)
+{
+    if (self) {
+        self->head = 0;
+        self->used = 0;
+    }
+}
@@ -70,5 +70,11 @@ extern const char *mlt_audio_channel_layout_name(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_id(const char *name);
 extern int mlt_audio_channel_layout_channels(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_default(int channels);
+extern mlt_audio_fifo mlt_audio_fifo_new(int size);
+extern void mlt_audio_fifo_close(mlt_audio_fifo self);
+extern int mlt_audio_fifo_used(mlt_audio_fifo self);
+extern int mlt_audio_fifo_write(mlt_audio_fifo self, const void *data, int size);
+extern int mlt_audio_fifo_read(mlt_audio_fifo self, void *data, int size);
+extern void mlt_audio_fifo_clear(mlt_audio_fifo self);
 
 #endif
@@ -27,14 +27,16 @@
 #include "mlt_types.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
-
-/** the maximum number of data objects to cache per line */
-#define MAX_CACHE_SIZE (200)
+#include <time.h>
 
 /** the default number of data objects to cache per line */
 #define DEFAULT_CACHE_SIZE (4)
 
+/** the initial number of hash buckets, must be a power of two */
+#define INITIAL_BUCKET_COUNT (16)
+
 /** \brief Cache item class
  *
  * A cache item is a structure holding information about a data object including
@@ -56,13 +58,39 @@ typedef struct mlt_cache_item_s
     mlt_destructor destructor; /**< a function to release or destroy the cached data */
 } mlt_cache_item_s;
 
+/** \brief Cache entry
+ *
+ * An entry is a node in both the recency list and a hash bucket chain.
+ * For an object cache, \p object is the owner of the data. For a frame cache,
+ * \p object is the cached frame and \p position is its key.
+ */
+
+typedef struct cache_entry_s
+{
+    void *object;              /**< the owner object or the cached frame */
+    mlt_position position;     /**< the frame position (frame caches only) */
+    int64_t size;              /**< the number of bytes accounted to this entry */
+    time_t used;               /**< when the entry was last put or got */
+    struct cache_entry_s *prev; /**< the next less recently used entry */
+    struct cache_entry_s *next; /**< the next more recently used entry */
+    struct cache_entry_s *chain; /**< the next entry in the same hash bucket */
+} cache_entry_s, *cache_entry;
+
 /** \brief Cache class
  *
  * This is a utility class for implementing a Least Recently Used (LRU) cache
- * of data blobs indexed by the address of some other object (e.g., a service).
- * Instead of sorting and manipulating linked lists, it tries to be simple and
- * elegant by copying pointers between two arrays of fixed size to shuffle the
- * order of elements.
+ * of data blobs indexed by the address of some other object (e.g., a service)
+ * or, for a frame cache, by frame position. Entries are kept in a doubly linked
+ * list ordered by recency and indexed by a hash table so that lookup, update,
+ * and eviction are constant time regardless of the size of the cache.
+ *
+ * The cache is bounded by a number of entries and, optionally, by a number of
+ * bytes. The byte budget defaults to the value of the environment variable
+ * MLT_CACHE_BYTES and may be changed with mlt_cache_set_max_bytes(). An entry
+ * may also be released when it was not used for a number of seconds set with
+ * mlt_cache_set_max_idle(). Idle entries are released when the cache is next
+ * used, so a cache of open decoders does not keep files and threads of clips
+ * that are no longer played.
  *
  * This class is useful if you have a service that wants to cache something
  * somewhat large, but will not scale if there are many instances of the service.
@@ -80,15 +108,22 @@ typedef struct mlt_cache_item_s
 
 struct mlt_cache_s
 {
-    int count;      /**< the number of items currently in the cache */
-    int size;       /**< the maximum number of items permitted in the cache <= \p MAX_CACHE_SIZE */
-    int is_frames;  /**< indicates if this cache is used to cache frames */
-    void **current; /**< pointer to the current array of pointers */
-    void *A[MAX_CACHE_SIZE];
-    void *B[MAX_CACHE_SIZE];
+    int count;            /**< the number of items currently in the cache */
+    int size;             /**< the maximum number of items permitted in the cache */
+    int is_frames;        /**< indicates if this cache is used to cache frames */
+    cache_entry lru;      /**< the least recently used entry */
+    cache_entry mru;      /**< the most recently used entry */
+    cache_entry *buckets; /**< the hash table */
+    int bucket_count;     /**< the number of hash buckets, a power of two */
+    int64_t bytes;        /**< the number of bytes accounted to the current entries */
+    int64_t max_bytes;    /**< the maximum number of bytes or 0 for no limit */
+    int max_idle;         /**< the number of seconds to keep an unused entry or 0 for no limit */
+    int64_t hits;         /**< the number of successful lookups */
+    int64_t misses;       /**< the number of failed lookups */
+    int64_t evictions;    /**< the number of entries released to make room */
     pthread_mutex_t mutex;  /**< a mutex to prevent multi-threaded race conditions */
     mlt_properties active;  /**< a list of cache items some of which may no longer
-	                            be in \p current but to which there are
+	                            be in the recency list but to which there are
 	                            outstanding references */
     mlt_properties garbage; /**< a list cache items pending release. A cache item
 	                            is copied to this list when it is updated but there
@@ -131,7 +166,7 @@ static void cache_object_close(mlt_cache cache, void *object, void *data)
     // Fetch the cache item from the active list by its owner's address
     sprintf(key, "%p", object);
     mlt_cache_item item = mlt_properties_get_data(cache->active, key, NULL);
-    if (item) {
+    if (item && (!data || item->data == data)) {
         mlt_log(NULL,
                 MLT_LOG_DEBUG,
                 "%s: item %p object %p data %p refcount %d\n",
@@ -148,6 +183,7 @@ static void cache_object_close(mlt_cache cache, void *object, void *data)
             // Do not dispose of the cache item because it could likely be used
             // again.
         }
+        data = NULL;
     }
 
     // Fetch the cache item from the garbage collection by its data address
@@ -185,15 +221,209 @@ static void cache_object_close(mlt_cache cache, void *object, void *data)
 void mlt_cache_item_close(mlt_cache_item item)
 {
     if (item) {
-        pthread_mutex_lock(&item->cache->mutex);
-        cache_object_close(item->cache, item->object, item->data);
-        pthread_mutex_unlock(&item->cache->mutex);
+        // Closing may free a garbage-collected item, so do not touch it afterwards
+        mlt_cache cache = item->cache;
+        pthread_mutex_lock(&cache->mutex);
+        cache_object_close(cache, item->object, item->data);
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
+
+/** Compute the hash bucket for a cache entry key.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param object the owner object (object caches)
+ * \param position the frame position (frame caches)
+ * \return the index of the hash bucket
+ */
+
+static inline int cache_hash(mlt_cache cache, void *object, mlt_position position)
+{
+    uint64_t key = cache->is_frames ? (uint64_t) (int64_t) position
+                                    : (uint64_t) (uintptr_t) object >> 4;
+    key *= UINT64_C(0x9E3779B97F4A7C15);
+    return (int) (key >> 32) & (cache->bucket_count - 1);
+}
+
+/** Find the entry for a key.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param object the owner object (object caches)
+ * \param position the frame position (frame caches)
+ * \return the entry or NULL if not found
+ */
+
+static cache_entry cache_find(mlt_cache cache, void *object, mlt_position position)
+{
+    cache_entry entry = cache->buckets[cache_hash(cache, object, position)];
+    if (cache->is_frames) {
+        while (entry && entry->position != position)
+            entry = entry->chain;
+    } else {
+        while (entry && entry->object != object)
+            entry = entry->chain;
+    }
+    return entry;
+}
+
+/** Double the number of hash buckets and redistribute the entries.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ */
+
+static void cache_rehash(mlt_cache cache)
+{
+    int count = cache->bucket_count * 2;
+    cache_entry *buckets = calloc(count, sizeof(cache_entry));
+    if (!buckets)
+        return;
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+    for (cache_entry entry = cache->lru; entry; entry = entry->next) {
+        int i = cache_hash(cache, entry->object, entry->position);
+        entry->chain = buckets[i];
+        buckets[i] = entry;
+    }
+}
+
+/** Unlink an entry from the recency list.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry the entry to unlink
+ */
+
+static void cache_list_remove(mlt_cache cache, cache_entry entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->lru = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->mru = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+/** Append an entry to the most recently used end of the recency list.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry the entry to append
+ */
+
+static void cache_list_append(mlt_cache cache, cache_entry entry)
+{
+    entry->prev = cache->mru;
+    entry->next = NULL;
+    if (cache->mru)
+        cache->mru->next = entry;
+    else
+        cache->lru = entry;
+    cache->mru = entry;
+}
+
+/** Move an entry to the most recently used end of the recency list.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry the entry that was used
+ */
+
+static void cache_touch(mlt_cache cache, cache_entry entry)
+{
+    entry->used = time(NULL);
+    if (cache->mru != entry) {
+        cache_list_remove(cache, entry);
+        cache_list_append(cache, entry);
+    }
+}
+
+/** Add a new entry to the cache.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param object the owner object or cached frame
+ * \param position the frame position (frame caches)
+ * \param size the number of bytes to account to the entry
+ * \return the new entry or NULL on error
+ */
+
+static cache_entry cache_insert(mlt_cache cache, void *object, mlt_position position, int64_t size)
+{
+    cache_entry entry = calloc(1, sizeof(cache_entry_s));
+    if (entry) {
+        if (cache->count >= cache->bucket_count)
+            cache_rehash(cache);
+        entry->object = object;
+        entry->position = position;
+        entry->size = size;
+        entry->used = time(NULL);
+        int i = cache_hash(cache, object, position);
+        entry->chain = cache->buckets[i];
+        cache->buckets[i] = entry;
+        cache_list_append(cache, entry);
+        cache->count++;
+        cache->bytes += size;
+    }
+    return entry;
+}
+
+/** Remove an entry from the cache and release its object.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry the entry to remove
+ */
+
+static void cache_remove(mlt_cache cache, cache_entry entry)
+{
+    cache_entry *link = &cache->buckets[cache_hash(cache, entry->object, entry->position)];
+    while (*link && *link != entry)
+        link = &(*link)->chain;
+    if (*link)
+        *link = entry->chain;
+    cache_list_remove(cache, entry);
+    cache->count--;
+    cache->bytes -= entry->size;
+    cache_object_close(cache, entry->object, NULL);
+    free(entry);
+}
+
+/** Release least recently used entries until the cache is within its limits.
+ *
+ * The most recently used entry is always kept, even if it alone exceeds the
+ * byte budget or was idle for too long.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ */
+
+static void cache_evict(mlt_cache cache)
+{
+    time_t now = cache->max_idle > 0 ? time(NULL) : 0;
+
+    while (cache->lru
+           && (cache->count > cache->size
+               || (cache->lru != cache->mru
+                   && ((cache->max_bytes > 0 && cache->bytes > cache->max_bytes)
+                       || (cache->max_idle > 0 && now - cache->lru->used >= cache->max_idle))))) {
+        mlt_log(NULL, MLT_LOG_DEBUG, "%s: %p\n", __FUNCTION__, cache->lru->object);
+        cache_remove(cache, cache->lru);
+        cache->evictions++;
     }
 }
 
 /** Create a new cache.
  *
- * The default size is \p DEFAULT_CACHE_SIZE.
+ * The default size is \p DEFAULT_CACHE_SIZE. The default byte budget is read
+ * from the environment variable MLT_CACHE_BYTES; without it, the cache is only
+ * limited by its size.
  * \public \memberof mlt_cache_s
  * \return a new cache or NULL if there was an error
  */
@@ -203,7 +433,14 @@ mlt_cache mlt_cache_init()
     mlt_cache result = calloc(1, sizeof(struct mlt_cache_s));
     if (result) {
         result->size = DEFAULT_CACHE_SIZE;
-        result->current = result->A;
+        result->bucket_count = INITIAL_BUCKET_COUNT;
+        result->buckets = calloc(result->bucket_count, sizeof(cache_entry));
+        if (!result->buckets) {
+            free(result);
+            return NULL;
+        }
+        if (getenv("MLT_CACHE_BYTES"))
+            result->max_bytes = strtoll(getenv("MLT_CACHE_BYTES"), NULL, 10);
         pthread_mutex_init(&result->mutex, NULL);
         result->active = mlt_properties_new();
         result->garbage = mlt_properties_new();
@@ -213,8 +450,7 @@ mlt_cache mlt_cache_init()
 
 /** Set the number of items to cache.
  *
- * This must be called before using the cache. The size can not be more
- * than \p MAX_CACHE_SIZE.
+ * This must be called before using the cache.
  * \public \memberof mlt_cache_s
  * \param cache the cache to adjust
  * \param size the new size of the cache
@@ -222,7 +458,7 @@ mlt_cache mlt_cache_init()
 
 void mlt_cache_set_size(mlt_cache cache, int size)
 {
-    if (size <= MAX_CACHE_SIZE)
+    if (size >= 0)
         cache->size = size;
 }
 
@@ -238,6 +474,122 @@ int mlt_cache_get_size(mlt_cache cache)
     return cache->size;
 }
 
+/** Set the maximum number of bytes to cache.
+ *
+ * The byte budget applies in addition to the size. For a frame cache, an entry
+ * accounts for the bytes of its image, alpha, and audio. For other caches, it
+ * accounts for the size supplied to mlt_cache_put().
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to adjust
+ * \param bytes the new byte budget or 0 for no limit
+ */
+
+void mlt_cache_set_max_bytes(mlt_cache cache, int64_t bytes)
+{
+    if (cache && bytes >= 0) {
+        pthread_mutex_lock(&cache->mutex);
+        cache->max_bytes = bytes;
+        cache_evict(cache);
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
+
+/** Get the maximum number of bytes to cache.
+ *
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to check
+ * \return the byte budget or 0 for no limit
+ */
+
+int64_t mlt_cache_get_max_bytes(mlt_cache cache)
+{
+    return cache ? cache->max_bytes : 0;
+}
+
+/** Set the number of seconds after which an unused entry is released.
+ *
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to adjust
+ * \param seconds the new idle time or 0 for no limit
+ */
+
+void mlt_cache_set_max_idle(mlt_cache cache, int seconds)
+{
+    if (cache && seconds >= 0) {
+        pthread_mutex_lock(&cache->mutex);
+        cache->max_idle = seconds;
+        cache_evict(cache);
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
+
+/** Get the number of seconds after which an unused entry is released.
+ *
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to check
+ * \return the idle time or 0 for no limit
+ */
+
+int mlt_cache_get_max_idle(mlt_cache cache)
+{
+    return cache ? cache->max_idle : 0;
+}
+
+/** Set a statistics property unless it already has the value.
+ *
+ * \private \memberof mlt_cache_s
+ * \param properties the properties list to receive the statistic
+ * \param prefix a string to prepend to the name
+ * \param name the name of the statistic
+ * \param value the value of the statistic
+ */
+
+static void set_stat(mlt_properties properties, const char *prefix, const char *name, int64_t value)
+{
+    char key[256];
+
+    snprintf(key, sizeof(key), "%s%s", prefix, name);
+    if (!mlt_properties_exists(properties, key)
+        || mlt_properties_get_int64(properties, key) != value)
+        mlt_properties_set_int64(properties, key, value);
+}
+
+/** Get the usage statistics of a cache as properties.
+ *
+ * This sets the integer properties "hits", "misses", "evictions", "count", and
+ * "bytes", each name preceded by \p prefix. Properties that already have their
+ * value are left alone, so calling this for every frame only fires
+ * property-changed for the statistics that changed.
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to check
+ * \param properties the properties list to receive the statistics
+ * \param prefix a string to prepend to each property name or NULL for none
+ */
+
+void mlt_cache_get_stats(mlt_cache cache, mlt_properties properties, const char *prefix)
+{
+    if (!cache || !properties)
+        return;
+
+    int64_t hits, misses, evictions, count, bytes;
+    if (!prefix)
+        prefix = "";
+
+    pthread_mutex_lock(&cache->mutex);
+    hits = cache->hits;
+    misses = cache->misses;
+    evictions = cache->evictions;
+    count = cache->count;
+    bytes = cache->bytes;
+    pthread_mutex_unlock(&cache->mutex);
+
+    set_stat(properties, prefix, "hits", hits);
+    set_stat(properties, prefix, "misses", misses);
+    set_stat(properties, prefix, "evictions", evictions);
+    set_stat(properties, prefix, "count", count);
+    set_stat(properties, prefix, "bytes", bytes);
+}
+
 /** Destroy a cache.
  *
  * \public \memberof mlt_cache_s
@@ -247,11 +599,17 @@ int mlt_cache_get_size(mlt_cache cache)
 void mlt_cache_close(mlt_cache cache)
 {
     if (cache) {
-        while (cache->count--) {
-            void *object = cache->current[cache->count];
-            mlt_log(NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, cache->count, object);
-            cache_object_close(cache, object, NULL);
+        while (cache->mru) {
+            cache_entry entry = cache->mru;
+            mlt_log(NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, cache->count - 1, entry->object);
+            cache->mru = entry->prev;
+            cache->count--;
+            cache_object_close(cache, entry->object, NULL);
+            free(entry);
         }
+        free(cache->buckets);
+        for (int i = 0; i < mlt_properties_count(cache->active); i++)
+            free(mlt_properties_get_data_at(cache->active, i, NULL));
         mlt_properties_close(cache->active);
         mlt_properties_close(cache->garbage);
         pthread_mutex_destroy(&cache->mutex);
@@ -271,76 +629,27 @@ void mlt_cache_purge(mlt_cache cache, void *object)
     if (!cache)
         return;
     pthread_mutex_lock(&cache->mutex);
-    if (cache && object) {
-        int i, j;
-        void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-        for (i = 0, j = 0; i < cache->count; i++) {
-            void *o = cache->current[i];
-
-            if (o == object) {
-                cache_object_close(cache, o, NULL);
-            } else {
-                alt[j++] = o;
+    if (object) {
+        if (cache->is_frames) {
+            cache_entry entry = cache->lru;
+            while (entry) {
+                cache_entry next = entry->next;
+                if (entry->object == object)
+                    cache_remove(cache, entry);
+                entry = next;
             }
+        } else {
+            cache_entry entry = cache_find(cache, object, 0);
+            if (entry)
+                cache_remove(cache, entry);
         }
-        cache->count = j;
-        cache->current = alt;
     }
     pthread_mutex_unlock(&cache->mutex);
 }
 
-/** Shuffle the cache entries between the two arrays and return the cache entry for an object.
- *
- * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param object the object that owns the cached data
- * \return a cache entry if there was a hit or NULL for a miss
- */
-
-static void **shuffle_get_hit(mlt_cache cache, void *object)
-{
-    int i = cache->count;
-    int j = cache->count - 1;
-    void **hit = NULL;
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-    if (cache->count > 0 && cache->count < cache->size) {
-        // first determine if we have a hit
-        while (i-- && !hit) {
-            void **o = &cache->current[i];
-            if (*o == object)
-                hit = o;
-        }
-        // if there was no hit, we will not be shuffling out an entry
-        // and are still filling the cache
-        if (!hit)
-            ++j;
-        // reset these
-        i = cache->count;
-        hit = NULL;
-    }
-
-    // shuffle the existing entries to the alternate array
-    while (i--) {
-        void **o = &cache->current[i];
-
-        if (!hit && *o == object) {
-            hit = o;
-        } else if (j > 0) {
-            alt[--j] = *o;
-            // 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-        }
-    }
-    return hit;
-}
-
 /** Put a chunk of data in the cache.
  *
- * This function and mlt_cache_get() are not scalable with a large volume
- * of unique \p object parameter values. Therefore, it does not make sense
- * to use it for a frame/image cache using the frame position for \p object.
- * Instead, use mlt_cache_put_frame() for that.
+ * Use mlt_cache_put_frame() instead to cache frames by position.
  *
  * \public \memberof mlt_cache_s
  * \param cache a cache object
@@ -353,26 +662,19 @@ static void **shuffle_get_hit(mlt_cache cache, void *object)
 void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_destructor destructor)
 {
     pthread_mutex_lock(&cache->mutex);
-    void **hit = shuffle_get_hit(cache, object);
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
+    cache_entry entry = cache_find(cache, object, 0);
 
     // add the object to the cache
-    if (hit) {
+    if (entry) {
         // release the old data
-        cache_object_close(cache, *hit, NULL);
+        cache_object_close(cache, object, NULL);
         // the MRU end gets the updated data
-        hit = &alt[cache->count - 1];
-    } else if (cache->count < cache->size) {
-        // more room in cache, add it to MRU end
-        hit = &alt[cache->count++];
+        cache_touch(cache, entry);
+        cache->bytes += size - entry->size;
+        entry->size = size;
     } else {
-        // release the entry at the LRU end
-        cache_object_close(cache, cache->current[0], NULL);
-
-        // The MRU end gets the new item
-        hit = &alt[cache->count - 1];
+        entry = cache_insert(cache, object, 0, size);
     }
-    *hit = object;
     mlt_log(NULL,
             MLT_LOG_DEBUG,
             "%s: put %d = %p, %p\n",
@@ -385,29 +687,29 @@ void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_dest
     char key[19];
     sprintf(key, "%p", object);
     mlt_cache_item item = mlt_properties_get_data(cache->active, key, NULL);
+
+    // If updating the cache item but not all references are released, move
+    // the item to the garbage collection. Its holders keep the old data, and
+    // closing it releases that and not the new data.
+    if (item && item->refcount > 0 && item->data) {
+        char data_key[19];
+        mlt_log(NULL,
+                MLT_LOG_DEBUG,
+                "adding to garbage collection object %p data %p\n",
+                item->object,
+                item->data);
+        sprintf(data_key, "%p", item->data);
+        // We store in the garbage collection by data address, not the owner's!
+        mlt_properties_set_data(cache->garbage, data_key, item, 0, free, NULL);
+        item = NULL;
+    }
     if (!item) {
+        // The active list does not own its items, so replacing one does not free it
         item = calloc(1, sizeof(mlt_cache_item_s));
         if (item)
-            mlt_properties_set_data(cache->active, key, item, 0, free, NULL);
+            mlt_properties_set_data(cache->active, key, item, 0, NULL, NULL);
     }
     if (item) {
-        // If updating the cache item but not all references are released
-        // copy the item to the garbage collection.
-        if (item->refcount > 0 && item->data) {
-            mlt_cache_item orphan = calloc(1, sizeof(mlt_cache_item_s));
-            if (orphan) {
-                mlt_log(NULL,
-                        MLT_LOG_DEBUG,
-                        "adding to garbage collection object %p data %p\n",
-                        item->object,
-                        item->data);
-                *orphan = *item;
-                sprintf(key, "%p", orphan->data);
-                // We store in the garbage collection by data address, not the owner's!
-                mlt_properties_set_data(cache->garbage, key, orphan, 0, free, NULL);
-            }
-        }
-
         // Set/update the cache item
         item->cache = cache;
         item->object = object;
@@ -417,8 +719,8 @@ void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_dest
         item->refcount = 1;
     }
 
-    // swap the current array
-    cache->current = alt;
+    // release entries at the LRU end that no longer fit
+    cache_evict(cache);
     pthread_mutex_unlock(&cache->mutex);
 }
 
@@ -434,16 +736,14 @@ mlt_cache_item mlt_cache_get(mlt_cache cache, void *object)
 {
     mlt_cache_item result = NULL;
     pthread_mutex_lock(&cache->mutex);
-    void **hit = shuffle_get_hit(cache, object);
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
+    cache_entry entry = cache_find(cache, object, 0);
 
-    if (hit) {
-        // copy the hit to the MRU end
-        alt[cache->count - 1] = *hit;
-        hit = &alt[cache->count - 1];
+    if (entry) {
+        // move the hit to the MRU end
+        cache_touch(cache, entry);
 
         char key[19];
-        sprintf(key, "%p", *hit);
+        sprintf(key, "%p", object);
         result = mlt_properties_get_data(cache->active, key, NULL);
         if (result && result->data) {
             result->refcount++;
@@ -452,97 +752,81 @@ mlt_cache_item mlt_cache_get(mlt_cache cache, void *object)
                     "%s: get %d = %p, %p\n",
                     __FUNCTION__,
                     cache->count - 1,
-                    *hit,
+                    object,
                     result->data);
         }
-
-        // swap the current array
-        cache->current = alt;
+        cache->hits++;
+    } else {
+        cache->misses++;
     }
+    if (cache->max_idle > 0)
+        cache_evict(cache);
     pthread_mutex_unlock(&cache->mutex);
 
     return result;
 }
 
-/** Shuffle the cache entries between the two arrays and return the frame for a position.
+/** Compute the number of bytes held by a cached frame.
  *
  * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param position the position of the frame that you want
- * \return a frame if there was a hit or NULL for a miss
+ * \param frame a frame
+ * \return the number of bytes of image, alpha, and audio
  */
 
-static mlt_frame *shuffle_get_frame(mlt_cache cache, mlt_position position)
+static int64_t frame_size(mlt_frame frame)
 {
-    int i = cache->count;
-    int j = cache->count - 1;
-    mlt_frame *hit = NULL;
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
-
-    if (cache->count > 0 && cache->count < cache->size) {
-        // first determine if we have a hit
-        while (i-- && !hit) {
-            mlt_frame *o = (mlt_frame *) &cache->current[i];
-            if (mlt_frame_original_position(*o) == position)
-                hit = o;
-        }
-        // if there was no hit, we will not be shuffling out an entry
-        // and are still filling the cache
-        if (!hit)
-            ++j;
-        // reset these
-        i = cache->count;
-        hit = NULL;
-    }
-
-    // shuffle the existing entries to the alternate array
-    while (i--) {
-        mlt_frame *o = (mlt_frame *) &cache->current[i];
-
-        if (!hit && mlt_frame_original_position(*o) == position) {
-            hit = o;
-        } else if (j > 0) {
-            alt[--j] = *o;
-            // 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-        }
-    }
-    return hit;
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    int64_t result = 0;
+    int size = 0;
+
+    if (mlt_properties_get_data(properties, "image", &size))
+        result += size;
+    size = 0;
+    if (mlt_frame_get_alpha_size(frame, &size))
+        result += size;
+    size = 0;
+    if (mlt_properties_get_data(properties, "audio", &size))
+        result += size;
+    return result;
 }
 
 static void cache_put_frame(mlt_cache cache, mlt_frame frame, int audio, int image)
 {
+    mlt_position position = mlt_frame_original_position(frame);
+    mlt_frame copy = NULL;
+
+    // Copy the data before taking the lock.
+    if (audio && image) {
+        copy = mlt_frame_clone(frame, 1);
+    } else if (audio) {
+        copy = mlt_frame_clone_audio(frame, 1);
+    } else if (image) {
+        copy = mlt_frame_clone_image(frame, 1);
+    }
+    if (!copy)
+        return;
+    int64_t size = frame_size(copy);
+
     pthread_mutex_lock(&cache->mutex);
-    mlt_frame *hit = shuffle_get_frame(cache, mlt_frame_original_position(frame));
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
+    cache->is_frames = 1;
+    cache_entry entry = cache_find(cache, NULL, position);
 
     // add the frame to the cache
-    if (hit) {
+    if (entry) {
         // release the old data
-        mlt_frame_close(*hit);
+        mlt_frame_close(entry->object);
         // the MRU end gets the updated data
-        hit = &alt[cache->count - 1];
-    } else if (cache->count < cache->size) {
-        // more room in cache, add it to MRU end
-        hit = &alt[cache->count++];
-    } else {
-        // release the entry at the LRU end
-        mlt_frame_close(cache->current[0]);
-
-        // The MRU end gets the new item
-        hit = &alt[cache->count - 1];
-    }
-    if (audio && image) {
-        *hit = mlt_frame_clone(frame, 1);
-    } else if (audio) {
-        *hit = mlt_frame_clone_audio(frame, 1);
-    } else if (image) {
-        *hit = mlt_frame_clone_image(frame, 1);
+        cache_touch(cache, entry);
+        cache->bytes += size - entry->size;
+        entry->object = copy;
+        entry->size = size;
+    } else if (!cache_insert(cache, copy, position, size)) {
+        mlt_frame_close(copy);
     }
     mlt_log(NULL, MLT_LOG_DEBUG, "%s: put %d = %p\n", __FUNCTION__, cache->count - 1, frame);
 
-    // swap the current array
-    cache->current = (void **) alt;
-    cache->is_frames = 1;
+    // release frames at the LRU end that no longer fit
+    cache_evict(cache);
     pthread_mutex_unlock(&cache->mutex);
 }
 
@@ -614,22 +898,29 @@ void mlt_cache_put_frame_image(mlt_cache cache, mlt_frame frame)
 mlt_frame mlt_cache_get_frame(mlt_cache cache, mlt_position position)
 {
     mlt_frame result = NULL;
+    mlt_frame hit = NULL;
     pthread_mutex_lock(&cache->mutex);
-    mlt_frame *hit = shuffle_get_frame(cache, position);
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
+    cache_entry entry = cache->is_frames ? cache_find(cache, NULL, position) : NULL;
+
+    if (entry) {
+        // move the hit to the MRU end
+        cache_touch(cache, entry);
+        hit = entry->object;
+        // hold a reference so the copy can be made without the lock
+        mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(hit));
+        cache->hits++;
+        mlt_log(NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, cache->count - 1, hit);
+    } else {
+        cache->misses++;
+    }
+    if (cache->max_idle > 0)
+        cache_evict(cache);
+    pthread_mutex_unlock(&cache->mutex);
 
     if (hit) {
-        // copy the hit to the MRU end
-        alt[cache->count - 1] = *hit;
-        hit = &alt[cache->count - 1];
-
-        result = mlt_frame_clone(*hit, 1);
-        mlt_log(NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, cache->count - 1, *hit);
-
-        // swap the current array
-        cache->current = (void **) alt;
+        result = mlt_frame_clone(hit, 1);
+        mlt_frame_close(hit);
     }
-    pthread_mutex_unlock(&cache->mutex);
 
     return result;
 }
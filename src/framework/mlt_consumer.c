@@ -61,7 +61,7 @@ typedef struct
     pthread_cond_t queue_cond;
     pthread_mutex_t put_mutex;
     pthread_cond_t put_cond;
-    mlt_frame put;
+    mlt_deque put;
     int put_active;
     mlt_event event_listener;
     mlt_position position;
@@ -81,6 +81,9 @@ typedef struct
     int process_head;
     atomic_int started;
     pthread_t *threads; /**< used to deallocate all threads */
+    int parallel_audio;      /**< render audio on the worker threads */
+    mlt_deque audio_queue;   /**< frames waiting for audio in play order */
+    int audio_busy;          /**< a worker is rendering the audio of a frame */
 } consumer_private;
 
 static void mlt_consumer_property_changed(mlt_properties owner, mlt_consumer self, mlt_event_data);
@@ -171,7 +174,8 @@ int mlt_consumer_init(mlt_consumer self, void *child, mlt_profile profile)
                                                  "property-changed",
                                                  (mlt_listener) mlt_consumer_property_changed);
 
-        // Create the push mutex and condition
+        // Create the push queue, mutex and condition
+        priv->put = mlt_deque_init();
         pthread_mutex_init(&priv->put_mutex, NULL);
         pthread_cond_init(&priv->put_cond, NULL);
 
@@ -482,7 +486,8 @@ int mlt_consumer_start(mlt_consumer self)
 
     // Just to make sure nothing is hanging around...
     pthread_mutex_lock(&priv->put_mutex);
-    priv->put = NULL;
+    while (mlt_deque_count(priv->put))
+        mlt_frame_close(mlt_deque_pop_front(priv->put));
     priv->put_active = 1;
     pthread_mutex_unlock(&priv->put_mutex);
 
@@ -566,7 +571,8 @@ int mlt_consumer_start(mlt_consumer self)
 
 /** An alternative method to feed frames into the consumer.
  *
- * Only valid if the consumer itself is not connected.
+ * Only valid if the consumer itself is not connected. This blocks while the
+ * consumer already holds put_buffer frames that it has not taken.
  *
  * \public \memberof mlt_consumer_s
  * \param self a consumer
@@ -585,18 +591,21 @@ int mlt_consumer_put_frame(mlt_consumer self, mlt_frame frame)
         struct timeval now;
         struct timespec tm;
         consumer_private *priv = self->local;
+        int put_buffer = mlt_properties_get_int(MLT_CONSUMER_PROPERTIES(self), "put_buffer");
+
+        put_buffer = MAX(put_buffer, 1);
 
         mlt_properties_set_int(MLT_CONSUMER_PROPERTIES(self), "put_pending", 1);
         pthread_mutex_lock(&priv->put_mutex);
-        while (priv->put_active && priv->put != NULL) {
+        while (priv->put_active && mlt_deque_count(priv->put) >= put_buffer) {
             gettimeofday(&now, NULL);
             tm.tv_sec = now.tv_sec + 1;
             tm.tv_nsec = now.tv_usec * 1000;
             pthread_cond_timedwait(&priv->put_cond, &priv->put_mutex, &tm);
         }
         mlt_properties_set_int(MLT_CONSUMER_PROPERTIES(self), "put_pending", 0);
-        if (priv->put_active && priv->put == NULL)
-            priv->put = frame;
+        if (priv->put_active)
+            mlt_deque_push_back(priv->put, frame);
         else
             mlt_frame_close(frame);
         pthread_cond_broadcast(&priv->put_cond);
@@ -633,14 +642,13 @@ mlt_frame mlt_consumer_get_frame(mlt_consumer self)
         consumer_private *priv = self->local;
 
         pthread_mutex_lock(&priv->put_mutex);
-        while (priv->put_active && priv->put == NULL) {
+        while (priv->put_active && !mlt_deque_count(priv->put)) {
             gettimeofday(&now, NULL);
             tm.tv_sec = now.tv_sec + 1;
             tm.tv_nsec = now.tv_usec * 1000;
             pthread_cond_timedwait(&priv->put_cond, &priv->put_mutex, &tm);
         }
-        frame = priv->put;
-        priv->put = NULL;
+        frame = mlt_deque_pop_front(priv->put);
         pthread_cond_broadcast(&priv->put_cond);
         pthread_mutex_unlock(&priv->put_mutex);
         if (frame != NULL)
@@ -996,6 +1004,92 @@ static inline int first_unprocessed_frame(mlt_consumer self)
     return index;
 }
 
+/** Check if the image of a frame in the work queue may be rendered.
+ *
+ * With parallel_audio, a frame whose audio is still queued or rendering must
+ * wait for it unless parallel_audio is 2, because image filters may read what
+ * the audio filters put on the frame. The caller must hold the queue mutex.
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param index an index into the queue
+ * \return true if the frame exists and its image may be rendered now
+ */
+
+static inline int worker_image_ready(mlt_consumer self, int index)
+{
+    consumer_private *priv = self->local;
+    if (index >= mlt_deque_count(priv->queue))
+        return 0;
+    if (!priv->audio_queue || priv->parallel_audio == 2)
+        return 1;
+    mlt_frame frame = mlt_deque_peek(priv->queue, index);
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    return !mlt_properties_get_int(properties, "_consumer_audio_queued")
+           || mlt_properties_get_int(properties, "_consumer_audio_rendered");
+}
+
+/** Check if there is a frame whose audio can be rendered now.
+ *
+ * The caller must hold the queue mutex.
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if audio is ready to be rendered
+ */
+
+static inline int audio_work_available(mlt_consumer self)
+{
+    consumer_private *priv = self->local;
+    return priv->audio_queue && !priv->audio_busy && mlt_deque_count(priv->audio_queue) > 0;
+}
+
+/** Render the audio of the next frame waiting for audio.
+ *
+ * Audio is rendered one frame at a time in play order because producers and
+ * audio filters carry state from one frame's samples to the next. What runs in
+ * parallel is the audio of one frame with the images of others and with the
+ * thread feeding the queue. The caller must hold the queue mutex, which is
+ * released while rendering.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if audio was rendered
+ */
+
+static int worker_render_audio(mlt_consumer self)
+{
+    consumer_private *priv = self->local;
+
+    if (!audio_work_available(self))
+        return 0;
+
+    mlt_frame frame = mlt_deque_pop_front(priv->audio_queue);
+    priv->audio_busy = 1;
+    pthread_mutex_unlock(&priv->queue_mutex);
+
+    void *audio = NULL;
+    int samples = mlt_audio_calculate_frame_samples(priv->fps,
+                                                    priv->frequency,
+                                                    priv->aud_counter++);
+    mlt_frame_get_audio(frame,
+                        &audio,
+                        &priv->audio_format,
+                        &priv->frequency,
+                        &priv->channels,
+                        &samples);
+
+    // Tell the thread handing out frames that this one has its audio.
+    pthread_mutex_lock(&priv->done_mutex);
+    mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "_consumer_audio_rendered", 1);
+    pthread_cond_broadcast(&priv->done_cond);
+    pthread_mutex_unlock(&priv->done_mutex);
+    mlt_frame_close(frame);
+
+    pthread_mutex_lock(&priv->queue_mutex);
+    priv->audio_busy = 0;
+    pthread_cond_broadcast(&priv->queue_cond);
+    return 1;
+}
+
 /** The worker thread procedure for parallel processing frames.
  *
  * \private \memberof mlt_consumer_s
@@ -1032,10 +1126,16 @@ static void *consumer_worker_thread(void *arg)
 
     // Continue to read ahead
     while (priv->ahead) {
-        // Get the next unprocessed frame from the work queue
+        // Audio is the serial part of the pipeline, so it goes first
         pthread_mutex_lock(&priv->queue_mutex);
+        if (worker_render_audio(self)) {
+            pthread_mutex_unlock(&priv->queue_mutex);
+            continue;
+        }
+
+        // Get the next unprocessed frame from the work queue
         int index = first_unprocessed_frame(self);
-        while (priv->ahead && index >= mlt_deque_count(priv->queue)) {
+        while (priv->ahead && !worker_image_ready(self, index) && !audio_work_available(self)) {
             mlt_log_debug(MLT_CONSUMER_SERVICE(self),
                           "waiting in worker index = %d queue count = %d\n",
                           index,
@@ -1043,6 +1143,11 @@ static void *consumer_worker_thread(void *arg)
             pthread_cond_wait(&priv->queue_cond, &priv->queue_mutex);
             index = first_unprocessed_frame(self);
         }
+        if (!worker_image_ready(self, index)) {
+            // Woken for audio or to stop
+            pthread_mutex_unlock(&priv->queue_mutex);
+            continue;
+        }
 
         // Mark the frame for processing
         frame = mlt_deque_peek(priv->queue, index);
@@ -1158,6 +1263,9 @@ static void consumer_work_start(mlt_consumer self)
     // Create the queues
     priv->queue = mlt_deque_init();
     priv->worker_threads = mlt_deque_init();
+    priv->parallel_audio = mlt_properties_get_int(MLT_CONSUMER_PROPERTIES(self), "parallel_audio");
+    priv->audio_queue = priv->parallel_audio ? mlt_deque_init() : NULL;
+    priv->audio_busy = 0;
 
     // Create the mutexes
     pthread_mutex_init(&priv->queue_mutex, NULL);
@@ -1292,10 +1400,15 @@ static void consumer_work_stop(mlt_consumer self)
         // Wipe the queues
         while (mlt_deque_count(priv->queue))
             mlt_frame_close(mlt_deque_pop_back(priv->queue));
+        while (priv->audio_queue && mlt_deque_count(priv->audio_queue))
+            mlt_frame_close(mlt_deque_pop_back(priv->audio_queue));
 
         // Close the queues
         mlt_deque_close(priv->queue);
         mlt_deque_close(priv->worker_threads);
+        if (priv->audio_queue)
+            mlt_deque_close(priv->audio_queue);
+        priv->audio_queue = NULL;
 
         mlt_events_fire(MLT_CONSUMER_PROPERTIES(self),
                         "consumer-thread-stopped",
@@ -1315,10 +1428,8 @@ void mlt_consumer_purge(mlt_consumer self)
         consumer_private *priv = self->local;
 
         pthread_mutex_lock(&priv->put_mutex);
-        if (priv->put) {
-            mlt_frame_close(priv->put);
-            priv->put = NULL;
-        }
+        while (mlt_deque_count(priv->put))
+            mlt_frame_close(mlt_deque_pop_front(priv->put));
         pthread_cond_broadcast(&priv->put_cond);
         pthread_mutex_unlock(&priv->put_mutex);
 
@@ -1330,6 +1441,8 @@ void mlt_consumer_purge(mlt_consumer self)
 
         while (priv->started && mlt_deque_count(priv->queue))
             mlt_frame_close(mlt_deque_pop_back(priv->queue));
+        while (priv->started && priv->audio_queue && mlt_deque_count(priv->audio_queue))
+            mlt_frame_close(mlt_deque_pop_back(priv->audio_queue));
 
         if (priv->started && priv->real_time) {
             priv->is_purge = 1;
@@ -1343,15 +1456,85 @@ void mlt_consumer_purge(mlt_consumer self)
         }
 
         pthread_mutex_lock(&priv->put_mutex);
-        if (priv->put) {
-            mlt_frame_close(priv->put);
-            priv->put = NULL;
-        }
+        while (mlt_deque_count(priv->put))
+            mlt_frame_close(mlt_deque_pop_front(priv->put));
         pthread_cond_broadcast(&priv->put_cond);
         pthread_mutex_unlock(&priv->put_mutex);
     }
 }
 
+/** Add a frame to the work queue.
+ *
+ * Without parallel_audio, the audio is rendered here on the calling thread.
+ * Otherwise, the frame also goes into the audio queue for the workers.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame the frame to queue
+ * \param audio_off true if audio is not needed
+ */
+
+static void worker_queue_frame(mlt_consumer self, mlt_frame frame, int audio_off)
+{
+    consumer_private *priv = self->local;
+
+    // Process the audio
+    if (!audio_off && !priv->audio_queue) {
+        void *audio = NULL;
+        int samples = mlt_audio_calculate_frame_samples(priv->fps,
+                                                        priv->frequency,
+                                                        priv->aud_counter++);
+        mlt_frame_get_audio(frame,
+                            &audio,
+                            &priv->audio_format,
+                            &priv->frequency,
+                            &priv->channels,
+                            &samples);
+    }
+    pthread_mutex_lock(&priv->queue_mutex);
+    mlt_deque_push_back(priv->queue, frame);
+    if (!audio_off && priv->audio_queue) {
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "_consumer_audio_queued", 1);
+        mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(frame));
+        mlt_deque_push_back(priv->audio_queue, frame);
+        pthread_cond_broadcast(&priv->queue_cond);
+    } else {
+        pthread_cond_signal(&priv->queue_cond);
+    }
+    pthread_mutex_unlock(&priv->queue_mutex);
+}
+
+/** Wait until the audio of a frame has been rendered.
+ *
+ * This is the reordering stage for parallel_audio: frames are handed out in
+ * play order only once their audio is complete. If no worker has taken the
+ * audio yet, render it on this thread instead of waiting.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame the frame at the head of the queue
+ */
+
+static void worker_wait_for_audio(mlt_consumer self, mlt_frame frame)
+{
+    consumer_private *priv = self->local;
+    mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+
+    while (priv->ahead && !priv->is_purge
+           && !mlt_properties_get_int(frame_properties, "_consumer_audio_rendered")) {
+        pthread_mutex_lock(&priv->queue_mutex);
+        int rendered = worker_render_audio(self);
+        pthread_mutex_unlock(&priv->queue_mutex);
+        if (!rendered) {
+            pthread_mutex_lock(&priv->done_mutex);
+            if (priv->ahead && !priv->is_purge
+                && !mlt_properties_get_int(frame_properties, "_consumer_audio_rendered"))
+                pthread_cond_wait(&priv->done_cond, &priv->done_mutex);
+            pthread_mutex_unlock(&priv->done_mutex);
+        }
+    }
+}
+
 /** Use multiple worker threads and a work queue.
  */
 
@@ -1362,8 +1545,6 @@ static mlt_frame worker_get_frame(mlt_consumer self, mlt_properties properties)
     consumer_private *priv = self->local;
     int threads = abs(priv->real_time);
     int audio_off = mlt_properties_get_int(properties, "audio_off");
-    int samples = 0;
-    void *audio = NULL;
     int buffer = mlt_properties_get_int(properties, "_buffer");
     buffer = buffer > 0 ? buffer : mlt_properties_get_int(properties, "buffer");
     // This is a heuristic to determine a suitable minimum buffer size for the number of threads.
@@ -1384,22 +1565,7 @@ static mlt_frame worker_get_frame(mlt_consumer self, mlt_properties properties)
         while (priv->ahead && i--) {
             frame = mlt_consumer_get_frame(self);
             if (frame) {
-                // Process the audio
-                if (!audio_off) {
-                    samples = mlt_audio_calculate_frame_samples(priv->fps,
-                                                                priv->frequency,
-                                                                priv->aud_counter++);
-                    mlt_frame_get_audio(frame,
-                                        &audio,
-                                        &priv->audio_format,
-                                        &priv->frequency,
-                                        &priv->channels,
-                                        &samples);
-                }
-                pthread_mutex_lock(&priv->queue_mutex);
-                mlt_deque_push_back(priv->queue, frame);
-                pthread_cond_signal(&priv->queue_cond);
-                pthread_mutex_unlock(&priv->queue_mutex);
+                worker_queue_frame(self, frame, audio_off);
                 priv->speed = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "_speed");
                 buffer = (priv->speed == 0) ? 1 : buffer;
             }
@@ -1421,22 +1587,7 @@ static mlt_frame worker_get_frame(mlt_consumer self, mlt_properties properties)
     while (priv->ahead && mlt_deque_count(priv->queue) < buffer) {
         frame = mlt_consumer_get_frame(self);
         if (frame) {
-            // Process the audio
-            if (!audio_off) {
-                samples = mlt_audio_calculate_frame_samples(priv->fps,
-                                                            priv->frequency,
-                                                            priv->aud_counter++);
-                mlt_frame_get_audio(frame,
-                                    &audio,
-                                    &priv->audio_format,
-                                    &priv->frequency,
-                                    &priv->channels,
-                                    &samples);
-            }
-            pthread_mutex_lock(&priv->queue_mutex);
-            mlt_deque_push_back(priv->queue, frame);
-            pthread_cond_signal(&priv->queue_cond);
-            pthread_mutex_unlock(&priv->queue_mutex);
+            worker_queue_frame(self, frame, audio_off);
             priv->speed = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "_speed");
             buffer = (priv->speed == 0) ? 1 : buffer;
         }
@@ -1452,6 +1603,19 @@ static mlt_frame worker_get_frame(mlt_consumer self, mlt_properties properties)
         pthread_mutex_unlock(&priv->done_mutex);
     }
 
+    // Wait for the audio if rendered by the workers.
+    if (priv->audio_queue && !audio_off) {
+        pthread_mutex_lock(&priv->queue_mutex);
+        frame = mlt_deque_peek_front(priv->queue);
+        if (frame)
+            mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(frame));
+        pthread_mutex_unlock(&priv->queue_mutex);
+        if (frame) {
+            worker_wait_for_audio(self, frame);
+            mlt_frame_close(frame);
+        }
+    }
+
     // Get the frame from the queue.
     pthread_mutex_lock(&priv->queue_mutex);
     frame = mlt_deque_pop_front(priv->queue);
@@ -1710,7 +1874,10 @@ void mlt_consumer_close(mlt_consumer self)
             // Make sure it only gets called once
             self->parent.close = NULL;
 
-            // Destroy the push mutex and condition
+            // Destroy the push queue, mutex and condition
+            while (mlt_deque_count(priv->put))
+                mlt_frame_close(mlt_deque_pop_front(priv->put));
+            mlt_deque_close(priv->put);
             pthread_mutex_destroy(&priv->put_mutex);
             pthread_cond_destroy(&priv->put_cond);
 
@@ -47,6 +47,14 @@
  * other options include: mono, stereo, 5.1, 7.1, etc.
  * \properties \em real_time the asynchronous behavior: 1 (default) for asynchronous
  * with frame dropping, -1 for asynchronous without frame dropping, 0 to disable (synchronous)
+ * \properties \em parallel_audio when real_time is greater than 1 or less than -1, set this to
+ * render audio on the worker threads instead of the thread that feeds them. Audio is still
+ * rendered one frame at a time in order, but in parallel with the images of earlier frames.
+ * A frame's image is not rendered until its audio is done, because filters such as
+ * audiowaveform and audiolevel read what get_audio left on the frame. Set this to 2 if no
+ * image depends on audio, to let a frame's image render at the same time as its audio.
+ * \properties \em put_buffer the number of frames mlt_consumer_put_frame() may queue before it
+ * blocks, defaults to 1
  * \properties \em test_card the name of a resource to use as the test card, defaults to
  * environment variable MLT_TEST_CARD. If undefined, the hard-coded default test card is
  * white silence. A test card is what appears when nothing is produced.
@@ -63,6 +63,29 @@ mlt_deque mlt_deque_init()
     return self;
 }
 
+/** Create a copy of a deque.
+ *
+ * The items are copied as they are, whatever their type.
+ *
+ * \public \memberof mlt_deque_s
+ * \param self a deque
+ * \return a new deque
+ */
+
+mlt_deque mlt_deque_clone(mlt_deque self)
+{
+    mlt_deque clone = mlt_deque_init();
+    if (clone && self && self->count > 0) {
+        clone->list = malloc(sizeof(deque_entry) * self->count);
+        if (clone->list) {
+            memcpy(clone->list, self->list, sizeof(deque_entry) * self->count);
+            clone->size = self->count;
+            clone->count = self->count;
+        }
+    }
+    return clone;
+}
+
 /** Return the number of items in the deque.
  *
  * \public \memberof mlt_deque_s
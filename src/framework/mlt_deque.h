@@ -35,6 +35,7 @@
 typedef int (*mlt_deque_compare)(void *a, void *b);
 
 extern mlt_deque mlt_deque_init();
+extern mlt_deque mlt_deque_clone(mlt_deque self);
 extern int mlt_deque_count(mlt_deque self);
 extern int mlt_deque_push_back(mlt_deque self, void *item);
 extern void *mlt_deque_pop_back(mlt_deque self);
@@ -598,6 +598,13 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int inde
         mlt_properties_set_double(properties, "_speed", speed);
         mlt_frame_set_position(*frame, position);
         mlt_properties_set_int(properties, "hide", hide);
+
+        // Let the tractor record the stacks of the track to render them ahead
+        void (*render)(mlt_producer, mlt_frame, int) = mlt_properties_get_data(producer_properties,
+                                                                              "_track_render",
+                                                                              NULL);
+        if (render != NULL && hide != 3)
+            render(parent, *frame, index);
     } else {
         // Generate a test frame
         *frame = mlt_frame_init(MLT_PRODUCER_SERVICE(parent));
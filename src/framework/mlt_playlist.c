@@ -29,10 +29,14 @@
 #include "mlt_tractor.h"
 #include "mlt_transition.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** the maximum number of producers prefetched for one entry */
+#define PREFETCH_MAX (4)
+
 /** \brief Virtual playlist entry used by mlt_playlist_s
 */
 
@@ -48,6 +52,19 @@ struct playlist_entry_s
     int preservation_hack;
 };
 
+/** \brief Background prefetch of the next clip used by mlt_playlist_s
+*/
+
+struct playlist_prefetch_s
+{
+    pthread_t thread;                     /**< the thread that decodes the producers */
+    int running;                          /**< whether the thread must be joined */
+    mlt_producer entry;                   /**< the producer of the entry that was prefetched */
+    mlt_producer producers[PREFETCH_MAX]; /**< the parents to decode, each with a reference */
+    mlt_position in[PREFETCH_MAX];        /**< the in point of the cut of each parent */
+    int count;                            /**< the number of producers */
+};
+
 /* Forward declarations
 */
 
@@ -184,6 +201,16 @@ static int mlt_playlist_virtual_refresh(mlt_playlist self)
     int i = 0;
     mlt_position frame_count = 0;
 
+    // Make room for the start positions used by mlt_playlist_find()
+    if (self->count >= self->starts_size) {
+        mlt_position *starts = realloc(self->starts, (self->size + 1) * sizeof(*starts));
+        if (starts) {
+            self->starts = starts;
+            self->starts_size = self->size + 1;
+        }
+    }
+    int indexed = self->count < self->starts_size;
+
     for (i = 0; i < self->count; i++) {
         // Get the producer
         mlt_producer producer = self->list[i]->producer;
@@ -214,8 +241,15 @@ static int mlt_playlist_virtual_refresh(mlt_playlist self)
                                      * self->list[i]->repeat;
 
         // Update the frame_count for self clip
+        if (indexed)
+            self->starts[i] = frame_count;
+        if (self->list[i]->frame_count < 0)
+            indexed = 0;
         frame_count += self->list[i]->frame_count;
     }
+    if (indexed)
+        self->starts[self->count] = frame_count;
+    self->starts_count = indexed ? self->count + 1 : 0;
 
     // Refresh all properties
     mlt_events_block(properties, properties);
@@ -348,6 +382,44 @@ static int mlt_playlist_virtual_append(mlt_playlist self,
     return mlt_playlist_virtual_refresh(self);
 }
 
+/** Find the entry that plays at a position.
+ *
+ * This uses a binary search on the start positions computed by
+ * mlt_playlist_virtual_refresh() and falls back to walking the list while
+ * they are out of date.
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param[in, out] position the time at which to find the entry, returns the time relative to the entry's starting point
+ * \return the index of the playlist entry or the number of entries if the position is past the end
+ */
+
+static int mlt_playlist_find(mlt_playlist self, mlt_position *position)
+{
+    int i = 0;
+
+    if (self->starts_count == self->count + 1) {
+        // Find the first entry that ends after the position, which skips 0 length entries
+        int high = self->count;
+        while (i < high) {
+            int middle = i + (high - i) / 2;
+            if (*position < self->starts[middle + 1])
+                high = middle;
+            else
+                i = middle + 1;
+        }
+        if (*position >= 0)
+            *position -= self->starts[i];
+    } else {
+        for (i = 0; i < self->count; i++) {
+            if (*position < self->list[i]->frame_count)
+                break;
+            *position -= self->list[i]->frame_count;
+        }
+    }
+
+    return i;
+}
+
 /** Locate a producer by index.
  *
  * \private \memberof mlt_playlist_s
@@ -365,25 +437,163 @@ static mlt_producer mlt_playlist_locate(mlt_playlist self,
 {
     // Default producer to NULL
     mlt_producer producer = NULL;
+    mlt_position start = *position;
 
-    // Loop for each producer until found
-    for (*clip = 0; *clip < self->count; *clip += 1) {
-        // Increment the total
+    // Note that 0 length clips get skipped automatically
+    *clip = mlt_playlist_find(self, position);
+
+    // The total is the start of the clip plus its length
+    *total += start - *position;
+    if (*clip < self->count) {
         *total += self->list[*clip]->frame_count;
+        producer = self->list[*clip]->producer;
+    }
 
-        // Check if the position indicates that we have found the clip
-        // Note that 0 length clips get skipped automatically
-        if (*position < self->list[*clip]->frame_count) {
-            // Found it, now break
-            producer = self->list[*clip]->producer;
-            break;
-        } else {
-            // Decrement position by length of self entry
-            *position -= self->list[*clip]->frame_count;
+    return producer;
+}
+
+/** Get the producers that provide the frames of a playlist entry.
+ *
+ * A mix provides the frames of its tracks.
+ * \private \memberof mlt_playlist_s
+ * \param producer the producer of an entry
+ * \param[out] producers the producers
+ * \return the number of producers
+ */
+
+static int entry_producers(mlt_producer producer, mlt_producer producers[PREFETCH_MAX])
+{
+    mlt_producer parent = mlt_producer_cut_parent(producer);
+    mlt_tractor tractor = parent ? mlt_properties_get_data(MLT_PRODUCER_PROPERTIES(parent),
+                                                           "mlt_mix",
+                                                           NULL)
+                                 : NULL;
+    int count = 0;
+
+    if (tractor) {
+        mlt_multitrack multitrack = mlt_tractor_multitrack(tractor);
+        int i;
+        for (i = 0; i < mlt_multitrack_count(multitrack) && count < PREFETCH_MAX; i++) {
+            mlt_producer track = mlt_multitrack_track(multitrack, i);
+            if (track)
+                producers[count++] = track;
         }
+    } else if (producer) {
+        producers[count++] = producer;
     }
+    return count;
+}
 
-    return producer;
+/** Decode the first frame of each prefetched producer.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param arg the prefetch state
+ * \return NULL
+ */
+
+static void *prefetch_worker(void *arg)
+{
+    playlist_prefetch *prefetch = arg;
+    int i;
+
+    for (i = 0; i < prefetch->count; i++) {
+        mlt_producer producer = prefetch->producers[i];
+        mlt_frame frame = NULL;
+
+        mlt_producer_seek(producer, prefetch->in[i]);
+        if (!mlt_service_get_frame(MLT_PRODUCER_SERVICE(producer), &frame, 0) && frame) {
+            uint8_t *image = NULL;
+            mlt_image_format format = mlt_image_none;
+            int width = 0;
+            int height = 0;
+            mlt_frame_get_image(frame, &image, &format, &width, &height, 0);
+        }
+        mlt_frame_close(frame);
+    }
+    return NULL;
+}
+
+/** Wait for the prefetch thread and release its producers.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ */
+
+static void prefetch_join(mlt_playlist self)
+{
+    playlist_prefetch *prefetch = self->prefetch;
+
+    if (prefetch && prefetch->running) {
+        pthread_join(prefetch->thread, NULL);
+        prefetch->running = 0;
+        while (prefetch->count > 0)
+            mlt_producer_close(prefetch->producers[--prefetch->count]);
+    }
+}
+
+/** Wait for the prefetch of an entry before using its producer.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param producer the producer of the entry about to be used
+ */
+
+static void prefetch_wait(mlt_playlist self, mlt_producer producer)
+{
+    if (self->prefetch && producer && self->prefetch->entry == producer) {
+        prefetch_join(self);
+        // Allow the entry to be prefetched again after a seek
+        self->prefetch->entry = NULL;
+    }
+}
+
+/** Start decoding the first frame of the next entry on a background thread.
+ *
+ * Only the parent of each cut is decoded so that the filters of the cut do not
+ * run twice. A parent that is referenced by anything other than the cut, such
+ * as another cut on this or another track, is skipped because decoding it would
+ * seek away from the position its other users expect.
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param clip the index of the current entry
+ */
+
+static void prefetch_start(mlt_playlist self, int clip)
+{
+    playlist_prefetch *prefetch = self->prefetch;
+    mlt_producer next = self->list[clip + 1]->producer;
+    mlt_producer producers[PREFETCH_MAX];
+    int count, i;
+
+    if (!next || mlt_producer_is_blank(next) || (prefetch && prefetch->entry == next))
+        return;
+    if (!prefetch) {
+        prefetch = self->prefetch = calloc(1, sizeof(*prefetch));
+        if (!prefetch)
+            return;
+    }
+    prefetch_join(self);
+    prefetch->entry = next;
+
+    count = entry_producers(next, producers);
+    for (i = 0; i < count; i++) {
+        mlt_producer parent = mlt_producer_cut_parent(producers[i]);
+        if (mlt_producer_is_cut(producers[i]) && !mlt_producer_is_blank(producers[i])
+            && !mlt_properties_get_int(MLT_PRODUCER_PROPERTIES(producers[i]), "meta.fx_cut")
+            && mlt_properties_ref_count(MLT_PRODUCER_PROPERTIES(parent)) == 1) {
+            mlt_properties_inc_ref(MLT_PRODUCER_PROPERTIES(parent));
+            prefetch->in[prefetch->count] = mlt_producer_get_in(producers[i]);
+            prefetch->producers[prefetch->count++] = parent;
+        }
+    }
+    if (prefetch->count > 0) {
+        if (pthread_create(&prefetch->thread, NULL, prefetch_worker, prefetch) == 0) {
+            prefetch->running = 1;
+        } else {
+            while (prefetch->count > 0)
+                mlt_producer_close(prefetch->producers[--prefetch->count]);
+        }
+    }
 }
 
 /** Seek in the virtual playlist.
@@ -445,6 +655,7 @@ static mlt_service mlt_playlist_virtual_seek(mlt_playlist self,
 
     // Seek in real producer to relative position
     if (producer != NULL) {
+        prefetch_wait(self, producer);
         int count = self->list[i]->frame_count / self->list[i]->repeat;
         *progressive = count == 1;
         mlt_producer_seek(producer, (int) position % count);
@@ -454,6 +665,7 @@ static mlt_service mlt_playlist_virtual_seek(mlt_playlist self,
         mlt_producer self_producer = MLT_PLAYLIST_PRODUCER(self);
         mlt_producer_seek(self_producer, original - 1);
         producer = entry->producer;
+        prefetch_wait(self, producer);
         mlt_producer_seek(producer, (int) entry->frame_out % count);
         mlt_producer_set_speed(self_producer, 0);
         mlt_producer_set_speed(producer, 0);
@@ -463,6 +675,7 @@ static mlt_service mlt_playlist_virtual_seek(mlt_playlist self,
         mlt_producer self_producer = MLT_PLAYLIST_PRODUCER(self);
         mlt_producer_seek(self_producer, 0);
         producer = entry->producer;
+        prefetch_wait(self, producer);
         mlt_producer_seek(producer, 0);
     } else {
         producer = blank_producer(self);
@@ -496,20 +709,11 @@ static mlt_producer mlt_playlist_virtual_set_out(mlt_playlist self)
     // Map playlist position to real producer in virtual playlist
     mlt_position position = mlt_producer_frame(&self->parent);
 
-    // Loop through the virtual playlist
-    int i = 0;
-
-    for (i = 0; i < self->count; i++) {
-        if (position < self->list[i]->frame_count) {
-            // Found it, now break
-            producer = self->list[i]->producer;
-            break;
-        } else {
-            // Decrement position by length of this entry
-            position -= self->list[i]->frame_count;
-        }
-    }
+    // Find the entry in the virtual playlist
+    int i = mlt_playlist_find(self, &position);
 
+    if (i < self->count)
+        producer = self->list[i]->producer;
     if (!producer) {
         producer = blank_producer(self);
     }
@@ -539,20 +743,7 @@ int mlt_playlist_current_clip(mlt_playlist self)
     // Map playlist position to real producer in virtual playlist
     mlt_position position = mlt_producer_frame(&self->parent);
 
-    // Loop through the virtual playlist
-    int i = 0;
-
-    for (i = 0; i < self->count; i++) {
-        if (position < self->list[i]->frame_count) {
-            // Found it, now break
-            break;
-        } else {
-            // Decrement position by length of this entry
-            position -= self->list[i]->frame_count;
-        }
-    }
-
-    return i;
+    return mlt_playlist_find(self, &position);
 }
 
 /** Obtain the current clips producer.
@@ -609,8 +800,11 @@ mlt_position mlt_playlist_clip(mlt_playlist self, mlt_whence whence, int index)
         absolute_clip = self->count;
 
     // Now determine the position
-    for (i = 0; i < absolute_clip; i++)
-        position += self->list[i]->frame_count;
+    if (self->starts_count == self->count + 1)
+        position = self->starts[absolute_clip];
+    else
+        for (i = 0; i < absolute_clip; i++)
+            position += self->list[i]->frame_count;
 
     return position;
 }
@@ -802,6 +996,7 @@ int mlt_playlist_remove(mlt_playlist self, int where)
         mlt_playlist_get_clip_info(self, &where_info, where);
 
         // Reorganise the list
+        self->starts_count = 0;
         for (i = where + 1; i < self->count; i++)
             self->list[i - 1] = self->list[i];
         self->count--;
@@ -887,6 +1082,8 @@ int mlt_playlist_move(mlt_playlist self, int src, int dest)
         else if (current == dest)
             current = src;
 
+        // The start positions are stale until the refresh below.
+        self->starts_count = 0;
         src_entry = self->list[src];
         if (src > dest) {
             for (i = src; i > dest; i--)
@@ -940,6 +1137,7 @@ int mlt_playlist_reorder(mlt_playlist self, const int *indices)
     }
 
     // Delete the old list and save the new list
+    self->starts_count = 0;
     free(self->list);
     self->list = new_list;
     mlt_playlist_virtual_refresh(self);
@@ -2070,8 +2268,15 @@ static int producer_get_frame(mlt_producer producer, mlt_frame_ptr frame, int in
                                self->list[clip_index]->frame_count);
     }
 
-    // Check for notifier and call with appropriate argument
+    // Prepare the next clip while playing forward near the end of this one
     mlt_properties playlist_properties = MLT_PRODUCER_PROPERTIES(producer);
+    int prefetch = mlt_properties_get_int(playlist_properties, "prefetch");
+    if (prefetch > 0 && clip_index >= 0 && clip_index + 1 < self->count
+        && mlt_producer_get_speed(producer) > 0
+        && self->list[clip_index]->frame_count - clip_position <= prefetch)
+        prefetch_start(self, clip_index);
+
+    // Check for notifier and call with appropriate argument
     void (*notifier)(void *) = mlt_properties_get_data(playlist_properties, "notifier", NULL);
     if (notifier != NULL) {
         void *argument = mlt_properties_get_data(playlist_properties, "notifier_arg", NULL);
@@ -2098,6 +2303,8 @@ void mlt_playlist_close(mlt_playlist self)
     if (self != NULL && mlt_properties_dec_ref(MLT_PLAYLIST_PROPERTIES(self)) <= 0) {
         int i = 0;
         self->parent.close = NULL;
+        prefetch_join(self);
+        free(self->prefetch);
         for (i = 0; i < self->count; i++) {
             mlt_event_close(self->list[i]->event);
             mlt_producer_close(self->list[i]->producer);
@@ -2105,6 +2312,7 @@ void mlt_playlist_close(mlt_playlist self)
         }
         mlt_producer_close(&self->parent);
         free(self->list);
+        free(self->starts);
         free(self);
     }
 }
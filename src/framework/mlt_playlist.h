@@ -48,6 +48,11 @@ typedef struct
 
 typedef struct playlist_entry_s playlist_entry;
 
+/** Playlist Prefetch
+*/
+
+typedef struct playlist_prefetch_s playlist_prefetch;
+
 /** \brief Playlist class
  *
  * A playlist is a sequential container of producers and blank spaces. The class provides all
@@ -57,6 +62,10 @@ typedef struct playlist_entry_s playlist_entry;
  * \extends mlt_producer_s
  * \properties \em autoclose Set this true if you are doing sequential processing and want to
  * automatically close producers as they are finished being used to free resources.
+ * \properties \em prefetch Set this to a number of frames before the end of a clip to open,
+ * seek, and decode the first frame of the next clip, including the inputs of a mix, on a
+ * background thread while playing forward. Clips whose producer is also used elsewhere are
+ * not prefetched.
  * \properties \em meta.fx_cut Set true on a producer to indicate that it is a "fx_cut,"
  * which is a way to add filters as a playlist entry - useful only in a multitrack. See FxCut in the docs.
  * \properties \em mix_in
@@ -76,6 +85,11 @@ struct mlt_playlist_s
     int size;
     int count;
     playlist_entry **list;
+
+    mlt_position *starts; /**< \private the start of each entry followed by the total length */
+    int starts_size;      /**< \private the allocated size of starts */
+    int starts_count;     /**< \private the number of valid values in starts, 0 if not usable */
+    playlist_prefetch *prefetch; /**< \private the state of the prefetch of the next clip */
 };
 
 #define MLT_PLAYLIST_PRODUCER(playlist) (&(playlist)->parent)
@@ -27,6 +27,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 // Not nice - memalign is defined here apparently?
 #ifdef linux
@@ -70,13 +71,38 @@ void mlt_pool_release(void *release)
 }
 void mlt_pool_purge() {}
 void mlt_pool_close() {}
+void mlt_pool_get_stats(mlt_properties properties) {}
 void mlt_pool_stat() {}
 
 #else
 
-/** global singleton for tracking pools */
+/** The smallest block size, including the header, as a power of two */
+
+#define POOL_MIN_SHIFT 8
+
+/** The largest block size, including the header, as a power of two */
+
+#define POOL_MAX_SHIFT 30
+
+/** The number of size classes between consecutive powers of two */
+
+#define POOL_STEPS 4
+
+/** The number of size classes */
+
+#define POOL_CLASSES ((POOL_MAX_SHIFT - POOL_MIN_SHIFT) * POOL_STEPS + 1)
+
+/** The most blocks of one size class a thread keeps for itself */
 
-static mlt_properties pools = NULL;
+#define MAGAZINE_SIZE 16
+
+/** The most bytes of one size class a thread keeps for itself */
+
+#define MAGAZINE_BYTES (128 * 1024)
+
+/** How often, in seconds, blocks that stayed idle are freed */
+
+#define POOL_TRIM_SECONDS 10
 
 /** \brief Pool (memory) class
  */
@@ -85,10 +111,39 @@ typedef struct mlt_pool_s
 {
     pthread_mutex_t lock; ///< lock to prevent race conditions
     mlt_deque stack;      ///< a stack of addresses to memory blocks
-    int size;             ///< the size of the memory block as a power of 2
+    int size;             ///< the size of the memory blocks including the header
+    int index;            ///< the size class of the pool
+    int magazine;         ///< the number of blocks a thread may keep
     int count;            ///< the number of blocks in the pool
+    int peak;             ///< the most blocks out of the pool since the last trim
+    int low_water;        ///< the fewest idle blocks since the last trim
+    int64_t trimmed;      ///< the number of idle blocks freed by trimming
+    time_t trim_time;     ///< when the pool was last trimmed
 } * mlt_pool;
 
+/** \brief A thread's cache of blocks in front of the pools
+ */
+
+typedef struct pool_cache_s
+{
+    int generation;                            ///< the pools the blocks belong to
+    int count[POOL_CLASSES];                   ///< the number of blocks per size class
+    void *blocks[POOL_CLASSES][MAGAZINE_SIZE]; ///< the blocks per size class
+} * pool_cache;
+
+/** global singleton for tracking pools */
+
+static mlt_pool pools[POOL_CLASSES];
+
+/** incremented each time the pools are closed, so stale thread caches are discarded */
+
+static int pools_generation = 0;
+
+/** the key of each thread's pool_cache */
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
 /** \brief private to mlt_pool_s, for tracking items to release
  *
  * Aligned to 16 byte in case we toss buffers to external assembly
@@ -104,11 +159,12 @@ typedef struct __attribute__((aligned(16))) mlt_release_s
 /** Create a pool.
  *
  * \private \memberof mlt_pool_s
- * \param size the size of the memory blocks to hold as some power of two
+ * \param index the size class of the memory blocks
+ * \param size the size of the memory blocks
  * \return a new pool object
  */
 
-static mlt_pool pool_init(int size)
+static mlt_pool pool_init(int index, int size)
 {
     // Create the pool
     mlt_pool self = calloc(1, sizeof(struct mlt_pool_s));
@@ -122,13 +178,169 @@ static mlt_pool pool_init(int size)
         self->stack = mlt_deque_init();
 
         // Assign the size
+        self->index = index;
         self->size = size;
+
+        // Threads keep only a few small blocks for themselves
+        self->magazine = MAGAZINE_BYTES / size;
+        if (self->magazine > MAGAZINE_SIZE)
+            self->magazine = MAGAZINE_SIZE;
+
+        self->trim_time = time(NULL);
     }
 
     // Return it
     return self;
 }
 
+/** Free the blocks that stayed idle since the pool was last trimmed.
+ *
+ * The pool must be locked.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ */
+
+static void pool_trim(mlt_pool self)
+{
+    int idle = mlt_deque_count(self->stack);
+    if (idle < self->low_water)
+        self->low_water = idle;
+
+    time_t now = time(NULL);
+    if (now - self->trim_time >= POOL_TRIM_SECONDS) {
+        // The least recently returned blocks are at the front of the stack
+        while (self->low_water-- > 0) {
+            void *release = mlt_deque_pop_front(self->stack);
+            mlt_free((char *) release - sizeof(struct mlt_release_s));
+            self->count--;
+            self->trimmed++;
+        }
+        self->low_water = mlt_deque_count(self->stack);
+        self->peak = self->count - self->low_water;
+        self->trim_time = now;
+    }
+}
+
+/** Allocate a new block for a pool.
+ *
+ * The pool must be locked.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return an opaque pointer
+ */
+
+static void *pool_new(mlt_pool self)
+{
+    // We need to generate a release item
+    mlt_release release = mlt_alloc(self->size);
+
+    // If out of memory, log it, reclaim memory, and try again.
+    if (!release) {
+        mlt_log_fatal(NULL, "[mlt_pool] out of memory\n");
+        pthread_mutex_unlock(&self->lock);
+        mlt_pool_purge();
+        pthread_mutex_lock(&self->lock);
+        release = mlt_alloc(self->size);
+    }
+
+    // Initialise it
+    if (release != NULL) {
+        // Increment the number of items allocated to this pool
+        self->count++;
+
+        // Assign the pool
+        release->pool = self;
+
+        // Assign the reference
+        release->references = 1;
+
+        // Determine the ptr
+        return (char *) release + sizeof(struct mlt_release_s);
+    }
+    return NULL;
+}
+
+/** Free all blocks of a thread's cache.
+ *
+ * \private \memberof mlt_pool_s
+ * \param cache a thread's cache of blocks that belong to pools that were closed
+ */
+
+static void cache_discard(pool_cache cache)
+{
+    int i;
+
+    for (i = 0; i < POOL_CLASSES; i++)
+        while (cache->count[i] > 0)
+            mlt_free((char *) cache->blocks[i][--cache->count[i]] - sizeof(struct mlt_release_s));
+}
+
+/** Return all blocks of a thread's cache to the pools.
+ *
+ * \private \memberof mlt_pool_s
+ * \param cache a thread's cache
+ */
+
+static void cache_flush(pool_cache cache)
+{
+    int i;
+
+    for (i = 0; i < POOL_CLASSES; i++) {
+        if (cache->count[i] > 0) {
+            mlt_pool self = pools[i];
+            pthread_mutex_lock(&self->lock);
+            while (cache->count[i] > 0)
+                mlt_deque_push_back(self->stack, cache->blocks[i][--cache->count[i]]);
+            pthread_mutex_unlock(&self->lock);
+        }
+    }
+}
+
+/** Get the calling thread's cache of blocks.
+ *
+ * \private \memberof mlt_pool_s
+ * \return the cache or NULL if it could not be created
+ */
+
+static pool_cache cache_get()
+{
+    pool_cache cache = pthread_getspecific(cache_key);
+
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(struct pool_cache_s));
+        if (cache != NULL) {
+            cache->generation = pools_generation;
+            pthread_setspecific(cache_key, cache);
+        }
+    } else if (cache->generation != pools_generation) {
+        cache_discard(cache);
+        cache->generation = pools_generation;
+    }
+    return cache;
+}
+
+/** Return the blocks of a thread's cache when the thread exits.
+ *
+ * \private \memberof mlt_pool_s
+ * \param cache a thread's cache
+ */
+
+static void cache_close(void *cache)
+{
+    if (((pool_cache) cache)->generation == pools_generation)
+        cache_flush(cache);
+    else
+        cache_discard(cache);
+    free(cache);
+}
+
+static void cache_key_init()
+{
+    pthread_key_create(&cache_key, cache_close);
+}
+
 /** Get an item from the pool.
  *
  * \private \memberof mlt_pool_s
@@ -143,6 +355,13 @@ static void *pool_fetch(mlt_pool self)
 
     // Sanity check
     if (self != NULL) {
+        pool_cache cache = self->magazine ? cache_get() : NULL;
+        int index = self->index;
+
+        // Take a block from the thread's own cache without locking
+        if (cache != NULL && cache->count[index] > 0)
+            return cache->blocks[index][--cache->count[index]];
+
         // Lock the pool
         pthread_mutex_lock(&self->lock);
 
@@ -151,35 +370,22 @@ static void *pool_fetch(mlt_pool self)
             // Pop the top of the stack
             ptr = mlt_deque_pop_back(self->stack);
 
-            // Assign the reference
-            ((mlt_release) ptr)->references = 1;
-        } else {
-            // We need to generate a release item
-            mlt_release release = mlt_alloc(self->size);
-
-            // If out of memory, log it, reclaim memory, and try again.
-            if (!release && self->size > 0) {
-                mlt_log_fatal(NULL, "[mlt_pool] out of memory\n");
-                mlt_pool_purge();
-                release = mlt_alloc(self->size);
-            }
-
-            // Initialise it
-            if (release != NULL) {
-                // Increment the number of items allocated to this pool
-                self->count++;
-
-                // Assign the pool
-                release->pool = self;
-
-                // Assign the reference
-                release->references = 1;
-
-                // Determine the ptr
-                ptr = (char *) release + sizeof(struct mlt_release_s);
+            // Refill up to half of the thread's cache
+            if (cache != NULL) {
+                int refill = self->magazine / 2;
+                while (refill-- > 0 && mlt_deque_count(self->stack) != 0)
+                    cache->blocks[index][cache->count[index]++] = mlt_deque_pop_back(self->stack);
             }
+        } else {
+            ptr = pool_new(self);
         }
 
+        // Track the most blocks out of the pool
+        int used = self->count - mlt_deque_count(self->stack);
+        if (used > self->peak)
+            self->peak = used;
+        pool_trim(self);
+
         // Unlock the pool
         pthread_mutex_unlock(&self->lock);
     }
@@ -205,14 +411,33 @@ static void pool_return(void *ptr)
         mlt_pool self = that->pool;
 
         if (self != NULL) {
-            // Lock the pool
-            pthread_mutex_lock(&self->lock);
+            pool_cache cache = self->magazine ? cache_get() : NULL;
+            int index = self->index;
 
-            // Push the that back back on to the stack
-            mlt_deque_push_back(self->stack, ptr);
+            // Keep the block in the thread's own cache without locking
+            if (cache != NULL && cache->count[index] < self->magazine) {
+                cache->blocks[index][cache->count[index]++] = ptr;
+                self = NULL;
+            }
 
-            // Unlock the pool
-            pthread_mutex_unlock(&self->lock);
+            if (self != NULL) {
+                // Lock the pool
+                pthread_mutex_lock(&self->lock);
+
+                // The thread's cache is full, so move half of it back too
+                if (cache != NULL) {
+                    int flush = self->magazine / 2;
+                    while (flush-- > 0)
+                        mlt_deque_push_back(self->stack, cache->blocks[index][--cache->count[index]]);
+                }
+
+                // Push the that back back on to the stack
+                mlt_deque_push_back(self->stack, ptr);
+                pool_trim(self);
+
+                // Unlock the pool
+                pthread_mutex_unlock(&self->lock);
+            }
 
             return;
         }
@@ -252,6 +477,9 @@ static void pool_close(mlt_pool self)
 }
 
 /** Initialise the global pool.
+ *
+ * Block sizes grow in POOL_STEPS steps from one power of two to the next,
+ * from 256 bytes up to 1 GiB.
  *
  * \public \memberof mlt_pool_s
  */
@@ -261,22 +489,14 @@ void mlt_pool_init()
     // Loop variable used to create the pools
     int i = 0;
 
-    // Create the pools
-    pools = mlt_properties_new();
+    pthread_once(&cache_key_once, cache_key_init);
 
     // Create the pools
-    for (i = 8; i < 31; i++) {
-        // Each properties item needs a name
-        char name[32];
-
-        // Construct a pool
-        mlt_pool pool = pool_init(1 << i);
-
-        // Generate a name
-        sprintf(name, "%d", i);
-
-        // Register with properties
-        mlt_properties_set_data(pools, name, pool, 0, (mlt_destructor) pool_close, NULL);
+    pools[0] = pool_init(0, 1 << POOL_MIN_SHIFT);
+    for (i = 1; i < POOL_CLASSES; i++) {
+        int shift = POOL_MIN_SHIFT + (i - 1) / POOL_STEPS;
+        int step = (i - 1) % POOL_STEPS + 1;
+        pools[i] = pool_init(i, (1 << shift) + step * ((1 << shift) / POOL_STEPS));
     }
 }
 
@@ -288,22 +508,22 @@ void mlt_pool_init()
 
 void *mlt_pool_alloc(int size)
 {
-    // This will be used to obtain the pool to use
-    mlt_pool pool = NULL;
-
     // Determines the index of the pool to use
-    int index = 8;
+    int index = 0;
 
     // Minimum size pooled is 256 bytes
     size += sizeof(struct mlt_release_s);
-    while ((1 << index) < size)
-        index++;
-
-    // Now get the pool at the index
-    pool = mlt_properties_get_data_at(pools, index - 8, NULL);
+    if (size > (1 << POOL_MIN_SHIFT)) {
+        // Find the power of two below the size and the step above it
+        int shift = POOL_MIN_SHIFT;
+        while ((2 << shift) < size)
+            shift++;
+        int step = (1 << shift) / POOL_STEPS;
+        index = (shift - POOL_MIN_SHIFT) * POOL_STEPS + (size - (1 << shift) + step - 1) / step;
+    }
 
     // Now get the real item
-    return pool_fetch(pool);
+    return index < POOL_CLASSES ? pool_fetch(pools[index]) : NULL;
 }
 
 /** Allocate size bytes from the pool.
@@ -355,10 +575,15 @@ void mlt_pool_purge()
 {
     int i = 0;
 
+    // Include the blocks the calling thread keeps for itself
+    pool_cache cache = pthread_getspecific(cache_key);
+    if (cache != NULL && cache->generation == pools_generation)
+        cache_flush(cache);
+
     // For each pool
-    for (i = 0; i < mlt_properties_count(pools); i++) {
+    for (i = 0; i < POOL_CLASSES; i++) {
         // Get the pool
-        mlt_pool self = mlt_properties_get_data_at(pools, i, NULL);
+        mlt_pool self = pools[i];
 
         // Pointer to unused memory
         void *release = NULL;
@@ -371,6 +596,7 @@ void mlt_pool_purge()
             mlt_free((char *) release - sizeof(struct mlt_release_s));
             self->count--;
         }
+        self->low_water = 0;
 
         // Unlock the pool
         pthread_mutex_unlock(&self->lock);
@@ -390,37 +616,110 @@ void mlt_pool_release(void *release)
 }
 
 /** Close the pool.
+ *
+ * Blocks that other threads still keep for themselves are freed when the
+ * threads next use the pool or exit.
  *
  * \public \memberof mlt_pool_s
  */
 
 void mlt_pool_close()
 {
+    int i;
+
 #ifdef _MLT_POOL_CHECKS_
     mlt_pool_stat();
 #endif
 
-    // Close the properties
-    mlt_properties_close(pools);
+    // Include the blocks the calling thread keeps for itself
+    pool_cache cache = pthread_getspecific(cache_key);
+    if (cache != NULL && cache->generation == pools_generation)
+        cache_flush(cache);
+    pools_generation++;
+
+    // Close the pools
+    for (i = 0; i < POOL_CLASSES; i++) {
+        pool_close(pools[i]);
+        pools[i] = NULL;
+    }
+}
+
+/** Get the statistics of the pool.
+ *
+ * Sets "count" to the number of size classes that have blocks and
+ * "allocated" and "used" to the totals in bytes. For each size class with
+ * blocks, where size is the block size in bytes, sets "<size>.allocated",
+ * "<size>.idle" (on the shared stack), "<size>.used" (including blocks that
+ * threads keep for themselves), "<size>.peak" (the most used since the last
+ * trim) and "<size>.trimmed" (freed for staying idle) in blocks.
+ *
+ * \public \memberof mlt_pool_s
+ * \param properties the properties to receive the statistics
+ */
+
+void mlt_pool_get_stats(mlt_properties properties)
+{
+    int64_t allocated = 0, used = 0;
+    int i, count = 0;
+    char key[64];
+
+    if (!properties)
+        return;
+
+    for (i = 0; i < POOL_CLASSES; i++) {
+        mlt_pool pool = pools[i];
+        int blocks, idle, peak;
+        int64_t trimmed;
+
+        pthread_mutex_lock(&pool->lock);
+        blocks = pool->count;
+        idle = mlt_deque_count(pool->stack);
+        peak = pool->peak;
+        trimmed = pool->trimmed;
+        pthread_mutex_unlock(&pool->lock);
+
+        allocated += (int64_t) pool->size * blocks;
+        used += (int64_t) pool->size * (blocks - idle);
+        if (blocks) {
+            count++;
+            snprintf(key, sizeof(key), "%d.allocated", pool->size);
+            mlt_properties_set_int(properties, key, blocks);
+            snprintf(key, sizeof(key), "%d.idle", pool->size);
+            mlt_properties_set_int(properties, key, idle);
+            snprintf(key, sizeof(key), "%d.used", pool->size);
+            mlt_properties_set_int(properties, key, blocks - idle);
+            snprintf(key, sizeof(key), "%d.peak", pool->size);
+            mlt_properties_set_int(properties, key, peak);
+            snprintf(key, sizeof(key), "%d.trimmed", pool->size);
+            mlt_properties_set_int64(properties, key, trimmed);
+        }
+    }
+    mlt_properties_set_int(properties, "count", count);
+    mlt_properties_set_int64(properties, "allocated", allocated);
+    mlt_properties_set_int64(properties, "used", used);
 }
 
 void mlt_pool_stat()
 {
     // Stats dump
     uint64_t allocated = 0, used = 0, s;
-    int i = 0, c = mlt_properties_count(pools);
+    int i = 0, c = POOL_CLASSES;
 
     mlt_log(NULL, MLT_LOG_VERBOSE, "%s: count %d\n", __FUNCTION__, c);
 
     for (i = 0; i < c; i++) {
-        mlt_pool pool = mlt_properties_get_data_at(pools, i, NULL);
+        mlt_pool pool = pools[i];
+        pthread_mutex_lock(&pool->lock);
         if (pool->count)
             mlt_log_verbose(NULL,
-                            "%s: size %d allocated %d returned %d %c\n",
+                            "%s: size %d allocated %d returned %d peak %d trimmed %" PRId64
+                            " %c\n",
                             __FUNCTION__,
                             pool->size,
                             pool->count,
                             mlt_deque_count(pool->stack),
+                            pool->peak,
+                            pool->trimmed,
                             pool->count != mlt_deque_count(pool->stack) ? '*' : ' ');
         s = pool->size;
         s *= pool->count;
@@ -428,6 +727,7 @@ void mlt_pool_stat()
         s = pool->count - mlt_deque_count(pool->stack);
         s *= pool->size;
         used += s;
+        pthread_mutex_unlock(&pool->lock);
     }
 
     mlt_log_verbose(NULL,
@@ -23,12 +23,15 @@
 #ifndef MLT_POOL_H
 #define MLT_POOL_H
 
+struct mlt_properties_s;
+
 extern void mlt_pool_init();
 extern void *mlt_pool_alloc(int size);
 extern void *mlt_pool_realloc(void *ptr, int size);
 extern void mlt_pool_release(void *release);
 extern void mlt_pool_purge();
 extern void mlt_pool_close();
+extern void mlt_pool_get_stats(struct mlt_properties_s *properties);
 extern void mlt_pool_stat();
 
 #endif
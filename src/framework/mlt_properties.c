@@ -38,6 +38,7 @@
 #include <locale.h>
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,8 +51,10 @@
 
 typedef struct
 {
-    int hash[199];
     char **name;
+    unsigned int *hash; /**< the hash of each name */
+    int *index;         /**< an open addressing hash table of name positions + 1 */
+    int index_size;     /**< the number of slots in \p index, a power of two */
     mlt_property *value;
     int count;
     int size;
@@ -62,6 +65,9 @@ typedef struct
     mlt_properties *children_properties;
     char **children_names;
     int children_count;
+    atomic_int generation;   /**< incremented whenever a property changes */
+    mlt_properties snapshot; /**< the last snapshot, protected by mutex */
+    int snapshot_generation; /**< the generation \p snapshot was copied at */
 } property_list;
 
 /* Memory leak checks */
@@ -153,6 +159,7 @@ int mlt_properties_set_lcnumeric(mlt_properties self, const char *locale)
         free(list->locale);
         list->locale = strdup(locale);
 #endif
+        atomic_fetch_add(&list->generation, 1);
     } else
         error = 1;
 #endif // _WIN32
@@ -321,12 +328,53 @@ int mlt_properties_preset(mlt_properties self, const char *name)
  * \return an integer
  */
 
-static inline int generate_hash(const char *name)
+static inline unsigned int generate_hash(const char *name)
 {
     unsigned int hash = 5381;
     while (*name)
         hash = hash * 33 + (unsigned int) (*name++);
-    return hash % 199;
+    // Mix the bits because the table only uses the lowest ones
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/** Add a property position to the hash table.
+ *
+ * The caller must hold the lock and ensure there is a free slot.
+ * \private \memberof mlt_properties_s
+ * \param list the property list
+ * \param i the position of the property
+ */
+
+static inline void index_insert(property_list *list, int i)
+{
+    int mask = list->index_size - 1;
+    int slot = list->hash[i] & mask;
+    while (list->index[slot])
+        slot = (slot + 1) & mask;
+    list->index[slot] = i + 1;
+}
+
+/** Rebuild the hash table with a new number of slots.
+ *
+ * The caller must hold the lock.
+ * \private \memberof mlt_properties_s
+ * \param list the property list
+ * \param size the number of slots, a power of two
+ */
+
+static void index_rebuild(property_list *list, int size)
+{
+    int *index = calloc(size, sizeof(int));
+    if (index) {
+        free(list->index);
+        list->index = index;
+        list->index_size = size;
+        for (int i = 0; i < list->count; i++)
+            index_insert(list, i);
+    }
 }
 
 /** Copy a serializable property to a properties list that is mirroring this one.
@@ -537,20 +585,22 @@ static inline mlt_property mlt_properties_find(mlt_properties self, const char *
         return NULL;
     property_list *list = self->local;
     mlt_property value = NULL;
-    int key = generate_hash(name);
+    unsigned int key = generate_hash(name);
 
     mlt_properties_lock(self);
 
-    int i = list->hash[key] - 1;
-    if (i >= 0) {
-        // Check if we're hashed
-        if (list->count > 0 && list->name[i] && !strcmp(list->name[i], name))
-            value = list->value[i];
-
-        // Locate the item
-        for (i = list->count - 1; value == NULL && i >= 0; i--)
-            if (list->name[i] && !strcmp(list->name[i], name))
+    if (list->index_size > 0) {
+        // Probe the hash table until an empty slot
+        int mask = list->index_size - 1;
+        int slot = key & mask;
+        int i;
+        while ((i = list->index[slot] - 1) >= 0) {
+            if (list->hash[i] == key && list->name[i] && !strcmp(list->name[i], name)) {
                 value = list->value[i];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
     }
     mlt_properties_unlock(self);
 
@@ -568,7 +618,7 @@ static inline mlt_property mlt_properties_find(mlt_properties self, const char *
 static mlt_property mlt_properties_add(mlt_properties self, const char *name)
 {
     property_list *list = self->local;
-    int key = generate_hash(name);
+    unsigned int key = generate_hash(name);
     mlt_property result;
 
     mlt_properties_lock(self);
@@ -578,15 +628,20 @@ static mlt_property mlt_properties_add(mlt_properties self, const char *name)
         list->size += 50;
         list->name = realloc(list->name, list->size * sizeof(const char *));
         list->value = realloc(list->value, list->size * sizeof(mlt_property));
+        list->hash = realloc(list->hash, list->size * sizeof(unsigned int));
     }
 
+    // Keep the hash table at most half full
+    if ((list->count + 1) * 2 > list->index_size)
+        index_rebuild(list, list->index_size ? list->index_size * 2 : 32);
+
     // Assign name/value pair
     list->name[list->count] = strdup(name);
     list->value[list->count] = mlt_property_init();
+    list->hash[list->count] = key;
 
     // Assign to hash table
-    if (list->hash[key] == 0)
-        list->hash[key] = list->count + 1;
+    index_insert(list, list->count);
 
     // Return and increment count accordingly
     result = list->value[list->count++];
@@ -619,6 +674,8 @@ static mlt_property mlt_properties_fetch(mlt_properties self, const char *name)
 
 static void fire_property_changed(mlt_properties self, const char *name)
 {
+    // Count the change even when events are blocked
+    atomic_fetch_add(&((property_list *) self->local)->generation, 1);
     mlt_events_fire(self, "property-changed", mlt_event_data_from_string(name));
 }
 
@@ -642,6 +699,91 @@ void mlt_properties_pass_property(mlt_properties self, mlt_properties that, cons
     fire_property_changed(self, name);
 }
 
+/** Copy the values of all serializable properties to another properties object
+ *
+ * Unlike \p mlt_properties_inherit, this keeps the type of each value, so that
+ * a number is not rounded by a conversion to a string, and an animation is
+ * copied as its keyframes and not a value at some position.
+ * \public \memberof mlt_properties_s
+ * \param self the properties to copy to
+ * \param that the properties to copy from
+ * \return true if error
+ */
+
+int mlt_properties_copy_values(mlt_properties self, mlt_properties that)
+{
+    if (!self || !that)
+        return 1;
+
+    mlt_properties_lock(that);
+
+    property_list *list = that->local;
+    int i;
+    for (i = 0; i < list->count; i++) {
+        mlt_property value = list->value[i];
+
+        // Skip references to data and nested properties
+        if (mlt_property_is_clear(value) || mlt_property_get_properties(value)
+            || (mlt_property_get_data(value, NULL) && !mlt_property_is_rect(value)))
+            continue;
+        mlt_property_pass(mlt_properties_fetch(self, list->name[i]), value);
+    }
+
+    mlt_properties_unlock(that);
+
+    return 0;
+}
+
+/** Get a copy of the values of all serializable properties that is shared until they change.
+ *
+ * The copy is made as by \p mlt_properties_copy_values. While no property is
+ * set, cleared, or renamed, every call returns the same copy, so an animation
+ * in it is only parsed once however often it is read. Nobody may change the
+ * copy, because other callers may read it at the same time. Changes made
+ * through an mlt_animation of a property are not noticed until a property is
+ * set.
+ * \public \memberof mlt_properties_s
+ * \param self the properties to copy from
+ * \return the copy, which the caller must close, or NULL on error
+ */
+
+mlt_properties mlt_properties_snapshot(mlt_properties self)
+{
+    if (!self)
+        return NULL;
+
+    property_list *list = self->local;
+    mlt_properties snapshot = NULL;
+    int generation = atomic_load(&list->generation);
+
+    mlt_properties_lock(self);
+    if (list->snapshot && list->snapshot_generation == generation) {
+        snapshot = list->snapshot;
+        mlt_properties_inc_ref(snapshot);
+    }
+    mlt_properties_unlock(self);
+    if (snapshot)
+        return snapshot;
+
+    snapshot = mlt_properties_new();
+    if (!snapshot)
+        return NULL;
+    mlt_properties_set_lcnumeric(snapshot, mlt_properties_get_lcnumeric(self));
+    mlt_properties_copy_values(snapshot, self);
+
+    // Keep the copy for later calls unless a property changed meanwhile
+    mlt_properties_lock(self);
+    if (generation == atomic_load(&list->generation)) {
+        mlt_properties_close(list->snapshot);
+        list->snapshot = snapshot;
+        list->snapshot_generation = generation;
+        mlt_properties_inc_ref(snapshot);
+    }
+    mlt_properties_unlock(self);
+
+    return snapshot;
+}
+
 /** Copy all properties specified in a comma-separated list to another properties list.
  *
  * White space is also a delimiter.
@@ -1286,7 +1428,9 @@ int mlt_properties_rename(mlt_properties self, const char *source, const char *d
             if (list->name[i] && !strcmp(list->name[i], source)) {
                 free(list->name[i]);
                 list->name[i] = strdup(dest);
-                list->hash[generate_hash(dest)] = i + 1;
+                list->hash[i] = generate_hash(dest);
+                index_rebuild(list, list->index_size);
+                atomic_fetch_add(&list->generation, 1);
                 break;
             }
         }
@@ -1508,6 +1652,7 @@ void mlt_properties_close(mlt_properties self)
                 mlt_property_close(list->value[index]);
                 free(list->name[index]);
             }
+            mlt_properties_close(list->snapshot);
 
 #if defined(__GLIBC__) || defined(__APPLE__)
             // Cleanup locale
@@ -1522,6 +1667,8 @@ void mlt_properties_close(mlt_properties self)
             pthread_mutex_destroy(&list->mutex);
             free(list->name);
             free(list->value);
+            free(list->hash);
+            free(list->index);
             free(list);
 
             // Free self now if self has no child
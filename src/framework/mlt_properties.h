@@ -58,6 +58,8 @@ extern int mlt_properties_ref_count(mlt_properties self);
 extern void mlt_properties_mirror(mlt_properties self, mlt_properties that);
 extern int mlt_properties_inherit(mlt_properties self, mlt_properties that);
 extern int mlt_properties_copy(mlt_properties self, mlt_properties that, const char *prefix);
+extern int mlt_properties_copy_values(mlt_properties self, mlt_properties that);
+extern mlt_properties mlt_properties_snapshot(mlt_properties self);
 extern int mlt_properties_pass(mlt_properties self, mlt_properties that, const char *prefix);
 extern void mlt_properties_pass_property(mlt_properties self, mlt_properties that, const char *name);
 extern int mlt_properties_pass_list(mlt_properties self, mlt_properties that, const char *list);
@@ -919,11 +919,6 @@ void mlt_property_pass(mlt_property self, mlt_property that)
     } else if (that->types & mlt_prop_rect) {
         clear_property(self);
         self->types = mlt_prop_rect | mlt_prop_data;
-        self->length = that->length;
-        self->data = calloc(1, self->length);
-        memcpy(self->data, that->data, self->length);
-        self->destructor = free;
-        self->serialiser = that->serialiser;
     } else if (that->animation && that->serialiser) {
         self->types = mlt_prop_string;
         self->prop_string = that->serialiser(that->animation, default_time_format());
@@ -931,6 +926,13 @@ void mlt_property_pass(mlt_property self, mlt_property that)
         self->types = mlt_prop_string;
         self->prop_string = that->serialiser(that->data, that->length);
     }
+    if ((self->types & mlt_prop_rect) && that->data) {
+        self->length = that->length;
+        self->data = calloc(1, self->length);
+        memcpy(self->data, that->data, self->length);
+        self->destructor = free;
+        self->serialiser = that->serialiser;
+    }
     pthread_mutex_unlock(&self->mutex);
 }
 
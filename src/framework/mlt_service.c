@@ -513,6 +513,65 @@ mlt_properties mlt_service_properties(mlt_service self)
     return self != NULL ? &self->parent : NULL;
 }
 
+/** Take a snapshot of the properties of a service for a frame.
+ *
+ * Call this when the service processes the frame, for example in the process
+ * function of a filter or transition. Then get the snapshot with
+ * \p mlt_service_get_snapshot in the function it pushes to the frame's image
+ * or audio stack, and read the parameters and animations from it instead of
+ * the service. The snapshot belongs to the frame, so the function does not
+ * need to lock the service while other threads render other frames or the
+ * application changes the parameters. References to data are not copied and
+ * must still be read from the service. Frames share the snapshot while the
+ * properties do not change, so animations are parsed once and nobody may
+ * change the snapshot.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \param frame a frame
+ * \return the snapshot, which the frame closes
+ */
+
+mlt_properties mlt_service_snapshot(mlt_service self, mlt_frame frame)
+{
+    mlt_properties properties = MLT_SERVICE_PROPERTIES(self);
+    mlt_properties snapshot = mlt_properties_snapshot(properties);
+    mlt_profile profile = mlt_service_profile(self);
+    char key[64];
+
+    if (!snapshot)
+        return properties;
+    // A shared snapshot already has the profile unless it was taken before the profile was set
+    if (mlt_properties_get_data(snapshot, "_profile", NULL) != profile)
+        mlt_properties_set_data(snapshot, "_profile", profile, 0, NULL, NULL);
+    snprintf(key, sizeof(key), "_snapshot.%p", self);
+    mlt_properties_set_data(MLT_FRAME_PROPERTIES(frame),
+                            key,
+                            snapshot,
+                            0,
+                            (mlt_destructor) mlt_properties_close,
+                            NULL);
+    return snapshot;
+}
+
+/** Get the snapshot of the properties of a service for a frame.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \param frame a frame
+ * \return the snapshot taken by \p mlt_service_snapshot, or the properties of
+ * the service if there is none
+ */
+
+mlt_properties mlt_service_get_snapshot(mlt_service self, mlt_frame frame)
+{
+    char key[64];
+
+    snprintf(key, sizeof(key), "_snapshot.%p", self);
+    mlt_properties snapshot = mlt_properties_get_data(MLT_FRAME_PROPERTIES(frame), key, NULL);
+    return snapshot ? snapshot : MLT_SERVICE_PROPERTIES(self);
+}
+
 /** Recursively apply attached filters.
  *
  * \public \memberof mlt_service_s
@@ -1004,6 +1063,21 @@ void mlt_service_cache_set_size(mlt_service self, const char *name, int size)
         mlt_cache_set_size(cache, size);
 }
 
+/** Set the number of seconds after which an unused item of the named cache is released.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \param name a name for the object that is unique to the service class, but not to the instance
+ * \param seconds the idle time or 0 for no limit
+ */
+
+void mlt_service_cache_set_max_idle(mlt_service self, const char *name, int seconds)
+{
+    mlt_cache cache = get_cache(self, name);
+    if (cache)
+        mlt_cache_set_max_idle(cache, seconds);
+}
+
 /** Get the current maximum size of the named cache.
  *
  * \public \memberof mlt_service_s
@@ -88,6 +88,8 @@ extern int mlt_service_disconnect_all_producers(mlt_service self);
 extern mlt_service mlt_service_get_producer(mlt_service self);
 extern int mlt_service_get_frame(mlt_service self, mlt_frame_ptr frame, int index);
 extern mlt_properties mlt_service_properties(mlt_service self);
+extern mlt_properties mlt_service_snapshot(mlt_service self, mlt_frame frame);
+extern mlt_properties mlt_service_get_snapshot(mlt_service self, mlt_frame frame);
 extern void mlt_service_set_consumer(mlt_service self, mlt_service consumer);
 extern mlt_service mlt_service_consumer(mlt_service self);
 extern mlt_service mlt_service_producer(mlt_service self);
@@ -106,6 +108,7 @@ extern void mlt_service_cache_put(
 extern mlt_cache_item mlt_service_cache_get(mlt_service self, const char *name);
 extern void mlt_service_cache_set_size(mlt_service self, const char *name, int size);
 extern int mlt_service_cache_get_size(mlt_service self, const char *name);
+extern void mlt_service_cache_set_max_idle(mlt_service self, const char *name, int seconds);
 extern void mlt_service_cache_purge(mlt_service self);
 
 #endif
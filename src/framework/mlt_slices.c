@@ -20,6 +20,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+// For pthread_setaffinity_np
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "mlt_slices.h"
 #include "mlt_factory.h"
 #include "mlt_log.h"
@@ -27,13 +32,14 @@
 
 #include <pthread.h>
 #include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <unistd.h>
 #ifdef _WIN32
 #include <windows.h>
 #endif
-#define MAX_SLICES 32
 #define ENV_SLICES "MLT_SLICES_COUNT"
+#define ENV_AFFINITY "MLT_SLICES_AFFINITY"
 
 typedef enum {
     mlt_policy_normal,
@@ -44,10 +50,23 @@ typedef enum {
 
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 static mlt_slices globals[mlt_policy_nb] = {NULL, NULL, NULL};
+static const char *policy_names[mlt_policy_nb] = {"normal", "rr", "fifo"};
+
+/** \brief A single call to run slices
+ *
+ * Slice indices are claimed with an atomic counter so that no lock is taken
+ * per slice. Each thread that processes slices of the runtime, worker or
+ * caller, claims its own id from \p ids. The runtime lives on the stack of the
+ * calling thread, so \p users counts the workers that may still touch it.
+ */
 
 struct mlt_slices_runtime_s
 {
-    int jobs, done, curr;
+    int jobs;
+    atomic_int curr; /**< the next slice index to claim */
+    atomic_int done; /**< the number of finished slices */
+    atomic_int ids;  /**< the next id to give a thread processing slices */
+    int users;       /**< the number of workers holding this runtime, protected by cond_mutex */
     mlt_slices_proc proc;
     void *cookie;
     struct mlt_slices_runtime_s *next;
@@ -62,14 +81,99 @@ struct mlt_slices_s
     pthread_mutex_t cond_mutex;
     pthread_cond_t cond_var_job;
     pthread_cond_t cond_var_ready;
-    pthread_t threads[MAX_SLICES];
+    pthread_t *threads;
     struct mlt_slices_runtime_s *head, *tail;
     const char *name;
+    atomic_llong stat_runs;       /**< the number of calls to run */
+    atomic_llong stat_jobs;       /**< the number of slices processed */
+    atomic_llong stat_caller;     /**< the number of slices processed by the calling threads */
+    atomic_llong stat_time;       /**< the total wall time of runs in microseconds */
 };
 
+/** Process slices of a runtime until none are left to claim.
+ *
+ * A thread joins a runtime at most once, and at most the workers and the
+ * calling thread join it, so the ids of a runtime are distinct and less than
+ * the count of the pool.
+ *
+ * \private \memberof mlt_slices_s
+ * \param r the runtime
+ * \return the number of slices processed
+ */
+
+static int mlt_slices_process(struct mlt_slices_runtime_s *r)
+{
+    int idx, id = -1, count = 0;
+
+    while ((idx = atomic_fetch_add(&r->curr, 1)) < r->jobs) {
+        if (id < 0)
+            id = atomic_fetch_add(&r->ids, 1);
+        mlt_log_debug(NULL,
+                      "%s:%d: running job: id=%d, idx=%d/%d\n",
+                      __FUNCTION__,
+                      __LINE__,
+                      id,
+                      idx,
+                      r->jobs);
+        r->proc(id, idx, r->jobs, r->cookie);
+        atomic_fetch_add(&r->done, 1);
+        count++;
+    }
+    return count;
+}
+
+/** Find the first runtime that has slices left to claim.
+ *
+ * Runtimes with all slices claimed are removed from the head of the list.
+ * The caller must hold the lock.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \return a runtime or NULL if there is no work
+ */
+
+static struct mlt_slices_runtime_s *mlt_slices_next(mlt_slices ctx)
+{
+    struct mlt_slices_runtime_s *r = ctx->head;
+
+    while (r && atomic_load(&r->curr) >= r->jobs) {
+        r = ctx->head = r->next;
+        if (!r)
+            ctx->tail = NULL;
+        mlt_log_debug(NULL, "%s:%d: new ctx->head=%p\n", __FUNCTION__, __LINE__, ctx->head);
+    }
+    return r;
+}
+
+/** Remove a runtime from the list if it is still there.
+ *
+ * The caller must hold the lock.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param r the runtime to remove
+ */
+
+static void mlt_slices_detach(mlt_slices ctx, struct mlt_slices_runtime_s *r)
+{
+    struct mlt_slices_runtime_s *prev = NULL, *curr = ctx->head;
+
+    while (curr && curr != r) {
+        prev = curr;
+        curr = curr->next;
+    }
+    if (curr) {
+        if (prev)
+            prev->next = curr->next;
+        else
+            ctx->head = curr->next;
+        if (ctx->tail == curr)
+            ctx->tail = prev;
+    }
+}
+
 static void *mlt_slices_worker(void *p)
 {
-    int id, idx;
     struct mlt_slices_runtime_s *r;
     mlt_slices ctx = (mlt_slices) p;
 
@@ -77,55 +181,28 @@ static void *mlt_slices_worker(void *p)
 
     pthread_mutex_lock(&ctx->cond_mutex);
 
-    id = ctx->readys;
     ctx->readys++;
 
     while (1) {
         mlt_log_debug(NULL, "%s:%d: ctx=[%p][%s] waiting\n", __FUNCTION__, __LINE__, ctx, ctx->name);
 
         /* wait for new jobs */
-        while (!ctx->f_exit && !(r = ctx->head))
+        while (!ctx->f_exit && !(r = mlt_slices_next(ctx)))
             pthread_cond_wait(&ctx->cond_var_job, &ctx->cond_mutex);
 
         if (ctx->f_exit)
             break;
 
-        if (!r)
-            continue;
-
-        /* check if no new job */
-        if (r->curr == r->jobs) {
-            ctx->head = ctx->head->next;
-            if (!ctx->head)
-                ctx->tail = NULL;
-            mlt_log_debug(NULL, "%s:%d: new ctx->head=%p\n", __FUNCTION__, __LINE__, ctx->head);
-            continue;
-        };
-
-        /* new job id */
-        idx = r->curr;
-        r->curr++;
-
-        /* run job */
+        /* hold the runtime and claim slices without the lock */
+        r->users++;
         pthread_mutex_unlock(&ctx->cond_mutex);
-        mlt_log_debug(NULL,
-                      "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n",
-                      __FUNCTION__,
-                      __LINE__,
-                      id,
-                      idx,
-                      r->jobs,
-                      ctx->name);
-        r->proc(id, idx, r->jobs, r->cookie);
+        atomic_fetch_add(&ctx->stat_jobs, mlt_slices_process(r));
         pthread_mutex_lock(&ctx->cond_mutex);
 
-        /* increase done jobs counter */
-        r->done++;
-
-        /* notify we fininished last job */
-        if (r->done == r->jobs) {
+        /* notify the caller that we no longer use its runtime */
+        if (--r->users == 0) {
             mlt_log_debug(NULL,
-                          "%s:%d: pthread_cond_signal( &ctx->cond_var_ready )\n",
+                          "%s:%d: pthread_cond_broadcast( &ctx->cond_var_ready )\n",
                           __FUNCTION__,
                           __LINE__);
             pthread_cond_broadcast(&ctx->cond_var_ready);
@@ -164,6 +241,7 @@ static mlt_slices mlt_slices_init(int threads, int policy, int priority)
     int cpus = sysconf(_SC_NPROCESSORS_ONLN);
 #endif
     int i, env_val = env ? atoi(env) : 0;
+    int affinity = getenv(ENV_AFFINITY) ? atoi(getenv(ENV_AFFINITY)) : 0;
 
     /* check given threads count */
     if (!env || !env_val) {
@@ -185,10 +263,11 @@ static mlt_slices mlt_slices_init(int threads, int policy, int priority)
         else if (!threads)
             threads = env_val;
     }
-    if (threads > MAX_SLICES)
-        threads = MAX_SLICES;
+    if (threads < 1)
+        threads = 1;
 
     ctx->count = threads;
+    ctx->threads = calloc(threads, sizeof(pthread_t));
 
     /* init attributes */
     pthread_mutex_init(&ctx->cond_mutex, NULL);
@@ -203,10 +282,19 @@ static mlt_slices mlt_slices_init(int threads, int policy, int priority)
     param.sched_priority = priority;
     pthread_attr_setschedparam(&tattr, &param);
 
-    /* run worker threads */
-    for (i = 0; i < ctx->count; i++) {
+    /* run worker threads, the thread calling run is the last one */
+    for (i = 0; i < ctx->count - 1; i++) {
         pthread_create(&ctx->threads[i], &tattr, mlt_slices_worker, ctx);
         pthread_setschedparam(ctx->threads[i], policy, &param);
+#if defined(__linux__) && !defined(__ANDROID__)
+        /* optionally pin each worker to one CPU */
+        if (affinity && cpus > 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(i % cpus, &cpuset);
+            pthread_setaffinity_np(ctx->threads[i], sizeof(cpuset), &cpuset);
+        }
+#endif
     }
 
     pthread_attr_destroy(&tattr);
@@ -244,6 +332,17 @@ static void mlt_slices_close(mlt_slices ctx)
     }
     pthread_mutex_unlock(&g_lock);
 
+    if (atomic_load(&ctx->stat_runs))
+        mlt_log_verbose(NULL,
+                        "%s: pool=[%s] threads=%d runs=%lld slices=%lld by callers=%lld time=%lld us\n",
+                        __FUNCTION__,
+                        ctx->name,
+                        ctx->count,
+                        (long long) atomic_load(&ctx->stat_runs),
+                        (long long) atomic_load(&ctx->stat_jobs),
+                        (long long) atomic_load(&ctx->stat_caller),
+                        (long long) atomic_load(&ctx->stat_time));
+
     /* notify to exit */
     ctx->f_exit = 1;
     pthread_mutex_lock(&ctx->cond_mutex);
@@ -252,7 +351,7 @@ static void mlt_slices_close(mlt_slices ctx)
     pthread_mutex_unlock(&ctx->cond_mutex);
 
     /* wait for threads exit */
-    for (j = 0; j < ctx->count; j++)
+    for (j = 0; j < ctx->count - 1; j++)
         pthread_join(ctx->threads[j], NULL);
 
     /* destroy vars */
@@ -261,10 +360,17 @@ static void mlt_slices_close(mlt_slices ctx)
     pthread_mutex_destroy(&ctx->cond_mutex);
 
     /* free context */
+    free(ctx->threads);
     free(ctx);
 }
 
 /** Run sliced execution
+ *
+ * The calling thread processes slices too instead of only waiting. That keeps
+ * nested and concurrent runs from tying up the workers while their callers
+ * sleep. The pool has one worker fewer than its count. Each thread that
+ * processes slices of this run gets its own \p id in the range [0, count),
+ * even when other runs are in progress at the same time or nested in this one.
  *
  * \private \memberof mlt_slices_s
  * \param ctx context pointer
@@ -280,9 +386,7 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
         return;
     }
     struct mlt_slices_runtime_s runtime, *r = &runtime;
-
-    /* lock */
-    pthread_mutex_lock(&ctx->cond_mutex);
+    int64_t start = mlt_log_timings_now();
 
     /* check jobs count */
     if (jobs < 0)
@@ -292,12 +396,17 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
 
     /* setup runtime args */
     r->jobs = jobs;
-    r->done = 0;
-    r->curr = 0;
+    atomic_init(&r->done, 0);
+    atomic_init(&r->curr, 0);
+    atomic_init(&r->ids, 0);
+    r->users = 0;
     r->proc = proc;
     r->cookie = cookie;
     r->next = NULL;
 
+    /* lock */
+    pthread_mutex_lock(&ctx->cond_mutex);
+
     /* attach job */
     if (ctx->tail) {
         ctx->tail->next = r;
@@ -308,9 +417,16 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
 
     /* notify workers */
     pthread_cond_broadcast(&ctx->cond_var_job);
+    pthread_mutex_unlock(&ctx->cond_mutex);
 
-    /* wait for end of task */
-    while (!ctx->f_exit && (r->done < r->jobs)) {
+    /* help instead of waiting */
+    int count = mlt_slices_process(r);
+    atomic_fetch_add(&ctx->stat_jobs, count);
+    atomic_fetch_add(&ctx->stat_caller, count);
+
+    /* wait for end of task and for the workers to let go of the runtime */
+    pthread_mutex_lock(&ctx->cond_mutex);
+    while (atomic_load(&r->done) < r->jobs || r->users > 0) {
         pthread_cond_wait(&ctx->cond_var_ready, &ctx->cond_mutex);
         mlt_log_debug(NULL,
                       "%s:%d: ctx=[%p][%s] signalled\n",
@@ -319,8 +435,11 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
                       ctx,
                       ctx->name);
     }
-
+    mlt_slices_detach(ctx, r);
     pthread_mutex_unlock(&ctx->cond_mutex);
+
+    atomic_fetch_add(&ctx->stat_runs, 1);
+    atomic_fetch_add(&ctx->stat_time, mlt_log_timings_now() - start);
 }
 
 /** Get a global shared sliced threading context.
@@ -348,6 +467,7 @@ static mlt_slices mlt_slices_get_global(mlt_schedule_policy policy)
             posix_policy = SCHED_OTHER;
         }
         globals[policy] = mlt_slices_init(0, posix_policy, -1);
+        globals[policy]->name = policy_names[policy];
         mlt_factory_register_for_clean_up(globals[policy], (mlt_destructor) mlt_slices_close);
     }
     pthread_mutex_unlock(&g_lock);
@@ -28,6 +28,7 @@
 /**
  * \envvar \em MLT_SLICES_COUNT Set the number of slices to use, which
  * defaults to number of CPUs found.
+ * \envvar \em MLT_SLICES_AFFINITY Set this to 1 to pin each slice thread to one CPU (Linux only).
  */
 
 struct mlt_slices_s;
@@ -21,13 +21,16 @@
  */
 
 #include "mlt_tractor.h"
+#include "mlt_audio.h"
 #include "mlt_field.h"
 #include "mlt_frame.h"
 #include "mlt_log.h"
 #include "mlt_multitrack.h"
+#include "mlt_slices.h"
 #include "mlt_transition.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -345,6 +348,476 @@ mlt_producer mlt_tractor_get_track(mlt_tractor self, int index)
     return mlt_multitrack_track(mlt_tractor_multitrack(self), index);
 }
 
+/** \brief The request the composition made of a stack of a track in recent frames
+ */
+
+typedef struct
+{
+    int request[4];       ///< the image format, width, height, and writable, or the audio format,
+                          ///< frequency, channels, and samples (-1 for those of the frame)
+    mlt_properties delta; ///< the properties the composition set on the frame before the request
+    int repeats;          ///< the number of frames in a row that made the same request
+    int dependent;        ///< whether the stack draws on the tracks below it
+} track_request_s, *track_request;
+
+/** \brief An image or audio stack of a track frame that can be rendered ahead of the composition
+ *
+ * The multitrack records the stack of each track frame before the transitions
+ * and the tractor add to it. When the tractor is asked for its image or audio,
+ * it predicts from recent frames what the composition will request of each
+ * stack and renders a copy of the stacks concurrently. The composition uses
+ * the result only if it makes exactly the predicted request of a frame in the
+ * predicted state; otherwise the stack is rendered as usual.
+ */
+
+typedef struct
+{
+    mlt_frame frame;         ///< the track frame
+    int track;               ///< the index of the track
+    int audio;               ///< whether this is the audio stack
+    double fps;              ///< the frame rate of the multitrack
+    mlt_deque stack;         ///< a copy of the stack as the track left it
+    int depth;               ///< the number of items in that stack
+    mlt_properties requests; ///< the recent requests of the tracks of the tractor
+    mlt_properties before;   ///< the properties of the frame before the composition
+    mlt_properties start;    ///< the properties the frame is predicted to have when requested
+    mlt_frame body;          ///< the frame that renders the copy of the stack
+    int request[4];          ///< the predicted request
+    int result[4];           ///< the format and size of what the copy of the stack returned
+    void *buffer;            ///< the image or audio the copy of the stack returned
+    int error;               ///< the error the copy of the stack returned
+    int dependent;           ///< whether the copy of the stack reached the tracks below it
+} track_render_s, *track_render;
+
+/** Protects the recent requests of the tracks of all tractors.
+ */
+
+static pthread_mutex_t track_requests_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void track_request_close(track_request self)
+{
+    mlt_properties_close(self->delta);
+    free(self);
+}
+
+static void track_render_close(track_render self)
+{
+    mlt_deque_close(self->stack);
+    mlt_properties_close(self->requests);
+    mlt_properties_close(self->before);
+    mlt_properties_close(self->start);
+    mlt_frame_close(self->body);
+    free(self);
+}
+
+/** Copy properties, sharing rather than owning their data.
+ */
+
+static void track_copy_properties(mlt_properties self, mlt_properties that)
+{
+    int i, count = mlt_properties_count(that);
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(that, i);
+        int size = 0;
+        void *data = mlt_properties_get_data_at(that, i, &size);
+        if (data)
+            mlt_properties_set_data(self, name, data, size, NULL, NULL);
+        else
+            mlt_properties_pass_property(self, that, name);
+    }
+}
+
+static int track_property_equal(mlt_properties self, mlt_properties that, const char *name)
+{
+    const char *a = mlt_properties_get(self, name);
+    const char *b = mlt_properties_get(that, name);
+    return mlt_properties_get_data(self, name, NULL) == mlt_properties_get_data(that, name, NULL)
+           && (a == b || (a && b && !strcmp(a, b)))
+           && mlt_properties_get_double(self, name) == mlt_properties_get_double(that, name);
+}
+
+static int track_properties_equal(mlt_properties self, mlt_properties that)
+{
+    int i, count = mlt_properties_count(self);
+    if (count != mlt_properties_count(that))
+        return 0;
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(self, i);
+        if (!mlt_properties_exists(that, name) || !track_property_equal(self, that, name))
+            return 0;
+    }
+    return 1;
+}
+
+/** Get the properties the composition set on a frame.
+ *
+ * \return the changed properties or NULL if they cannot be predicted
+ */
+
+static mlt_properties track_delta(mlt_properties now, mlt_properties before)
+{
+    mlt_properties delta = mlt_properties_new();
+    int i, added = 0, count = mlt_properties_count(now);
+
+    for (i = 0; delta && i < count; i++) {
+        const char *name = mlt_properties_get_name(now, i);
+        if (!mlt_properties_exists(before, name))
+            added++;
+        else if (track_property_equal(now, before, name))
+            continue;
+        if (mlt_properties_get_data(now, name, NULL)) {
+            // Data belongs to this frame
+            mlt_properties_close(delta);
+            delta = NULL;
+        } else {
+            mlt_properties_pass_property(delta, now, name);
+        }
+    }
+    if (delta && count - added != mlt_properties_count(before)) {
+        // A property was removed
+        mlt_properties_close(delta);
+        delta = NULL;
+    }
+    return delta;
+}
+
+static int track_below_image(mlt_frame frame,
+                             uint8_t **image,
+                             mlt_image_format *format,
+                             int *width,
+                             int *height,
+                             int writable)
+{
+    track_render self = mlt_frame_pop_service(frame);
+    self->dependent = 1;
+    return 1;
+}
+
+static int track_below_audio(mlt_frame frame,
+                             void **buffer,
+                             mlt_audio_format *format,
+                             int *frequency,
+                             int *channels,
+                             int *samples)
+{
+    track_render self = mlt_frame_pop_audio(frame);
+    self->dependent = 1;
+    return 1;
+}
+
+/** Learn the request the composition made of a stack and take the stack rendered ahead.
+ *
+ * The stack rendered ahead is taken only if the composition made the
+ * predicted request of a frame in the predicted state. Otherwise it is
+ * discarded and the stack is rendered as usual, as it would be without
+ * rendering ahead.
+ *
+ * \return true if the stack rendered ahead was taken
+ */
+
+static int track_render_finish(track_render self, int *request)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self->frame);
+    int matched = self->body && !self->dependent
+                  && !memcmp(request, self->request, sizeof(self->request))
+                  && track_properties_equal(properties, self->start);
+
+    if (self->before) {
+        mlt_properties delta = matched ? NULL : track_delta(properties, self->before);
+        char key[32];
+
+        snprintf(key, sizeof(key), "%s.%d", self->audio ? "audio" : "image", self->track);
+        if (self->audio
+            && request[3]
+                   == mlt_audio_calculate_frame_samples(self->fps,
+                                                        request[1],
+                                                        mlt_frame_get_position(self->frame)))
+            request[3] = -1;
+
+        pthread_mutex_lock(&track_requests_mutex);
+        track_request previous = mlt_properties_get_data(self->requests, key, NULL);
+        if (!previous) {
+            previous = calloc(1, sizeof(*previous));
+            mlt_properties_set_data(self->requests,
+                                    key,
+                                    previous,
+                                    0,
+                                    (mlt_destructor) track_request_close,
+                                    NULL);
+        }
+        if (self->dependent) {
+            previous->dependent = 1;
+        } else if (matched
+                   || (delta && previous->delta
+                       && !memcmp(request, previous->request, sizeof(previous->request))
+                       && track_properties_equal(delta, previous->delta))) {
+            previous->repeats++;
+        } else {
+            mlt_properties_close(previous->delta);
+            previous->delta = delta;
+            memcpy(previous->request, request, sizeof(previous->request));
+            previous->repeats = delta ? 1 : 0;
+            delta = NULL;
+        }
+        pthread_mutex_unlock(&track_requests_mutex);
+        mlt_properties_close(delta);
+    }
+
+    if (matched) {
+        mlt_properties body = MLT_FRAME_PROPERTIES(self->body);
+        mlt_deque stack = self->audio ? MLT_FRAME_AUDIO_STACK(self->frame)
+                                      : MLT_FRAME_IMAGE_STACK(self->frame);
+        int i, count = mlt_properties_count(body);
+
+        // The stack was rendered
+        for (i = 0; i < self->depth; i++)
+            mlt_deque_pop_back(stack);
+
+        // Take what it changed on the frame, whose data the body keeps
+        for (i = 0; i < count; i++) {
+            const char *name = mlt_properties_get_name(body, i);
+            int size = 0;
+            void *data = mlt_properties_get_data_at(body, i, &size);
+            if (!strncmp(name, "_track_render", 13) || track_property_equal(properties, body, name))
+                continue;
+            if (data)
+                mlt_properties_set_data(properties, name, data, size, NULL, NULL);
+            else
+                mlt_properties_pass_property(properties, body, name);
+        }
+    }
+    return matched;
+}
+
+static int track_get_image(mlt_frame frame,
+                           uint8_t **image,
+                           mlt_image_format *format,
+                           int *width,
+                           int *height,
+                           int writable)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    track_render self = mlt_frame_pop_service(frame);
+    int request[4] = {*format, *width, *height, writable};
+
+    // This was not one of the operations of the track
+    mlt_properties_set_int(properties,
+                           "image_count",
+                           mlt_properties_get_int(properties, "image_count") + 1);
+
+    if (track_render_finish(self, request)) {
+        *image = self->buffer;
+        *format = self->result[0];
+        *width = self->result[1];
+        *height = self->result[2];
+        return self->error;
+    }
+    return mlt_frame_get_image(frame, image, format, width, height, writable);
+}
+
+static int track_get_audio(mlt_frame frame,
+                           void **buffer,
+                           mlt_audio_format *format,
+                           int *frequency,
+                           int *channels,
+                           int *samples)
+{
+    track_render self = mlt_frame_pop_audio(frame);
+    int request[4] = {*format, *frequency, *channels, *samples};
+
+    if (track_render_finish(self, request)) {
+        *buffer = self->buffer;
+        *format = self->result[0];
+        *frequency = self->result[1];
+        *channels = self->result[2];
+        *samples = self->result[3];
+        return self->error;
+    }
+    return mlt_frame_get_audio(frame, buffer, format, frequency, channels, samples);
+}
+
+/** Record the image and audio stacks of a track frame.
+ *
+ * The multitrack calls this for each track frame when the parallel_tracks
+ * property of the tractor is set. Stacks that draw on the tracks below them,
+ * such as those of tracks of filters, are left alone.
+ */
+
+static void track_render_init(mlt_producer multitrack, mlt_frame frame, int track)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    mlt_properties requests = mlt_properties_get_data(MLT_PRODUCER_PROPERTIES(multitrack),
+                                                      "_track_requests",
+                                                      NULL);
+    int hide = mlt_properties_get_int(properties, "hide");
+    int audio;
+
+    if (!requests || mlt_properties_get_int(properties, "fx_cut"))
+        return;
+
+    for (audio = 0; audio < 2; audio++) {
+        mlt_deque stack = audio ? MLT_FRAME_AUDIO_STACK(frame) : MLT_FRAME_IMAGE_STACK(frame);
+        track_render self;
+
+        if ((audio ? mlt_frame_is_test_audio(frame) : mlt_frame_is_test_card(frame))
+            || (hide & (audio ? 2 : 1)))
+            continue;
+        self = calloc(1, sizeof(*self));
+        if (!self)
+            break;
+        self->frame = frame;
+        self->track = track;
+        self->audio = audio;
+        self->fps = mlt_producer_get_fps(multitrack);
+        self->stack = mlt_deque_clone(stack);
+        self->depth = mlt_deque_count(stack);
+        self->requests = requests;
+        mlt_properties_inc_ref(requests);
+        mlt_properties_set_data(properties,
+                                audio ? "_track_render.audio" : "_track_render.image",
+                                self,
+                                0,
+                                (mlt_destructor) track_render_close,
+                                NULL);
+        if (audio) {
+            mlt_frame_push_audio(frame, self);
+            mlt_frame_push_audio(frame, track_get_audio);
+        } else {
+            mlt_frame_push_service(frame, self);
+            mlt_frame_push_get_image(frame, track_get_image);
+        }
+    }
+}
+
+/** Predict the request the composition will make of a stack.
+ *
+ * \return true if the stack should be rendered ahead
+ */
+
+static int track_render_prepare(track_render self)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self->frame);
+    track_request previous;
+    char key[32];
+
+    self->before = mlt_properties_new();
+    track_copy_properties(self->before, properties);
+
+    snprintf(key, sizeof(key), "%s.%d", self->audio ? "audio" : "image", self->track);
+    pthread_mutex_lock(&track_requests_mutex);
+    previous = mlt_properties_get_data(self->requests, key, NULL);
+    if (previous && !previous->dependent && previous->repeats >= 2) {
+        int i, count = mlt_properties_count(previous->delta);
+        self->start = mlt_properties_new();
+        track_copy_properties(self->start, self->before);
+        for (i = 0; i < count; i++)
+            mlt_properties_pass_property(self->start,
+                                         previous->delta,
+                                         mlt_properties_get_name(previous->delta, i));
+        memcpy(self->request, previous->request, sizeof(self->request));
+    }
+    pthread_mutex_unlock(&track_requests_mutex);
+
+    if (self->start) {
+        mlt_deque stack = mlt_deque_clone(self->stack);
+        mlt_frame body = mlt_frame_init(NULL);
+
+        if (self->audio && self->request[3] < 0)
+            self->request[3] = mlt_audio_calculate_frame_samples(self->fps,
+                                                                 self->request[1],
+                                                                 mlt_frame_get_position(
+                                                                     self->frame));
+
+        // Report reaching the tracks below instead of rendering them
+        mlt_deque_push_front(stack, self->audio ? (void *) track_below_audio
+                                                : (void *) track_below_image);
+        mlt_deque_push_front(stack, self);
+        track_copy_properties(MLT_FRAME_PROPERTIES(body), self->start);
+        body->convert_image = self->frame->convert_image;
+        body->convert_audio = self->frame->convert_audio;
+        if (self->audio) {
+            mlt_deque_close(body->stack_audio);
+            body->stack_audio = stack;
+        } else {
+            mlt_deque_close(body->stack_image);
+            body->stack_image = stack;
+        }
+        self->body = body;
+    }
+    return self->body != NULL;
+}
+
+static int track_render_proc(int id, int idx, int jobs, void *cookie)
+{
+    track_render self = ((track_render *) cookie)[idx];
+
+    if (self->audio) {
+        mlt_audio_format format = self->request[0];
+        int frequency = self->request[1];
+        int channels = self->request[2];
+        int samples = self->request[3];
+        self->error = mlt_frame_get_audio(self->body,
+                                          &self->buffer,
+                                          &format,
+                                          &frequency,
+                                          &channels,
+                                          &samples);
+        self->result[0] = format;
+        self->result[1] = frequency;
+        self->result[2] = channels;
+        self->result[3] = samples;
+    } else {
+        mlt_image_format format = self->request[0];
+        int width = self->request[1];
+        int height = self->request[2];
+        uint8_t *image = NULL;
+        self->error = mlt_frame_get_image(self->body,
+                                          &image,
+                                          &format,
+                                          &width,
+                                          &height,
+                                          self->request[3]);
+        self->buffer = image;
+        self->result[0] = format;
+        self->result[1] = width;
+        self->result[2] = height;
+    }
+    return 0;
+}
+
+/** Render the image or audio stacks of the tracks of a tractor frame concurrently.
+ *
+ * This is done once, before the composition requests any of them.
+ */
+
+static void track_render_ahead(mlt_frame frame, int audio)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    const char *name = audio ? "_track_renders.audio" : "_track_renders.image";
+    mlt_deque renders = mlt_properties_get_data(properties, name, NULL);
+    int i, jobs = 0, count = mlt_deque_count(renders);
+    track_render *list = count ? calloc(count, sizeof(track_render)) : NULL;
+
+    for (i = 0; list && i < count; i++) {
+        track_render self = mlt_deque_peek(renders, i);
+        if (track_render_prepare(self))
+            list[jobs++] = self;
+    }
+    if (jobs > 1) {
+        mlt_slices_run_normal(jobs, track_render_proc, list);
+    } else if (jobs == 1) {
+        // Nothing to render alongside it
+        mlt_frame_close(list[0]->body);
+        list[0]->body = NULL;
+        jobs = 0;
+    }
+    free(list);
+    mlt_properties_set_int(properties,
+                           audio ? "_parallel_tracks.audio" : "_parallel_tracks.image",
+                           jobs);
+    mlt_properties_set_data(properties, name, NULL, 0, NULL, NULL);
+}
+
 static int producer_get_image(mlt_frame self,
                               uint8_t **buffer,
                               mlt_image_format *format,
@@ -373,6 +846,7 @@ static int producer_get_image(mlt_frame self,
                             NULL,
                             NULL);
 
+    track_render_ahead(self, 0);
     mlt_frame_get_image(frame, buffer, format, width, height, writable);
     mlt_frame_set_image(self, *buffer, 0, NULL);
 
@@ -439,6 +913,7 @@ static int producer_get_audio(mlt_frame self,
     mlt_properties_set(frame_properties,
                        "producer_consumer_fps",
                        mlt_properties_get(properties, "producer_consumer_fps"));
+    track_render_ahead(self, 1);
     mlt_frame_get_audio(frame, buffer, format, frequency, channels, samples);
     mlt_frame_set_audio(self,
                         *buffer,
@@ -451,6 +926,222 @@ static int producer_get_audio(mlt_frame self,
     return 0;
 }
 
+/** Get the output channel of a channel of a track on the audio bus.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param map a comma separated list of output channels, one per input channel, or NULL
+ * \param channel an input channel
+ * \return the output channel, or -1 to drop the channel
+ */
+
+static int audio_bus_channel(const char *map, int channel)
+{
+    if (map == NULL || *map == '\0')
+        return channel;
+    while (channel-- > 0) {
+        map = strchr(map, ',');
+        if (map == NULL)
+            return -1;
+        map++;
+    }
+    while (isspace((unsigned char) *map))
+        map++;
+    return isdigit((unsigned char) *map) ? atoi(map) : -1;
+}
+
+/** Add a plane of audio to a plane of the audio bus.
+ *
+ * The gain ramps linearly from \p gain by \p step per sample.
+ *
+ * \private \memberof mlt_tractor_s
+ */
+
+static void audio_bus_sum(
+    float *restrict dest, const float *restrict src, int samples, float gain, float step)
+{
+    int i;
+
+    if (step == 0.0f) {
+        for (i = 0; i < samples; i++)
+            dest[i] += gain * src[i];
+    } else {
+        for (i = 0; i < samples; i++)
+            dest[i] += (gain + step * (float) i) * src[i];
+    }
+}
+
+/** Add the audio of a track to the audio bus of a tractor frame.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param properties the properties of the tractor
+ * \param bus the tracks of the audio bus
+ * \param frame the frame of the track
+ * \param track the index of the track
+ * \param position the position of the tractor
+ * \param length the length of the tractor
+ */
+
+static void audio_bus_add(mlt_properties properties,
+                          mlt_deque bus,
+                          mlt_frame frame,
+                          int track,
+                          mlt_position position,
+                          int length)
+{
+    mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+    double gain = 1.0;
+    double previous = 1.0;
+    char name[64];
+
+    snprintf(name, sizeof(name), "audio_bus.gain.%d", track);
+    if (mlt_properties_get(properties, name)) {
+        gain = mlt_properties_anim_get_double(properties, name, position, length);
+        previous = position > 0
+                       ? mlt_properties_anim_get_double(properties, name, position - 1, length)
+                       : gain;
+    }
+    mlt_properties_set_double(frame_properties, "_audio_bus.gain", gain);
+    mlt_properties_set_double(frame_properties, "_audio_bus.previous_gain", previous);
+    snprintf(name, sizeof(name), "audio_bus.map.%d", track);
+    mlt_properties_set(frame_properties, "_audio_bus.map", mlt_properties_get(properties, name));
+    mlt_deque_push_back(bus, frame);
+}
+
+/** Get the audio of a tractor frame as the sum of the audio of its tracks.
+ *
+ * Every track is fetched as planar float audio and added to the bus in one
+ * pass with its gain, its mix level, and its channel mapping. A track that has fewer samples than
+ * the bus is padded with silence, and its extra channels and samples are
+ * dropped.
+ *
+ * \private \memberof mlt_tractor_s
+ */
+
+static int producer_get_audio_bus(mlt_frame self,
+                                  void **buffer,
+                                  mlt_audio_format *format,
+                                  int *frequency,
+                                  int *channels,
+                                  int *samples)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self);
+    mlt_deque bus = mlt_properties_get_data(properties, "_audio_bus", NULL);
+    int i, c, count = mlt_deque_count(bus);
+    int out_frequency = *frequency;
+    int out_channels = *channels;
+    int out_samples = *samples;
+    float *out = NULL;
+
+    // A single track at unity gain that is not mixed or silenced needs no bus
+    if (count == 1) {
+        mlt_frame frame = mlt_deque_peek(bus, 0);
+        mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+        if (mlt_properties_get_double(frame_properties, "_audio_bus.gain") == 1.0
+            && mlt_properties_get_double(frame_properties, "_audio_bus.previous_gain") == 1.0
+            && !mlt_properties_get(frame_properties, "_audio_bus.map")
+            && !mlt_properties_get(frame_properties, "audio.mix")
+            && !mlt_properties_get(frame_properties, "audio.previous_mix")
+            && !mlt_properties_get_int(frame_properties, "silent_audio")) {
+            mlt_frame_push_audio(self, frame);
+            return producer_get_audio(self, buffer, format, frequency, channels, samples);
+        }
+    }
+
+    track_render_ahead(self, 1);
+    for (i = 0; i < count; i++) {
+        mlt_frame frame = mlt_deque_peek(bus, i);
+        mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+        mlt_audio_format in_format = mlt_audio_float;
+        int in_frequency = out_frequency;
+        int in_channels = out_channels;
+        int in_samples = out_samples;
+        float *in = NULL;
+
+        mlt_properties_set(frame_properties,
+                           "consumer.channel_layout",
+                           mlt_properties_get(properties, "consumer.channel_layout"));
+        mlt_properties_set(frame_properties,
+                           "producer_consumer_fps",
+                           mlt_properties_get(properties, "producer_consumer_fps"));
+        if (mlt_frame_get_audio(frame,
+                                (void **) &in,
+                                &in_format,
+                                &in_frequency,
+                                &in_channels,
+                                &in_samples)
+            || in == NULL || in_format != mlt_audio_float) {
+            continue;
+        }
+
+        // Take whatever the request left open from the first track
+        if (out == NULL) {
+            if (out_frequency <= 0)
+                out_frequency = in_frequency;
+            if (out_channels <= 0)
+                out_channels = in_channels;
+            if (out_samples <= 0)
+                out_samples = in_samples;
+            if (out_channels <= 0 || out_samples <= 0)
+                continue;
+            out = mlt_pool_alloc(mlt_audio_format_size(mlt_audio_float, out_samples, out_channels));
+            memset(out, 0, out_samples * out_channels * sizeof(float));
+        }
+
+        if (mlt_properties_get_int(frame_properties, "silent_audio")) {
+            mlt_properties_set_int(frame_properties, "silent_audio", 0);
+            continue;
+        }
+
+        // Apply the mix level of the track as the sum mode of the mix transition does
+        double mix_start = 1.0, mix_end = 1.0;
+        if (mlt_properties_get(frame_properties, "audio.previous_mix"))
+            mix_start = mlt_properties_get_double(frame_properties, "audio.previous_mix");
+        if (mlt_properties_get(frame_properties, "audio.mix"))
+            mix_end = mlt_properties_get_double(frame_properties, "audio.mix");
+        if (mlt_properties_get_int(frame_properties, "audio.reverse")) {
+            mix_start = 1.0 - mix_start;
+            mix_end = 1.0 - mix_end;
+        }
+
+        const char *map = mlt_properties_get(frame_properties, "_audio_bus.map");
+        float gain = mix_start
+                     * mlt_properties_get_double(frame_properties, "_audio_bus.previous_gain");
+        float step = (mix_end * mlt_properties_get_double(frame_properties, "_audio_bus.gain")
+                      - gain)
+                     / out_samples;
+        int n = MIN(in_samples, out_samples);
+        for (c = 0; c < in_channels; c++) {
+            int target = audio_bus_channel(map, c);
+            if (target >= 0 && target < out_channels)
+                audio_bus_sum(out + target * out_samples, in + c * in_samples, n, gain, step);
+        }
+    }
+
+    if (out == NULL) {
+        // No track had any audio
+        out_frequency = out_frequency <= 0 ? 48000 : out_frequency;
+        out_channels = out_channels <= 0 ? 2 : out_channels;
+        out_samples = out_samples <= 0 ? 1920 : out_samples;
+        out = mlt_pool_alloc(mlt_audio_format_size(mlt_audio_float, out_samples, out_channels));
+        memset(out, 0, out_samples * out_channels * sizeof(float));
+    }
+
+    *buffer = out;
+    *format = mlt_audio_float;
+    *frequency = out_frequency;
+    *channels = out_channels;
+    *samples = out_samples;
+    mlt_frame_set_audio(self,
+                        out,
+                        mlt_audio_float,
+                        mlt_audio_format_size(mlt_audio_float, out_samples, out_channels),
+                        mlt_pool_release);
+    mlt_properties_set_int(properties, "audio_frequency", out_frequency);
+    mlt_properties_set_int(properties, "audio_channels", out_channels);
+    mlt_properties_set_int(properties, "audio_samples", out_samples);
+    return 0;
+}
+
 /** Get the next frame.
  *
  * \private \memberof mlt_tractor_s
@@ -515,6 +1206,60 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
             // Get the properties of the frame
             frame_properties = MLT_FRAME_PROPERTIES(*frame);
 
+            // Let the multitrack record the stacks of the tracks to render them in parallel
+            int parallel = mlt_properties_get_int(properties, "parallel_tracks");
+            mlt_properties requests = mlt_properties_get_data(properties, "_track_requests", NULL);
+            mlt_deque image_renders = NULL;
+            mlt_deque audio_renders = NULL;
+            if (parallel) {
+                if (!requests) {
+                    requests = mlt_properties_new();
+                    mlt_properties_set_data(properties,
+                                            "_track_requests",
+                                            requests,
+                                            0,
+                                            (mlt_destructor) mlt_properties_close,
+                                            NULL);
+                }
+                image_renders = mlt_deque_init();
+                audio_renders = mlt_deque_init();
+                mlt_properties_set_data(frame_properties,
+                                        "_track_renders.image",
+                                        image_renders,
+                                        0,
+                                        (mlt_destructor) mlt_deque_close,
+                                        NULL);
+                mlt_properties_set_data(frame_properties,
+                                        "_track_renders.audio",
+                                        audio_renders,
+                                        0,
+                                        (mlt_destructor) mlt_deque_close,
+                                        NULL);
+            }
+            // Let the tractor sum the audio of all of the tracks
+            mlt_deque bus = NULL;
+            if (mlt_properties_get_int(properties, "audio_bus")) {
+                bus = mlt_deque_init();
+                mlt_properties_set_data(frame_properties,
+                                        "_audio_bus",
+                                        bus,
+                                        0,
+                                        (mlt_destructor) mlt_deque_close,
+                                        NULL);
+            }
+            mlt_properties_set_data(MLT_MULTITRACK_PROPERTIES(multitrack),
+                                    "_track_requests",
+                                    parallel ? requests : NULL,
+                                    0,
+                                    NULL,
+                                    NULL);
+            mlt_properties_set_data(MLT_MULTITRACK_PROPERTIES(multitrack),
+                                    "_track_render",
+                                    parallel ? track_render_init : NULL,
+                                    0,
+                                    NULL,
+                                    NULL);
+
             // Loop through each of the tracks we're harvesting
             for (i = 0; !done; i++) {
                 // Get a frame from the producer
@@ -546,6 +1291,18 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
                 // Check for last track
                 done = mlt_properties_get_int(temp_properties, "last_track");
 
+                // Collect the stacks the multitrack recorded
+                if (parallel) {
+                    void *render = mlt_properties_get_data(temp_properties,
+                                                           "_track_render.image",
+                                                           NULL);
+                    if (render)
+                        mlt_deque_push_back(image_renders, render);
+                    render = mlt_properties_get_data(temp_properties, "_track_render.audio", NULL);
+                    if (render)
+                        mlt_deque_push_back(audio_renders, render);
+                }
+
                 // Handle fx only tracks
                 if (mlt_properties_get_int(temp_properties, "fx_cut")) {
                     int hide = (video == NULL ? 1 : 0) | (audio == NULL ? 2 : 0);
@@ -565,7 +1322,14 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
                 if (!done && !mlt_frame_is_test_audio(temp)
                     && !(mlt_properties_get_int(temp_properties, "hide") & 2)) {
                     // Order of frame creation is starting to get problematic
-                    if (audio != NULL) {
+                    if (bus != NULL) {
+                        audio_bus_add(properties,
+                                      bus,
+                                      temp,
+                                      i,
+                                      mlt_producer_position(parent),
+                                      mlt_producer_get_playtime(parent));
+                    } else if (audio != NULL) {
                         mlt_deque_push_front(MLT_FRAME_AUDIO_STACK(temp), producer_get_audio);
                         mlt_deque_push_front(MLT_FRAME_AUDIO_STACK(temp), audio);
                     }
@@ -587,7 +1351,9 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
             }
 
             // Now stack callbacks
-            if (audio != NULL) {
+            if (bus != NULL && audio != NULL) {
+                mlt_frame_push_audio(*frame, producer_get_audio_bus);
+            } else if (audio != NULL) {
                 mlt_frame_push_audio(*frame, audio);
                 mlt_frame_push_audio(*frame, producer_get_audio);
             }
@@ -34,6 +34,18 @@
  * \properties \em multitrack holds a reference to the mulitrack object that a tractor manages
  * \properties \em field holds a reference to the field object that a tractor manages
  * \properties \em producer holds a reference to an encapsulated producer
+ * \properties \em parallel_tracks set to render the image and audio of the tracks concurrently
+ * before the transitions composite them; a track rendered for a request the transitions did
+ * not make is rendered again, so the result is the same as without it; the frame property
+ * _parallel_tracks.image or _parallel_tracks.audio is the number of tracks rendered concurrently
+ * \properties \em audio_bus set to sum the audio of all of the tracks that are not hidden,
+ * rather than to use the audio of the top track; tracks that a transition mixed into another
+ * track are hidden, so mix transitions keep working
+ * \properties \em audio_bus.gain.N the animated gain of track N on the audio bus, which ramps
+ * across each frame (default 1)
+ * \properties \em audio_bus.map.N a comma separated list of the output channels of the
+ * channels of track N on the audio bus, where a negative one drops the channel (default is
+ * the same channel)
  */
 
 struct mlt_tractor_s
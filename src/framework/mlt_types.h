@@ -235,6 +235,7 @@ typedef struct
 } mlt_color;
 
 typedef struct mlt_audio_s *mlt_audio;                  /**< pointer to Audio object */
+typedef struct mlt_audio_fifo_s *mlt_audio_fifo;        /**< pointer to Audio FIFO object */
 typedef struct mlt_image_s *mlt_image;                  /**< pointer to Image object */
 typedef struct mlt_frame_s *mlt_frame, **mlt_frame_ptr; /**< pointer to Frame object */
 typedef struct mlt_property_s *mlt_property;            /**< pointer to Property object */
@@ -0,0 +1,154 @@
+/*
+ * cache_file.c -- on-disk cache files that belong to a media file
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "cache_file.h"
+
+#include <framework/mlt_types.h>
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+/** Get the path of a cache file for a file.
+ *
+ * The name identifies the file by its name, size, modification time, and
+ * \p key, which distinguishes the cache files of one file.
+ *
+ * \return the path, which the caller must free, or NULL if the resource is not a file
+ */
+
+char *cache_file_path(const char *directory,
+                      const char *resource,
+                      const char *key,
+                      const char *extension)
+{
+    struct stat info;
+    char text[64];
+    uint64_t hash = 14695981039346656037ULL;
+    const char *c;
+
+    if (!directory || !*directory || !resource || mlt_stat(resource, &info))
+        return NULL;
+
+    // FNV-1a of the identity of the file
+    snprintf(text,
+             sizeof(text),
+             "\n%" PRId64 "\n%" PRId64 "%s",
+             (int64_t) info.st_size,
+             (int64_t) info.st_mtime,
+             key);
+    for (c = resource; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    for (c = text; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+
+    size_t size = strlen(directory) + strlen(extension) + 20;
+    char *path = malloc(size);
+    if (path)
+        snprintf(path, size, "%s/%016" PRIx64 "%s", directory, hash, extension);
+    return path;
+}
+
+/** Get the size and modification time of a file, which are 0 if it does not exist.
+ */
+
+void cache_file_stat(const char *resource, int64_t *size, int64_t *mtime)
+{
+    struct stat info;
+
+    *size = 0;
+    *mtime = 0;
+    if (!mlt_stat(resource, &info)) {
+        *size = info.st_size;
+        *mtime = info.st_mtime;
+    }
+}
+
+/** Open a temporary file to write a cache file.
+ *
+ * The name of the temporary file is unique, so processes and threads that
+ * write the same cache file at once never write to the same temporary file.
+ *
+ * \param[out] temp the path of the temporary file, which cache_file_commit frees
+ * \return the file, or NULL on error
+ */
+
+FILE *cache_file_create(const char *path, char **temp)
+{
+    size_t size = strlen(path) + 32;
+    FILE *file = NULL;
+
+    *temp = malloc(size);
+    if (*temp) {
+#ifdef _WIN32
+        static atomic_uint counter = 0;
+        snprintf(*temp, size, "%s.%d.%u", path, _getpid(), atomic_fetch_add(&counter, 1));
+        file = mlt_fopen(*temp, "wb");
+#else
+        snprintf(*temp, size, "%s.XXXXXX", path);
+        int fd = mkstemp(*temp);
+        if (fd >= 0) {
+            // mkstemp makes the file private, but cache files are read like any other.
+            fchmod(fd, 0644);
+            file = fdopen(fd, "w");
+            if (!file) {
+                close(fd);
+                remove(*temp);
+            }
+        }
+#endif
+        if (!file) {
+            free(*temp);
+            *temp = NULL;
+        }
+    }
+    return file;
+}
+
+/** Close a temporary file and let it replace the cache file.
+ *
+ * Other processes never read a partial cache file. On error the temporary
+ * file is removed.
+ *
+ * \return true on error
+ */
+
+int cache_file_commit(FILE *file, const char *path, char *temp)
+{
+    int error = ferror(file);
+
+    error = fclose(file) || error;
+#ifdef _WIN32
+    if (!error)
+        remove(path);
+#endif
+    if (error || rename(temp, path)) {
+        remove(temp);
+        error = 1;
+    }
+    free(temp);
+    return error;
+}
@@ -0,0 +1,34 @@
+/*
+ * cache_file.h
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+char *cache_file_path(const char *directory,
+                      const char *resource,
+                      const char *key,
+                      const char *extension);
+void cache_file_stat(const char *resource, int64_t *size, int64_t *mtime);
+FILE *cache_file_create(const char *path, char **temp);
+int cache_file_commit(FILE *file, const char *path, char *temp);
+
+#endif // CACHE_FILE_H
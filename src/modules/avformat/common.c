@@ -23,6 +23,9 @@
 #include <libavutil/pixdesc.h>
 #include <libavutil/samplefmt.h>
 
+#include <ctype.h>
+#include <string.h>
+
 int mlt_get_sws_flags(
     int srcwidth, int srcheight, int srcformat, int dstwidth, int dstheight, int dstformat)
 {
@@ -456,3 +459,35 @@ void avframe_to_mlt_image(AVFrame *avframe, mlt_image image)
         }
     }
 }
+
+int mlt_avfilter_options_vary(mlt_properties properties, const char *prefix)
+{
+    // Expression variables and functions whose value depends on the frames seen before
+    static const char *names[]
+        = {"n", "N", "t", "T", "pts", "PTS", "time", "frame", "pos", "random"};
+    size_t prefix_len = strlen(prefix);
+    int i, count = mlt_properties_count(properties);
+
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value;
+        if (!name || strncmp(name, prefix, prefix_len))
+            continue;
+        value = mlt_properties_get_value(properties, i);
+        while (value && *value) {
+            const char *start = value;
+            size_t j;
+            if (!isalpha((unsigned char) *value) && *value != '_') {
+                value++;
+                continue;
+            }
+            while (isalnum((unsigned char) *value) || *value == '_')
+                value++;
+            for (j = 0; j < sizeof(names) / sizeof(names[0]); j++)
+                if (strlen(names[j]) == (size_t) (value - start)
+                    && !strncmp(names[j], start, value - start))
+                    return 1;
+        }
+    }
+    return 0;
+}
@@ -46,5 +46,6 @@ int mlt_to_av_image_format(mlt_image_format format);
 mlt_image_format mlt_get_supported_image_format(mlt_image_format format);
 void mlt_image_to_avframe(mlt_image image, mlt_frame mltframe, AVFrame *avframe);
 void avframe_to_mlt_image(AVFrame *avframe, mlt_image image);
+int mlt_avfilter_options_vary(mlt_properties properties, const char *prefix);
 
 #endif // COMMON_H
@@ -20,6 +20,7 @@
 #include "common.h"
 
 // mlt Header files
+#include <framework/mlt_audio.h>
 #include <framework/mlt_consumer.h>
 #include <framework/mlt_events.h>
 #include <framework/mlt_frame.h>
@@ -60,15 +61,9 @@
 #define VIDEO_BUFFER_SIZE (8192 * 8192)
 #define IMAGE_ALIGN (4)
 
-//
-// This structure should be extended and made globally available in mlt
-//
-
 typedef struct
 {
-    uint8_t *buffer;
-    int size;
-    int used;
+    mlt_audio_fifo buffer;
     double time;
     int frequency;
     int channels;
@@ -77,6 +72,8 @@ typedef struct
 sample_fifo sample_fifo_init(int frequency, int channels)
 {
     sample_fifo fifo = calloc(1, sizeof(sample_fifo_s));
+    // Start with room for one second of 32-bit samples.
+    fifo->buffer = mlt_audio_fifo_new(frequency * channels * 4);
     fifo->frequency = frequency;
     fifo->channels = channels;
     return fifo;
@@ -85,28 +82,17 @@ sample_fifo sample_fifo_init(int frequency, int channels)
 // count is the number of samples multiplied by the number of bytes per sample
 void sample_fifo_append(sample_fifo fifo, uint8_t *samples, int count)
 {
-    if ((fifo->size - fifo->used) < count) {
-        fifo->size += count * 5;
-        fifo->buffer = realloc(fifo->buffer, fifo->size);
-    }
-
-    memcpy(&fifo->buffer[fifo->used], samples, count);
-    fifo->used += count;
+    mlt_audio_fifo_write(fifo->buffer, samples, count);
 }
 
 int sample_fifo_used(sample_fifo fifo)
 {
-    return fifo->used;
+    return mlt_audio_fifo_used(fifo->buffer);
 }
 
 int sample_fifo_fetch(sample_fifo fifo, uint8_t *samples, int count)
 {
-    if (count > fifo->used)
-        count = fifo->used;
-
-    memcpy(samples, fifo->buffer, count);
-    fifo->used -= count;
-    memmove(fifo->buffer, &fifo->buffer[count], fifo->used);
+    count = mlt_audio_fifo_read(fifo->buffer, samples, count);
 
     fifo->time += (double) count / fifo->channels / fifo->frequency;
 
@@ -115,7 +101,7 @@ int sample_fifo_fetch(sample_fifo fifo, uint8_t *samples, int count)
 
 void sample_fifo_close(sample_fifo fifo)
 {
-    free(fifo->buffer);
+    mlt_audio_fifo_close(fifo->buffer);
     free(fifo);
 }
 
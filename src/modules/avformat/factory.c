@@ -63,6 +63,10 @@ static void avformat_init()
             int n = atoi(getenv("MLT_AVFORMAT_PRODUCER_CACHE"));
             mlt_service_cache_set_size(NULL, "producer_avformat", n);
         }
+        if (getenv("MLT_AVFORMAT_PRODUCER_IDLE")) {
+            int n = atoi(getenv("MLT_AVFORMAT_PRODUCER_IDLE"));
+            mlt_service_cache_set_max_idle(NULL, "producer_avformat", n);
+        }
     }
 }
 
@@ -484,6 +488,15 @@ MLT_REPOSITORY
                             (mlt_destructor) mlt_properties_close,
                             NULL);
 
+    // Load a list of image filters that carry no state from one frame to the next.
+    snprintf(dirname, PATH_MAX, "%s/avformat/stateless.txt", mlt_environment("MLT_DATA"));
+    mlt_properties_set_data(mlt_global_properties(),
+                            "avfilter.stateless",
+                            mlt_properties_load(dirname),
+                            0,
+                            (mlt_destructor) mlt_properties_close,
+                            NULL);
+
     // Load a list of parameters impacted by consumer scale into global properties.
     snprintf(dirname, PATH_MAX, "%s/avformat/resolution_scale.yml", mlt_environment("MLT_DATA"));
     mlt_properties_set_data(mlt_global_properties(),
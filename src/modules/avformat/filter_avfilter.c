@@ -40,7 +40,7 @@
 #define PARAM_PREFIX "av."
 #define PARAM_PREFIX_LEN (sizeof(PARAM_PREFIX) - 1)
 
-typedef struct
+typedef struct private_data_s
 {
     AVFilter *avfilter;
     AVFilterContext *avbuffsink_ctx;
@@ -55,6 +55,11 @@ typedef struct
     int width;
     int height;
     int reset;
+    int stateful;                ///< whether frames must pass through one graph in order
+    int generation;              ///< incremented when the image graphs must be reset
+    struct private_data_s *idle; ///< the image graphs not in use, if not stateful
+    struct private_data_s *next; ///< the next graph in the list of idle graphs
+    int graphs;                  ///< the number of image graphs created for the pool
 } private_data;
 
 #if LIBAVUTIL_VERSION_INT >= ((56 << 16) + (35 << 8) + 101)
@@ -69,10 +74,13 @@ static void property_changed(mlt_service owner, mlt_filter filter, mlt_event_dat
     const char *name = mlt_event_data_to_string(event_data);
     if (name && strncmp(PARAM_PREFIX, name, PARAM_PREFIX_LEN) == 0) {
         private_data *pdata = (private_data *) filter->child;
-        if (pdata->avfilter_ctx) {
+        if (pdata->avfilter_ctx || !pdata->stateful) {
             mlt_service_lock(MLT_FILTER_SERVICE(filter));
-            const AVOption *opt
-                = av_opt_find(pdata->avfilter_ctx->priv, name + PARAM_PREFIX_LEN, 0, 0, 0);
+            const AVOption *opt = av_opt_find(&pdata->avfilter->priv_class,
+                                              name + PARAM_PREFIX_LEN,
+                                              0,
+                                              0,
+                                              AV_OPT_SEARCH_FAKE_OBJ);
 #if LIBAVUTIL_VERSION_INT >= ((56 << 16) + (35 << 8) + 101)
             pdata->reset = opt
                            && !(animatable_avoption(opt)
@@ -80,14 +88,15 @@ static void property_changed(mlt_service owner, mlt_filter filter, mlt_event_dat
 #else
             pdata->reset = opt && !mlt_properties_is_anim(MLT_FILTER_PROPERTIES(filter), name);
 #endif
+            if (pdata->reset)
+                pdata->generation++;
             mlt_service_unlock(MLT_FILTER_SERVICE(filter));
         }
     }
 }
 
-static void set_avfilter_options(mlt_filter filter, double scale)
+static void set_avfilter_options(mlt_filter filter, private_data *pdata, double scale)
 {
-    private_data *pdata = (private_data *) filter->child;
     mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
     int i;
     int count = mlt_properties_count(filter_properties);
@@ -331,7 +340,7 @@ static void init_audio_filtergraph(mlt_filter filter,
         mlt_log_error(filter, "Cannot create audio filter\n");
         goto fail;
     }
-    set_avfilter_options(filter, 1.0);
+    set_avfilter_options(filter, pdata, 1.0);
     ret = avfilter_init_str(pdata->avfilter_ctx, NULL);
     if (ret < 0) {
         mlt_log_error(filter, "Cannot init filter\n");
@@ -363,10 +372,13 @@ fail:
     avfilter_graph_free(&pdata->avfilter_graph);
 }
 
-static void init_image_filtergraph(
-    mlt_filter filter, mlt_image_format format, int width, int height, double resolution_scale)
+static void init_image_filtergraph(mlt_filter filter,
+                                   private_data *pdata,
+                                   mlt_image_format format,
+                                   int width,
+                                   int height,
+                                   double resolution_scale)
 {
-    private_data *pdata = (private_data *) filter->child;
     mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
     const AVFilter *buffersrc = avfilter_get_by_name("buffer");
     const AVFilter *buffersink = avfilter_get_by_name("buffersink");
@@ -479,7 +491,7 @@ static void init_image_filtergraph(
         mlt_log_error(filter, "Cannot create video filter\n");
         goto fail;
     }
-    set_avfilter_options(filter, resolution_scale);
+    set_avfilter_options(filter, pdata, resolution_scale);
 
     if (!strcmp("lut3d", pdata->avfilter->name)) {
 #if defined(__GLIBC__) || defined(__APPLE__) || (__FreeBSD__)
@@ -761,6 +773,50 @@ exit:
     return 0;
 }
 
+/** Get a graph to filter an image.
+ *
+ * A stateful filter has a single graph, which the caller uses with the filter
+ * locked. So does a stateless filter with an option that refers to the frame
+ * number or time, because each graph counts only the frames it has seen.
+ * Otherwise each concurrent caller gets a graph of its own from a pool, and it
+ * returns the graph to the pool when done. The number of graphs created for
+ * the pool is kept in the _avfilter.graphs property.
+ * The filter must be locked.
+ */
+
+static private_data *acquire_image_graph(mlt_filter filter)
+{
+    private_data *pdata = (private_data *) filter->child;
+    private_data *graph = pdata->idle;
+
+    if (pdata->stateful || mlt_avfilter_options_vary(MLT_FILTER_PROPERTIES(filter), PARAM_PREFIX))
+        return pdata;
+    if (graph) {
+        pdata->idle = graph->next;
+        return graph;
+    }
+    graph = calloc(1, sizeof(private_data));
+    if (!graph)
+        return pdata;
+    graph->avfilter = pdata->avfilter;
+    graph->avinframe = av_frame_alloc();
+    graph->avoutframe = av_frame_alloc();
+    graph->format = -1;
+    graph->width = -1;
+    graph->height = -1;
+    graph->reset = 1;
+    mlt_properties_set_int(MLT_FILTER_PROPERTIES(filter), "_avfilter.graphs", ++pdata->graphs);
+    return graph;
+}
+
+static void free_graph(private_data *graph)
+{
+    avfilter_graph_free(&graph->avfilter_graph);
+    av_frame_free(&graph->avinframe);
+    av_frame_free(&graph->avoutframe);
+    free(graph);
+}
+
 static int filter_get_image(mlt_frame frame,
                             uint8_t **image,
                             mlt_image_format *format,
@@ -788,56 +844,64 @@ static int filter_get_image(mlt_frame frame,
     mlt_service_lock(MLT_FILTER_SERVICE(filter));
 
     double scale = mlt_profile_scale_width(profile, *width);
-
-    if (pdata->reset || pdata->format != *format || pdata->width != *width
-        || pdata->height != *height) {
-        init_image_filtergraph(filter, *format, *width, *height, scale);
-        pdata->reset = 0;
-    }
-
-    if (pdata->avfilter_graph) {
-        pdata->avinframe->width = *width;
-        pdata->avinframe->height = *height;
-        pdata->avinframe->format = mlt_to_av_image_format(*format);
-        pdata->avinframe->sample_aspect_ratio = (AVRational){profile->sample_aspect_num,
+    private_data *graph = acquire_image_graph(filter);
+
+    if (graph->reset || graph->generation != pdata->generation || graph->format != *format
+        || graph->width != *width || graph->height != *height) {
+        init_image_filtergraph(filter, graph, *format, *width, *height, scale);
+        graph->reset = 0;
+        graph->generation = pdata->generation;
+    }
+    if (graph->avfilter_graph)
+        send_avformat_commands(filter, frame, graph, scale);
+
+    // Other frames can use other graphs meanwhile
+    if (graph != pdata)
+        mlt_service_unlock(MLT_FILTER_SERVICE(filter));
+
+    if (graph->avfilter_graph) {
+        graph->avinframe->width = *width;
+        graph->avinframe->height = *height;
+        graph->avinframe->format = mlt_to_av_image_format(*format);
+        graph->avinframe->sample_aspect_ratio = (AVRational){profile->sample_aspect_num,
                                                              profile->sample_aspect_den};
-        pdata->avinframe->pts = pos;
-        pdata->avinframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
+        graph->avinframe->pts = pos;
+        graph->avinframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
                                                                      "progressive");
-        pdata->avinframe->top_field_first = mlt_properties_get_int(frame_properties,
+        graph->avinframe->top_field_first = mlt_properties_get_int(frame_properties,
                                                                    "top_field_first");
-        pdata->avinframe->color_primaries = mlt_properties_get_int(frame_properties,
+        graph->avinframe->color_primaries = mlt_properties_get_int(frame_properties,
                                                                    "color_primaries");
-        pdata->avinframe->color_trc = mlt_properties_get_int(frame_properties, "color_trc");
+        graph->avinframe->color_trc = mlt_properties_get_int(frame_properties, "color_trc");
         // Setting full_range here causes full range input to always be down-converted to limited
         // range when operating in YUV, regardless of the consumer.color_range -- for each avfilter!
-        // pdata->avinframe->color_range = mlt_properties_get_int(frame_properties, "full_range")
+        // graph->avinframe->color_range = mlt_properties_get_int(frame_properties, "full_range")
         //                                     ? AVCOL_RANGE_JPEG
         //                                     : AVCOL_RANGE_MPEG;
 
         if (*format == mlt_image_rgb || *format == mlt_image_rgba) {
-            pdata->avinframe->colorspace = AVCOL_SPC_RGB;
+            graph->avinframe->colorspace = AVCOL_SPC_RGB;
         } else {
             switch (mlt_properties_get_int(frame_properties, "colorspace")) {
             case 240:
-                pdata->avinframe->colorspace = AVCOL_SPC_SMPTE240M;
+                graph->avinframe->colorspace = AVCOL_SPC_SMPTE240M;
                 break;
             case 601:
-                pdata->avinframe->colorspace = AVCOL_SPC_BT470BG;
+                graph->avinframe->colorspace = AVCOL_SPC_BT470BG;
                 break;
             case 709:
-                pdata->avinframe->colorspace = AVCOL_SPC_BT709;
+                graph->avinframe->colorspace = AVCOL_SPC_BT709;
                 break;
             case 2020:
-                pdata->avinframe->colorspace = AVCOL_SPC_BT2020_NCL;
+                graph->avinframe->colorspace = AVCOL_SPC_BT2020_NCL;
                 break;
             case 2021:
-                pdata->avinframe->colorspace = AVCOL_SPC_BT2020_CL;
+                graph->avinframe->colorspace = AVCOL_SPC_BT2020_CL;
                 break;
             }
         }
 
-        ret = av_frame_get_buffer(pdata->avinframe, 1);
+        ret = av_frame_get_buffer(graph->avinframe, 1);
         if (ret < 0) {
             mlt_log_error(filter, "Cannot get in frame buffer\n");
         }
@@ -856,9 +920,9 @@ static int filter_get_image(mlt_frame frame,
             }
             mlt_image_format_planes(*format, *width, *height, *image, planes, strides);
             for (p = 0; p < 3; p++) {
-                uint8_t *const dst = pdata->avinframe->data[p];
+                uint8_t *const dst = graph->avinframe->data[p];
                 for (i = 0; i < heights[p]; i++) {
-                    memcpy(&dst[i * pdata->avinframe->linesize[p]],
+                    memcpy(&dst[i * graph->avinframe->linesize[p]],
                            &planes[p][i * strides[p]],
                            strides[p]);
                 }
@@ -866,28 +930,27 @@ static int filter_get_image(mlt_frame frame,
         } else {
             int i;
             uint8_t *src = *image;
-            uint8_t *dst = pdata->avinframe->data[0];
+            uint8_t *dst = graph->avinframe->data[0];
             int stride = mlt_image_format_size(*format, *width, 1, NULL);
             for (i = 0; i < *height; i++) {
                 memcpy(dst, src, stride);
                 src += stride;
-                dst += pdata->avinframe->linesize[0];
+                dst += graph->avinframe->linesize[0];
             }
         }
-        send_avformat_commands(filter, frame, pdata, scale);
 
         // Run the frame through the filter graph
-        ret = av_buffersrc_add_frame(pdata->avbuffsrc_ctx, pdata->avinframe);
+        ret = av_buffersrc_add_frame(graph->avbuffsrc_ctx, graph->avinframe);
         if (ret < 0) {
             mlt_log_error(filter, "Cannot add frame to buffer source\n");
         }
-        ret = av_buffersink_get_frame(pdata->avbuffsink_ctx, pdata->avoutframe);
+        ret = av_buffersink_get_frame(graph->avbuffsink_ctx, graph->avoutframe);
         if (ret < 0) {
             mlt_log_error(filter, "Cannot get frame from buffer sink\n");
         }
 
         // Sanity check the output frame
-        if (*width != pdata->avoutframe->width || *height != pdata->avoutframe->height) {
+        if (*width != graph->avoutframe->width || *height != graph->avoutframe->height) {
             mlt_log_error(filter, "Unexpected return format\n");
             goto exit;
         }
@@ -906,29 +969,34 @@ static int filter_get_image(mlt_frame frame,
             }
             mlt_image_format_planes(*format, *width, *height, *image, planes, strides);
             for (p = 0; p < 3; p++) {
-                uint8_t *src = pdata->avoutframe->data[p];
+                uint8_t *src = graph->avoutframe->data[p];
                 for (i = 0; i < heights[p]; i++) {
                     memcpy(&planes[p][i * strides[p]],
-                           &src[i * pdata->avoutframe->linesize[p]],
+                           &src[i * graph->avoutframe->linesize[p]],
                            strides[p]);
                 }
             }
         } else {
             int i;
             uint8_t *dst = *image;
-            uint8_t *src = pdata->avoutframe->data[0];
+            uint8_t *src = graph->avoutframe->data[0];
             int stride = mlt_image_format_size(*format, *width, 1, NULL);
             for (i = 0; i < *height; i++) {
                 memcpy(dst, src, stride);
                 dst += stride;
-                src += pdata->avoutframe->linesize[0];
+                src += graph->avoutframe->linesize[0];
             }
         }
     }
 
 exit:
-    av_frame_unref(pdata->avinframe);
-    av_frame_unref(pdata->avoutframe);
+    av_frame_unref(graph->avinframe);
+    av_frame_unref(graph->avoutframe);
+    if (graph != pdata) {
+        mlt_service_lock(MLT_FILTER_SERVICE(filter));
+        graph->next = pdata->idle;
+        pdata->idle = graph;
+    }
     mlt_service_unlock(MLT_FILTER_SERVICE(filter));
     return 0;
 }
@@ -959,10 +1027,12 @@ static void filter_close(mlt_filter filter)
     private_data *pdata = (private_data *) filter->child;
 
     if (pdata) {
-        avfilter_graph_free(&pdata->avfilter_graph);
-        av_frame_free(&pdata->avinframe);
-        av_frame_free(&pdata->avoutframe);
-        free(pdata);
+        while (pdata->idle) {
+            private_data *graph = pdata->idle;
+            pdata->idle = graph->next;
+            free_graph(graph);
+        }
+        free_graph(pdata);
     }
     filter->child = NULL;
     filter->close = NULL;
@@ -1029,6 +1099,13 @@ mlt_filter filter_avfilter_init(mlt_profile profile,
                 mlt_properties_set_int(MLT_FILTER_PROPERTIES(filter), "_yuv_only", 1);
             }
         }
+
+        // Only frames of image filters known to be without state can pass through separate graphs.
+        mlt_properties stateless = mlt_properties_get_data(mlt_global_properties(),
+                                                           "avfilter.stateless",
+                                                           NULL);
+        pdata->stateful = avfilter_pad_get_type(pdata->avfilter->inputs, 0) != AVMEDIA_TYPE_VIDEO
+                          || !stateless || !mlt_properties_get(stateless, id);
     } else {
         mlt_filter_close(filter);
         free(pdata);
@@ -0,0 +1,295 @@
+/*
+ * keyframe_index.c -- an index of video key frames with an on-disk cache
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "keyframe_index.h"
+#include "cache_file.h"
+
+#include <framework/mlt_types.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYFRAME_INDEX_MAGIC "mlt-keyframe-index 1"
+
+keyframe_index keyframe_index_init()
+{
+    keyframe_index self = calloc(1, sizeof(struct keyframe_index_s));
+    if (self)
+        self->first_pts = INT64_MIN;
+    return self;
+}
+
+void keyframe_index_close(keyframe_index self)
+{
+    if (self) {
+        free(self->keys);
+        free(self->ranges);
+        free(self);
+    }
+}
+
+/** Find the first key that is not less than a timestamp. */
+
+static int find_key(keyframe_index self, int64_t pts)
+{
+    int low = 0, high = self->key_count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (self->keys[middle] < pts)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/** Find the first range that does not end before a timestamp. */
+
+static int find_range(keyframe_index self, int64_t pts)
+{
+    int low = 0, high = self->range_count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (self->ranges[middle][1] < pts)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/** Add the timestamp of a key frame. */
+
+void keyframe_index_add(keyframe_index self, int64_t pts)
+{
+    int i = find_key(self, pts);
+
+    if (i < self->key_count && self->keys[i] == pts)
+        return;
+    if (self->key_count == self->key_size) {
+        int size = self->key_size ? self->key_size * 2 : 256;
+        int64_t *keys = realloc(self->keys, size * sizeof(*keys));
+        if (!keys)
+            return;
+        self->keys = keys;
+        self->key_size = size;
+    }
+    memmove(&self->keys[i + 1], &self->keys[i], (self->key_count - i) * sizeof(*self->keys));
+    self->keys[i] = pts;
+    self->key_count++;
+    self->dirty = 1;
+}
+
+/** Record that every key frame from start to end was added. */
+
+void keyframe_index_cover(keyframe_index self, int64_t start, int64_t end)
+{
+    int i = find_range(self, start);
+    int j;
+
+    if (self->complete || end < start)
+        return;
+
+    // Usually this extends the range being read by one packet.
+    if (i < self->range_count && self->ranges[i][0] <= start && self->ranges[i][1] >= end)
+        return;
+
+    if (i == self->range_count || self->ranges[i][0] > end) {
+        // Insert a new range
+        if (self->range_count == self->range_size) {
+            int size = self->range_size ? self->range_size * 2 : 16;
+            int64_t(*ranges)[2] = realloc(self->ranges, size * sizeof(*ranges));
+            if (!ranges)
+                return;
+            self->ranges = ranges;
+            self->range_size = size;
+        }
+        memmove(&self->ranges[i + 1],
+                &self->ranges[i],
+                (self->range_count - i) * sizeof(*self->ranges));
+        self->ranges[i][0] = start;
+        self->ranges[i][1] = end;
+        self->range_count++;
+    } else {
+        // Extend the range and absorb the ranges it now overlaps
+        if (start < self->ranges[i][0])
+            self->ranges[i][0] = start;
+        if (end > self->ranges[i][1])
+            self->ranges[i][1] = end;
+        for (j = i + 1; j < self->range_count && self->ranges[j][0] <= self->ranges[i][1]; j++)
+            if (self->ranges[j][1] > self->ranges[i][1])
+                self->ranges[i][1] = self->ranges[j][1];
+        memmove(&self->ranges[i + 1],
+                &self->ranges[j],
+                (self->range_count - j) * sizeof(*self->ranges));
+        self->range_count -= j - i - 1;
+    }
+    self->dirty = 1;
+}
+
+static int is_covered(keyframe_index self, int64_t start, int64_t end)
+{
+    int i = find_range(self, end);
+    return self->complete
+           || (i < self->range_count && self->ranges[i][0] <= start && self->ranges[i][1] >= end);
+}
+
+/** Find the nearest key frame at or before a timestamp.
+ *
+ * \param key receives the timestamp of the key frame
+ * \return true if it is known to be the nearest
+ */
+
+int keyframe_index_before(keyframe_index self, int64_t pts, int64_t *key)
+{
+    int i = find_key(self, pts + 1);
+
+    if (i > 0 && is_covered(self, self->keys[i - 1], pts)) {
+        *key = self->keys[i - 1];
+        return 1;
+    }
+    return 0;
+}
+
+/** Check for a key frame after one timestamp and at or before another.
+ *
+ * \return 1 if there is one, 0 if there is none, or -1 if it is unknown
+ */
+
+int keyframe_index_between(keyframe_index self, int64_t start, int64_t end)
+{
+    int i = find_key(self, start + 1);
+
+    if (i < self->key_count && self->keys[i] <= end)
+        return 1;
+    return is_covered(self, start, end) ? 0 : -1;
+}
+
+/** Get the path of the index file for a video stream of a file.
+ *
+ * \return the path, which the caller must free, or NULL if the resource is not a file
+ */
+
+char *keyframe_index_path(const char *directory, const char *resource, int stream)
+{
+    char key[16];
+
+    snprintf(key, sizeof(key), "\n%d", stream);
+    return cache_file_path(directory, resource, key, ".mltkeys");
+}
+
+static void identity(char *text, size_t size, const char *resource, int stream, int num, int den)
+{
+    int64_t file_size, mtime;
+
+    cache_file_stat(resource, &file_size, &mtime);
+    snprintf(text,
+             size,
+             "file %" PRId64 " %" PRId64 " stream %d %d/%d",
+             file_size,
+             mtime,
+             stream,
+             num,
+             den);
+}
+
+/** Load an index from a file.
+ *
+ * The file must match the resource, stream, and time base.
+ *
+ * \return true on error
+ */
+
+int keyframe_index_load(
+    keyframe_index self, const char *path, const char *resource, int stream, int num, int den)
+{
+    char line[4096], expected[256];
+    FILE *file = path ? mlt_fopen(path, "r") : NULL;
+    int error = 1;
+
+    if (!file)
+        return error;
+
+    identity(expected, sizeof(expected), resource, stream, num, den);
+    if (fgets(line, sizeof(line), file)
+        && !strncmp(line, KEYFRAME_INDEX_MAGIC, strlen(KEYFRAME_INDEX_MAGIC))
+        && fgets(line, sizeof(line), file) && !strncmp(line, "resource ", 9)
+        && !strncmp(line + 9, resource, strlen(resource)) && line[9 + strlen(resource)] == '\n'
+        && fgets(line, sizeof(line), file) && !strncmp(line, expected, strlen(expected))
+        && line[strlen(expected)] == '\n') {
+        int64_t a, b;
+        int n;
+
+        error = 0;
+        while (!error && fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "key %" SCNd64, &a) == 1)
+                keyframe_index_add(self, a);
+            else if (sscanf(line, "range %" SCNd64 " %" SCNd64, &a, &b) == 2)
+                keyframe_index_cover(self, a, b);
+            else if (sscanf(line, "first_pts %" SCNd64, &a) == 1)
+                self->first_pts = a;
+            else if (sscanf(line, "vfr %d", &n) == 1)
+                self->vfr = n;
+            else if (sscanf(line, "complete %d", &n) == 1)
+                self->complete = n;
+            else
+                error = 1;
+        }
+        self->dirty = 0;
+    }
+    fclose(file);
+    return error;
+}
+
+/** Save an index to a file.
+ *
+ * The index is written to a temporary file that replaces the file, so that
+ * other processes never read a partial index.
+ *
+ * \return true on error
+ */
+
+int keyframe_index_save(
+    keyframe_index self, const char *path, const char *resource, int stream, int num, int den)
+{
+    char text[256];
+    char *temp = NULL;
+    FILE *file = cache_file_create(path, &temp);
+    int i, error = 1;
+
+    if (file) {
+        identity(text, sizeof(text), resource, stream, num, den);
+        fprintf(file, "%s\nresource %s\n%s\n", KEYFRAME_INDEX_MAGIC, resource, text);
+        fprintf(file, "first_pts %" PRId64 "\nvfr %d\n", self->first_pts, self->vfr);
+        fprintf(file, "complete %d\n", self->complete);
+        for (i = 0; i < self->range_count; i++)
+            fprintf(file,
+                    "range %" PRId64 " %" PRId64 "\n",
+                    self->ranges[i][0],
+                    self->ranges[i][1]);
+        for (i = 0; i < self->key_count; i++)
+            fprintf(file, "key %" PRId64 "\n", self->keys[i]);
+        error = cache_file_commit(file, path, temp);
+        if (!error)
+            self->dirty = 0;
+    }
+    return error;
+}
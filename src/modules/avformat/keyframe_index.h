@@ -0,0 +1,60 @@
+/*
+ * keyframe_index.h
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef KEYFRAME_INDEX_H
+#define KEYFRAME_INDEX_H
+
+#include <stdint.h>
+
+/** An index of the key frame timestamps of a video stream.
+ *
+ * The index also records which ranges of timestamps were read completely, so
+ * that the absence of a key frame in a range is known rather than assumed.
+ * It does no locking of its own.
+ */
+
+typedef struct keyframe_index_s *keyframe_index;
+
+struct keyframe_index_s
+{
+    int64_t *keys;        ///< sorted key frame timestamps
+    int key_count;        ///< the number of keys
+    int key_size;         ///< the allocated number of keys
+    int64_t (*ranges)[2]; ///< sorted, disjoint ranges of timestamps read completely
+    int range_count;      ///< the number of ranges
+    int range_size;       ///< the allocated number of ranges
+    int complete;         ///< whether the whole stream was read
+    int dirty;            ///< whether the index changed since it was loaded or saved
+    int64_t first_pts;    ///< the timestamp of the first key frame, INT64_MIN if unknown
+    int vfr;              ///< whether the stream has a variable frame rate
+};
+
+keyframe_index keyframe_index_init();
+void keyframe_index_close(keyframe_index self);
+void keyframe_index_add(keyframe_index self, int64_t pts);
+void keyframe_index_cover(keyframe_index self, int64_t start, int64_t end);
+int keyframe_index_before(keyframe_index self, int64_t pts, int64_t *key);
+int keyframe_index_between(keyframe_index self, int64_t start, int64_t end);
+char *keyframe_index_path(const char *directory, const char *resource, int stream);
+int keyframe_index_load(
+    keyframe_index self, const char *path, const char *resource, int stream, int num, int den);
+int keyframe_index_save(
+    keyframe_index self, const char *path, const char *resource, int stream, int num, int den);
+
+#endif // KEYFRAME_INDEX_H
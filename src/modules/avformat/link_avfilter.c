@@ -40,7 +40,7 @@
 #define PARAM_PREFIX "av."
 #define PARAM_PREFIX_LEN (sizeof(PARAM_PREFIX) - 1)
 
-typedef struct
+typedef struct private_data_s
 {
     AVFilter *avfilter;
     AVFilterContext *avbuffsink_ctx;
@@ -59,6 +59,10 @@ typedef struct
     int reset;
     mlt_position expected_frame;
     mlt_position continuity_frame;
+    int stateful;                ///< whether frames must pass through one graph in order
+    int generation;              ///< incremented when the image graphs must be reset
+    struct private_data_s *idle; ///< the image graphs not in use, if not stateful
+    struct private_data_s *next; ///< the next graph in the list of idle graphs
 } private_data;
 
 #if LIBAVUTIL_VERSION_INT >= ((56 << 16) + (35 << 8) + 101)
@@ -73,10 +77,13 @@ static void property_changed(mlt_service owner, mlt_link self, mlt_event_data ev
     const char *name = mlt_event_data_to_string(event_data);
     if (name && strncmp(PARAM_PREFIX, name, PARAM_PREFIX_LEN) == 0) {
         private_data *pdata = (private_data *) self->child;
-        if (pdata->avfilter_ctx) {
+        if (pdata->avfilter_ctx || !pdata->stateful) {
             mlt_service_lock(MLT_LINK_SERVICE(self));
-            const AVOption *opt
-                = av_opt_find(pdata->avfilter_ctx->priv, name + PARAM_PREFIX_LEN, 0, 0, 0);
+            const AVOption *opt = av_opt_find(&pdata->avfilter->priv_class,
+                                              name + PARAM_PREFIX_LEN,
+                                              0,
+                                              0,
+                                              AV_OPT_SEARCH_FAKE_OBJ);
 #if LIBAVUTIL_VERSION_INT >= ((56 << 16) + (35 << 8) + 101)
             pdata->reset = opt
                            && !(animatable_avoption(opt)
@@ -84,6 +91,8 @@ static void property_changed(mlt_service owner, mlt_link self, mlt_event_data ev
 #else
             pdata->reset = opt && !mlt_properties_is_anim(MLT_LINK_PROPERTIES(self), name);
 #endif
+            if (pdata->reset)
+                pdata->generation++;
             mlt_service_unlock(MLT_LINK_SERVICE(self));
         }
     }
@@ -112,9 +121,8 @@ static int future_frames_needed(mlt_link self)
     return future_frames;
 }
 
-static void set_avfilter_options(mlt_link self, double scale)
+static void set_avfilter_options(mlt_link self, private_data *pdata, double scale)
 {
-    private_data *pdata = (private_data *) self->child;
     mlt_properties link_properties = MLT_LINK_PROPERTIES(self);
     int i;
     int count = mlt_properties_count(link_properties);
@@ -356,7 +364,7 @@ static void init_audio_filtergraph(mlt_link self,
         mlt_log_error(self, "Cannot create audio filter\n");
         goto fail;
     }
-    set_avfilter_options(self, 1.0);
+    set_avfilter_options(self, pdata, 1.0);
     ret = avfilter_init_str(pdata->avfilter_ctx, NULL);
     if (ret < 0) {
         mlt_log_error(self, "Cannot init filter\n");
@@ -388,10 +396,13 @@ fail:
     avfilter_graph_free(&pdata->avfilter_graph);
 }
 
-static void init_image_filtergraph(
-    mlt_link self, mlt_image_format format, int width, int height, double resolution_scale)
+static void init_image_filtergraph(mlt_link self,
+                                   private_data *pdata,
+                                   mlt_image_format format,
+                                   int width,
+                                   int height,
+                                   double resolution_scale)
 {
-    private_data *pdata = (private_data *) self->child;
     mlt_profile profile = mlt_service_profile(MLT_LINK_SERVICE(self));
     const AVFilter *buffersrc = avfilter_get_by_name("buffer");
     const AVFilter *buffersink = avfilter_get_by_name("buffersink");
@@ -504,7 +515,7 @@ static void init_image_filtergraph(
         mlt_log_error(self, "Cannot create video filter\n");
         goto fail;
     }
-    set_avfilter_options(self, resolution_scale);
+    set_avfilter_options(self, pdata, resolution_scale);
 
     if (!strcmp("lut3d", pdata->avfilter->name)) {
 #if defined(__GLIBC__) || defined(__APPLE__) || (__FreeBSD__)
@@ -877,6 +888,48 @@ static int link_get_audio(mlt_frame frame,
     return error;
 }
 
+/** Get a graph to filter an image.
+ *
+ * A stateful filter has a single graph, which the caller uses with the link
+ * locked. So does a stateless filter with an option that refers to the frame
+ * number or time, because each graph counts only the frames it has seen.
+ * Otherwise each concurrent caller gets a graph of its own from a pool, and it
+ * returns the graph to the pool when done.
+ * The link must be locked.
+ */
+
+static private_data *acquire_image_graph(mlt_link self)
+{
+    private_data *pdata = (private_data *) self->child;
+    private_data *graph = pdata->idle;
+
+    if (pdata->stateful || mlt_avfilter_options_vary(MLT_LINK_PROPERTIES(self), PARAM_PREFIX))
+        return pdata;
+    if (graph) {
+        pdata->idle = graph->next;
+        return graph;
+    }
+    graph = calloc(1, sizeof(private_data));
+    if (!graph)
+        return pdata;
+    graph->avfilter = pdata->avfilter;
+    graph->avinframe = av_frame_alloc();
+    graph->avoutframe = av_frame_alloc();
+    graph->format = -1;
+    graph->width = -1;
+    graph->height = -1;
+    graph->reset = 1;
+    return graph;
+}
+
+static void free_graph(private_data *graph)
+{
+    avfilter_graph_free(&graph->avfilter_graph);
+    av_frame_free(&graph->avinframe);
+    av_frame_free(&graph->avoutframe);
+    free(graph);
+}
+
 static int link_get_image(mlt_frame frame,
                           uint8_t **image,
                           mlt_image_format *format,
@@ -903,50 +956,58 @@ static int link_get_image(mlt_frame frame,
     mlt_service_lock(MLT_LINK_SERVICE(self));
 
     double scale = mlt_profile_scale_width(profile, *width);
-
-    if (pdata->reset || pdata->format != *format || pdata->width != *width
-        || pdata->height != *height) {
-        init_image_filtergraph(self, *format, *width, *height, scale);
-        pdata->reset = 0;
-    }
-
-    if (pdata->avfilter_graph) {
-        pdata->avinframe->width = *width;
-        pdata->avinframe->height = *height;
-        pdata->avinframe->format = mlt_to_av_image_format(*format);
-        pdata->avinframe->sample_aspect_ratio = (AVRational){profile->sample_aspect_num,
+    private_data *graph = acquire_image_graph(self);
+
+    if (graph->reset || graph->generation != pdata->generation || graph->format != *format
+        || graph->width != *width || graph->height != *height) {
+        init_image_filtergraph(self, graph, *format, *width, *height, scale);
+        graph->reset = 0;
+        graph->generation = pdata->generation;
+    }
+    if (graph->avfilter_graph)
+        send_avformat_commands(self, frame, graph, scale);
+
+    // Other frames can use other graphs meanwhile
+    if (graph != pdata)
+        mlt_service_unlock(MLT_LINK_SERVICE(self));
+
+    if (graph->avfilter_graph) {
+        graph->avinframe->width = *width;
+        graph->avinframe->height = *height;
+        graph->avinframe->format = mlt_to_av_image_format(*format);
+        graph->avinframe->sample_aspect_ratio = (AVRational){profile->sample_aspect_num,
                                                              profile->sample_aspect_den};
-        pdata->avinframe->pts = pos;
-        pdata->avinframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
+        graph->avinframe->pts = pos;
+        graph->avinframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
                                                                      "progressive");
-        pdata->avinframe->top_field_first = mlt_properties_get_int(frame_properties,
+        graph->avinframe->top_field_first = mlt_properties_get_int(frame_properties,
                                                                    "top_field_first");
-        pdata->avinframe->color_primaries = mlt_properties_get_int(frame_properties,
+        graph->avinframe->color_primaries = mlt_properties_get_int(frame_properties,
                                                                    "color_primaries");
-        pdata->avinframe->color_trc = mlt_properties_get_int(frame_properties, "color_trc");
-        pdata->avinframe->color_range = mlt_properties_get_int(frame_properties, "full_range")
+        graph->avinframe->color_trc = mlt_properties_get_int(frame_properties, "color_trc");
+        graph->avinframe->color_range = mlt_properties_get_int(frame_properties, "full_range")
                                             ? AVCOL_RANGE_JPEG
                                             : AVCOL_RANGE_MPEG;
 
         switch (mlt_properties_get_int(frame_properties, "colorspace")) {
         case 240:
-            pdata->avinframe->colorspace = AVCOL_SPC_SMPTE240M;
+            graph->avinframe->colorspace = AVCOL_SPC_SMPTE240M;
             break;
         case 601:
-            pdata->avinframe->colorspace = AVCOL_SPC_BT470BG;
+            graph->avinframe->colorspace = AVCOL_SPC_BT470BG;
             break;
         case 709:
-            pdata->avinframe->colorspace = AVCOL_SPC_BT709;
+            graph->avinframe->colorspace = AVCOL_SPC_BT709;
             break;
         case 2020:
-            pdata->avinframe->colorspace = AVCOL_SPC_BT2020_NCL;
+            graph->avinframe->colorspace = AVCOL_SPC_BT2020_NCL;
             break;
         case 2021:
-            pdata->avinframe->colorspace = AVCOL_SPC_BT2020_CL;
+            graph->avinframe->colorspace = AVCOL_SPC_BT2020_CL;
             break;
         }
 
-        ret = av_frame_get_buffer(pdata->avinframe, 1);
+        ret = av_frame_get_buffer(graph->avinframe, 1);
         if (ret < 0) {
             mlt_log_error(self, "Cannot get in frame buffer\n");
         }
@@ -959,38 +1020,37 @@ static int link_get_image(mlt_frame frame,
             int heights[3] = {*height, *height / 2, *height / 2};
             uint8_t *src = *image;
             for (p = 0; p < 3; p++) {
-                uint8_t *dst = pdata->avinframe->data[p];
+                uint8_t *dst = graph->avinframe->data[p];
                 for (i = 0; i < heights[p]; i++) {
                     memcpy(dst, src, widths[p]);
                     src += widths[p];
-                    dst += pdata->avinframe->linesize[p];
+                    dst += graph->avinframe->linesize[p];
                 }
             }
         } else {
             int i;
             uint8_t *src = *image;
-            uint8_t *dst = pdata->avinframe->data[0];
+            uint8_t *dst = graph->avinframe->data[0];
             int stride = mlt_image_format_size(*format, *width, 1, NULL);
             for (i = 0; i < *height; i++) {
                 memcpy(dst, src, stride);
                 src += stride;
-                dst += pdata->avinframe->linesize[0];
+                dst += graph->avinframe->linesize[0];
             }
         }
-        send_avformat_commands(self, frame, pdata, scale);
 
         // Run the frame through the filter graph
-        ret = av_buffersrc_add_frame(pdata->avbuffsrc_ctx, pdata->avinframe);
+        ret = av_buffersrc_add_frame(graph->avbuffsrc_ctx, graph->avinframe);
         if (ret < 0) {
             mlt_log_error(self, "Cannot add frame to buffer source\n");
         }
-        ret = av_buffersink_get_frame(pdata->avbuffsink_ctx, pdata->avoutframe);
+        ret = av_buffersink_get_frame(graph->avbuffsink_ctx, graph->avoutframe);
         if (ret < 0) {
             mlt_log_error(self, "Cannot get frame from buffer sink\n");
         }
 
         // Sanity check the output frame
-        if (*width != pdata->avoutframe->width || *height != pdata->avoutframe->height) {
+        if (*width != graph->avoutframe->width || *height != graph->avoutframe->height) {
             mlt_log_error(self, "Unexpected return format\n");
             goto exit;
         }
@@ -1003,29 +1063,34 @@ static int link_get_image(mlt_frame frame,
             int heights[3] = {*height, *height / 2, *height / 2};
             uint8_t *dst = *image;
             for (p = 0; p < 3; p++) {
-                uint8_t *src = pdata->avoutframe->data[p];
+                uint8_t *src = graph->avoutframe->data[p];
                 for (i = 0; i < heights[p]; i++) {
                     memcpy(dst, src, widths[p]);
                     dst += widths[p];
-                    src += pdata->avoutframe->linesize[p];
+                    src += graph->avoutframe->linesize[p];
                 }
             }
         } else {
             int i;
             uint8_t *dst = *image;
-            uint8_t *src = pdata->avoutframe->data[0];
+            uint8_t *src = graph->avoutframe->data[0];
             int stride = mlt_image_format_size(*format, *width, 1, NULL);
             for (i = 0; i < *height; i++) {
                 memcpy(dst, src, stride);
                 dst += stride;
-                src += pdata->avoutframe->linesize[0];
+                src += graph->avoutframe->linesize[0];
             }
         }
     }
 
 exit:
-    av_frame_unref(pdata->avinframe);
-    av_frame_unref(pdata->avoutframe);
+    av_frame_unref(graph->avinframe);
+    av_frame_unref(graph->avoutframe);
+    if (graph != pdata) {
+        mlt_service_lock(MLT_LINK_SERVICE(self));
+        graph->next = pdata->idle;
+        pdata->idle = graph;
+    }
     mlt_service_unlock(MLT_LINK_SERVICE(self));
     return 0;
 }
@@ -1079,10 +1144,12 @@ static void link_close(mlt_link self)
     if (self) {
         private_data *pdata = (private_data *) self->child;
         if (pdata) {
-            avfilter_graph_free(&pdata->avfilter_graph);
-            av_frame_free(&pdata->avinframe);
-            av_frame_free(&pdata->avoutframe);
-            free(pdata);
+            while (pdata->idle) {
+                private_data *graph = pdata->idle;
+                pdata->idle = graph->next;
+                free_graph(graph);
+            }
+            free_graph(pdata);
         }
         self->close = NULL;
         mlt_link_close(self);
@@ -1146,6 +1213,13 @@ mlt_link link_avfilter_init(mlt_profile profile, mlt_service_type type, const ch
                 mlt_properties_set_int(MLT_LINK_PROPERTIES(self), "_yuv_only", 1);
             }
         }
+
+        // Only frames of image filters known to be without state can pass through separate graphs.
+        mlt_properties stateless = mlt_properties_get_data(mlt_global_properties(),
+                                                           "avfilter.stateless",
+                                                           NULL);
+        pdata->stateful = avfilter_pad_get_type(pdata->avfilter->inputs, 0) != AVMEDIA_TYPE_VIDEO
+                          || !stateless || !mlt_properties_get(stateless, id);
     } else {
         free(pdata);
         mlt_link_close(self);
@@ -0,0 +1,147 @@
+/*
+ * metadata_cache.c -- an on-disk cache of the properties of probed media
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "metadata_cache.h"
+#include "cache_file.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METADATA_CACHE_VERSION "1"
+
+/** Get the path of the cache file for a file.
+ *
+ * \return the path, which the caller must free, or NULL if the resource is not a file
+ */
+
+char *metadata_cache_path(const char *directory, const char *resource)
+{
+    return cache_file_path(directory, resource, "", ".mltmeta");
+}
+
+/** Describe a file and the frame rate of the profile, on which the length depends.
+ */
+
+static void identity(char *text, size_t size, const char *resource, mlt_profile profile)
+{
+    int64_t file_size, mtime;
+
+    cache_file_stat(resource, &file_size, &mtime);
+    snprintf(text,
+             size,
+             "%s %" PRId64 " %" PRId64 " %d/%d",
+             METADATA_CACHE_VERSION,
+             file_size,
+             mtime,
+             profile->frame_rate_num,
+             profile->frame_rate_den);
+}
+
+/** Set the cached properties of a file.
+ *
+ * The file must match the resource and the frame rate of the profile. It must
+ * also hold the stream indices and describe a seekable file, because the
+ * producer opens the file later from those alone.
+ *
+ * \return true on error
+ */
+
+int metadata_cache_load(mlt_properties properties,
+                        const char *path,
+                        const char *resource,
+                        mlt_profile profile)
+{
+    char expected[128];
+    mlt_properties cache = path ? mlt_properties_parse_yaml(path) : NULL;
+    mlt_properties cached = cache ? mlt_properties_get_data(cache, "producer", NULL) : NULL;
+    const char *value;
+    int error = 1;
+
+    identity(expected, sizeof(expected), resource, profile);
+    if (cached && (value = mlt_properties_get(cache, "resource")) && !strcmp(value, resource)
+        && (value = mlt_properties_get(cache, "identity")) && !strcmp(value, expected)
+        && mlt_properties_get_int(cached, "seekable")
+        && mlt_properties_exists(cached, "audio_index")
+        && mlt_properties_exists(cached, "video_index")) {
+        int i, count = mlt_properties_count(cached);
+        for (i = 0; i < count; i++)
+            mlt_properties_set_string(properties,
+                                      mlt_properties_get_name(cached, i),
+                                      mlt_properties_get_value(cached, i));
+        error = 0;
+    }
+    mlt_properties_close(cache);
+    return error;
+}
+
+/** Save the properties of a file.
+ *
+ * Only the serialisable properties are saved, excluding the resource. They are
+ * written to a temporary file that replaces the file, so that other processes
+ * never read a partial file.
+ *
+ * \return true on error
+ */
+
+int metadata_cache_save(mlt_properties properties,
+                        const char *path,
+                        const char *resource,
+                        mlt_profile profile)
+{
+    char text[128];
+    mlt_properties cache = mlt_properties_new();
+    mlt_properties cached = mlt_properties_new();
+    char *yaml = NULL;
+    char *temp = NULL;
+    FILE *file = NULL;
+    int i, error = 1;
+
+    if (cache && cached) {
+        int count = mlt_properties_count(properties);
+
+        identity(text, sizeof(text), resource, profile);
+        mlt_properties_set_string(cache, "resource", resource);
+        mlt_properties_set_string(cache, "identity", text);
+        for (i = 0; i < count; i++) {
+            const char *name = mlt_properties_get_name(properties, i);
+            const char *value = mlt_properties_get_value(properties, i);
+            if (name && value && name[0] != '_' && strcmp(name, "resource"))
+                mlt_properties_set_string(cached, name, value);
+        }
+        mlt_properties_set_data(cache,
+                                "producer",
+                                cached,
+                                0,
+                                (mlt_destructor) mlt_properties_close,
+                                NULL);
+        cached = NULL;
+        yaml = mlt_properties_serialise_yaml(cache);
+        file = yaml ? cache_file_create(path, &temp) : NULL;
+    }
+    if (file) {
+        fputs(yaml, file);
+        error = cache_file_commit(file, path, temp);
+    }
+    free(yaml);
+    mlt_properties_close(cached);
+    mlt_properties_close(cache);
+    return error;
+}
@@ -0,0 +1,36 @@
+/*
+ * metadata_cache.h
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include <framework/mlt_profile.h>
+#include <framework/mlt_properties.h>
+
+char *metadata_cache_path(const char *directory, const char *resource);
+int metadata_cache_load(mlt_properties properties,
+                        const char *path,
+                        const char *resource,
+                        mlt_profile profile);
+int metadata_cache_save(mlt_properties properties,
+                        const char *path,
+                        const char *resource,
+                        mlt_profile profile);
+
+#endif // METADATA_CACHE_H
@@ -0,0 +1,226 @@
+/*
+ * probe_cache.c -- a cache of stream information probed from media files
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "probe_cache.h"
+
+#include <framework/mlt_factory.h>
+#include <framework/mlt_properties.h>
+#include <framework/mlt_types.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PROBE_CACHE_MAX (4096)
+
+/** The information avformat_find_stream_info() adds to a stream. */
+struct probe_stream_s
+{
+    AVCodecParameters *codecpar;
+    AVRational r_frame_rate;
+    AVRational avg_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+};
+
+/** The information avformat_find_stream_info() adds to a file. */
+struct probe_entry_s
+{
+    unsigned int nb_streams;
+    struct probe_stream_s *streams;
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mlt_properties cache = NULL;
+
+static void entry_close(struct probe_entry_s *entry)
+{
+    if (entry) {
+        unsigned int i;
+        for (i = 0; i < entry->nb_streams; i++)
+            avcodec_parameters_free(&entry->streams[i].codecpar);
+        free(entry->streams);
+        free(entry);
+    }
+}
+
+static void cache_close(mlt_properties properties)
+{
+    pthread_mutex_lock(&cache_mutex);
+    mlt_properties_close(properties);
+    cache = NULL;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+/** Get the cache key of a file from its name, size, and modification time.
+ *
+ * \return the key, which the caller must free, or NULL if the resource is not a file
+ */
+
+static char *cache_key(const char *resource)
+{
+    struct stat info;
+    char *key = NULL;
+
+    if (resource && !mlt_stat(resource, &info)) {
+        size_t size = strlen(resource) + 48;
+        key = malloc(size);
+        if (key)
+            snprintf(key,
+                     size,
+                     "%" PRId64 " %" PRId64 " %s",
+                     (int64_t) info.st_size,
+                     (int64_t) info.st_mtime,
+                     resource);
+    }
+    return key;
+}
+
+/** Check that the demuxer found the same streams as when the entry was probed.
+ *
+ * Only files whose header identifies every stream qualify, so that the cached
+ * information merely completes what the demuxer already knows.
+ */
+
+static int entry_matches(struct probe_entry_s *entry, AVFormatContext *context)
+{
+    unsigned int i;
+
+    if (entry->nb_streams != context->nb_streams)
+        return 0;
+    for (i = 0; i < context->nb_streams; i++) {
+        AVCodecParameters *codecpar = context->streams[i]->codecpar;
+        if (codecpar->codec_id == AV_CODEC_ID_NONE
+            || codecpar->codec_type != entry->streams[i].codecpar->codec_type
+            || codecpar->codec_id != entry->streams[i].codecpar->codec_id)
+            return 0;
+    }
+    return 1;
+}
+
+static void entry_apply(struct probe_entry_s *entry, AVFormatContext *context)
+{
+    unsigned int i;
+
+    for (i = 0; i < context->nb_streams; i++) {
+        AVStream *stream = context->streams[i];
+        struct probe_stream_s *cached = &entry->streams[i];
+        avcodec_parameters_copy(stream->codecpar, cached->codecpar);
+        stream->r_frame_rate = cached->r_frame_rate;
+        stream->avg_frame_rate = cached->avg_frame_rate;
+        stream->sample_aspect_ratio = cached->sample_aspect_ratio;
+        stream->start_time = cached->start_time;
+        stream->duration = cached->duration;
+        stream->nb_frames = cached->nb_frames;
+    }
+    context->start_time = entry->start_time;
+    context->duration = entry->duration;
+    context->bit_rate = entry->bit_rate;
+}
+
+static struct probe_entry_s *entry_new(AVFormatContext *context)
+{
+    struct probe_entry_s *entry = calloc(1, sizeof(*entry));
+    unsigned int i;
+
+    if (!entry)
+        return NULL;
+    entry->streams = calloc(context->nb_streams, sizeof(*entry->streams));
+    if (!entry->streams && context->nb_streams) {
+        free(entry);
+        return NULL;
+    }
+    for (i = 0; i < context->nb_streams; i++) {
+        AVStream *stream = context->streams[i];
+        struct probe_stream_s *cached = &entry->streams[i];
+        cached->codecpar = avcodec_parameters_alloc();
+        if (!cached->codecpar || avcodec_parameters_copy(cached->codecpar, stream->codecpar) < 0) {
+            avcodec_parameters_free(&cached->codecpar);
+            entry->nb_streams = i;
+            entry_close(entry);
+            return NULL;
+        }
+        cached->r_frame_rate = stream->r_frame_rate;
+        cached->avg_frame_rate = stream->avg_frame_rate;
+        cached->sample_aspect_ratio = stream->sample_aspect_ratio;
+        cached->start_time = stream->start_time;
+        cached->duration = stream->duration;
+        cached->nb_frames = stream->nb_frames;
+    }
+    entry->nb_streams = context->nb_streams;
+    entry->start_time = context->start_time;
+    entry->duration = context->duration;
+    entry->bit_rate = context->bit_rate;
+    return entry;
+}
+
+/** Get the stream information of an opened file.
+ *
+ * When the same file was probed before, unchanged in size and modification
+ * time, this copies the information found then instead of reading and
+ * decoding the start of the file again.
+ *
+ * \return 1 if the information came from the cache, 0 if it was probed, or
+ * the negative error of avformat_find_stream_info()
+ */
+
+int probe_cache_find_stream_info(AVFormatContext *context, const char *resource)
+{
+    char *key = cache_key(resource);
+    struct probe_entry_s *entry = NULL;
+    int result;
+
+    if (key) {
+        pthread_mutex_lock(&cache_mutex);
+        entry = cache ? mlt_properties_get_data(cache, key, NULL) : NULL;
+        if (entry && entry_matches(entry, context)) {
+            entry_apply(entry, context);
+            pthread_mutex_unlock(&cache_mutex);
+            free(key);
+            return 1;
+        }
+        pthread_mutex_unlock(&cache_mutex);
+    }
+
+    result = avformat_find_stream_info(context, NULL);
+
+    if (key && result >= 0 && (entry = entry_new(context))) {
+        pthread_mutex_lock(&cache_mutex);
+        if (!cache) {
+            cache = mlt_properties_new();
+            mlt_factory_register_for_clean_up(cache, (mlt_destructor) cache_close);
+        }
+        if (mlt_properties_count(cache) < PROBE_CACHE_MAX
+            || mlt_properties_get_data(cache, key, NULL))
+            mlt_properties_set_data(cache, key, entry, 0, (mlt_destructor) entry_close, NULL);
+        else
+            entry_close(entry);
+        pthread_mutex_unlock(&cache_mutex);
+    }
+    free(key);
+    return result < 0 ? result : 0;
+}
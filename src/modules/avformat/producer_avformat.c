@@ -27,6 +27,9 @@
 #endif
 
 #include "common.h"
+#include "keyframe_index.h"
+#include "metadata_cache.h"
+#include "probe_cache.h"
 
 // MLT Header files
 #include <framework/mlt_cache.h>
@@ -48,6 +51,7 @@
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/samplefmt.h>
+#include <libavutil/time.h>
 #include <libavutil/version.h>
 #include <libswscale/swscale.h>
 
@@ -74,6 +78,33 @@
 #define IMAGE_ALIGN (1)
 #define VFR_THRESHOLD \
     (3) // The minimum number of video frames with differing durations to be considered VFR.
+#define REVERSE_CACHE_BYTES (256 * 1024 * 1024) // default budget of frames for reverse playback
+
+/** The parameters that fully determine a swscale context. */
+struct sws_cache_key_s
+{
+    int src_w, src_h, src_format;
+    int dst_w, dst_h, dst_format;
+    int flags, src_v_chr_pos, dst_v_chr_pos;
+    int src_colorspace, dst_colorspace, src_full_range, dst_full_range;
+};
+
+/** A swscale context kept across frames until its parameters change. */
+struct sws_cache_s
+{
+    struct sws_cache_key_s key;
+    struct SwsContext *context;
+    int transfer_error; // result of mlt_set_luma_transfer() on this context
+    int builds;         // the number of contexts built for this entry
+};
+
+/** A decoded video frame kept for reverse playback. */
+struct reverse_frame_s
+{
+    int64_t position; // the position in source frames
+    AVFrame *frame;
+    int64_t size; // the bytes of image data
+};
 
 struct producer_avformat_s
 {
@@ -126,6 +157,32 @@ struct producer_avformat_s
     int packets_thread_ret; // latest non-zero non-EGAIN return on av_read_frame() in packets_thread
     int packets_thread_stop; // non-zero when packets_thread is to stop
     int is_thread_init;
+    int read_ahead;           // the most video packets packets_thread queues
+    int64_t read_ahead_bytes; // the most bytes of video packets packets_thread queues, 0 for no limit
+    int64_t vpackets_bytes;   // the size of the packets in vpackets
+    int64_t read_stall;       // microseconds producer_get_image waited for packets
+    mlt_deque vframes;        // frames decoded ahead by decode_thread
+    int decode_ahead;         // the most frames decode_thread keeps in vframes
+    pthread_t decode_thread;
+    int decode_thread_ret;  // the error or end of stream that stopped decode_thread
+    int decode_thread_stop; // non-zero when decode_thread is to stop
+    int is_decode_thread_init;
+    int64_t decode_stall; // microseconds producer_get_image waited for decoded frames
+    keyframe_index key_index; // the key frames of the video stream, NULL if not indexing
+    char *key_index_path;     // the file that caches key_index, NULL for none
+    int64_t key_index_start;  // the first timestamp read since the last seek
+    struct reverse_frame_s *reverse_frames; // decoded frames ordered by position
+    int reverse_count;
+    int reverse_size;
+    int64_t reverse_bytes;
+    int64_t reverse_max_bytes;
+    pthread_t reverse_thread;
+    int reverse_thread_stop; // non-zero when reverse_thread is to stop
+    int reverse_thread_done; // non-zero when reverse_thread finished its work
+    int is_reverse_thread_init;
+    int64_t reverse_end; // reverse_thread decodes the frames before this position
+    double reverse_delay;
+    double reverse_fps;
     AVRational video_time_base;
     mlt_frame last_good_frame; // for video error concealment
     int last_good_position;    // for video error concealment
@@ -139,6 +196,11 @@ struct producer_avformat_s
     int is_audio_synchronizing;
     int video_send_result;
     int reset_image_cache;
+    struct sws_cache_s sws_yuvp;    // whole frame conversion to planar YUV
+    struct sws_cache_s sws_rgb;     // whole frame conversion to RGB(A)
+    struct sws_cache_s *sws_slices; // one per slice job of the sliced YUV 4:2:2 conversion
+    int sws_slices_count;
+    int sws_builds; // the total of the entries' builds last set as _sws_builds
     struct
     {
         int pix_fmt;
@@ -165,6 +227,11 @@ static void get_audio_streams_info(producer_avformat self);
 static mlt_audio_format pick_audio_format(int sample_fmt);
 static int pick_av_pixel_format(int *pix_fmt, int full_range);
 static void property_changed(mlt_service owner, producer_avformat self, char *name);
+static void decode_ahead_stop(producer_avformat self);
+static void apply_read_ahead(producer_avformat self, mlt_properties properties);
+static void close_keyframe_index(producer_avformat self);
+static void init_mutexes(producer_avformat self);
+static int is_album_art(producer_avformat self);
 
 static int absolute_stream_index(AVFormatContext *context, enum AVMediaType media_type, int relative)
 {
@@ -235,10 +302,23 @@ mlt_producer producer_avformat_init(mlt_profile profile, const char *service, ch
             mlt_properties_set_position(properties, "length", 0);
             mlt_properties_set_position(properties, "out", 0);
 
+            char *cache_path = NULL;
             if (strcmp(service, "avformat-novalidate")) {
-                // Open the file
-                if (producer_open(self, profile, mlt_properties_get(properties, "resource"), 1, 1)
-                    != 0) {
+                cache_path = metadata_cache_path(getenv("MLT_AVFORMAT_METADATA_DIR"), file);
+                if (cache_path && !metadata_cache_load(properties, cache_path, file, profile)) {
+                    // The file is opened on the first get_frame as if evicted from the cache
+                    init_mutexes(self);
+                    self->seekable = mlt_properties_get_int(properties, "seekable");
+                    self->audio_index = mlt_properties_get_int(properties, "audio_index");
+                    self->video_index = mlt_properties_get_int(properties, "video_index");
+                    free(cache_path);
+                    cache_path = NULL;
+                } else if (producer_open(self,
+                                         profile,
+                                         mlt_properties_get(properties, "resource"),
+                                         1,
+                                         1)
+                           != 0) {
                     // Clean up
                     producer_avformat_close(self);
                     mlt_producer_close(producer);
@@ -255,6 +335,9 @@ mlt_producer producer_avformat_init(mlt_profile profile, const char *service, ch
                 // Default the user-selectable indices from the auto-detected indices
                 mlt_properties_set_int(properties, "audio_index", self->audio_index);
                 mlt_properties_set_int(properties, "video_index", self->video_index);
+                // Only files that are reopened as needed can be created from the cache
+                if (cache_path && self->seekable)
+                    metadata_cache_save(properties, cache_path, file, profile);
                 mlt_service_cache_put(MLT_PRODUCER_SERVICE(producer),
                                       "producer_avformat",
                                       self,
@@ -266,6 +349,7 @@ mlt_producer producer_avformat_init(mlt_profile profile, const char *service, ch
                                   "property-changed",
                                   (mlt_listener) property_changed);
             }
+            free(cache_path);
         }
     }
     return producer;
@@ -908,7 +992,7 @@ static int get_basic_info(producer_avformat self, mlt_profile profile, const cha
         self->dummy_context = format;
         self->video_format = NULL;
         avformat_open_input(&self->video_format, filename, NULL, NULL);
-        avformat_find_stream_info(self->video_format, NULL);
+        probe_cache_find_stream_info(self->video_format, filename);
         format = self->video_format;
     }
     self->video_seekable = self->seekable;
@@ -1118,16 +1202,8 @@ static void set_up_discard(producer_avformat self, int audio_index, int video_in
     }
 }
 
-/** Open the file.
-*/
-
-static int producer_open(
-    producer_avformat self, mlt_profile profile, const char *URL, int take_lock, int test_open)
+static void init_mutexes(producer_avformat self)
 {
-    // Return an error code (0 == no error)
-    int error = 0;
-    mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
-
     if (!self->is_mutex_init) {
         pthread_mutexattr_t attr;
         pthread_mutexattr_init(&attr);
@@ -1139,6 +1215,19 @@ static int producer_open(
         pthread_mutex_init(&self->close_mutex, &attr);
         self->is_mutex_init = 1;
     }
+}
+
+/** Open the file.
+*/
+
+static int producer_open(
+    producer_avformat self, mlt_profile profile, const char *URL, int take_lock, int test_open)
+{
+    // Return an error code (0 == no error)
+    int error = 0;
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
+
+    init_mutexes(self);
 
     // Lock the service
     if (take_lock) {
@@ -1169,7 +1258,9 @@ static int producer_open(
     // If successful, then try to get additional info
     if (!error && self->video_format) {
         // Get the stream info
-        error = avformat_find_stream_info(self->video_format, NULL) < 0;
+        int probed = probe_cache_find_stream_info(self->video_format, filename);
+        error = probed < 0;
+        mlt_properties_set_int(properties, "_probe_cached", probed == 1);
 
         // Continue if no error
         if (!error && self->video_format) {
@@ -1243,7 +1334,7 @@ static int producer_open(
                             apply_properties(self->audio_format->priv_data,
                                              properties,
                                              AV_OPT_FLAG_DECODING_PARAM);
-                        avformat_find_stream_info(self->audio_format, NULL);
+                        probe_cache_find_stream_info(self->audio_format, filename);
                     } else {
                         self->audio_format = self->video_format;
                     }
@@ -1273,6 +1364,8 @@ static int producer_open(
     if (!error) {
         self->apackets = mlt_deque_init();
         self->vpackets = mlt_deque_init();
+        self->vpackets_bytes = 0;
+        self->vframes = mlt_deque_init();
     }
 
     if (self->dummy_context) {
@@ -1310,6 +1403,9 @@ static void prepare_reopen(producer_avformat self)
     av_frame_unref(self->video_frame);
     av_buffer_unref(&self->hwaccel.device_ctx);
     self->hwaccel.device_ctx = NULL;
+    pthread_mutex_lock(&self->packets_mutex);
+    close_keyframe_index(self);
+    pthread_mutex_unlock(&self->packets_mutex);
     if (self->seekable && self->audio_format)
         avformat_close_input(&self->audio_format);
     if (self->video_format)
@@ -1339,6 +1435,11 @@ static void prepare_reopen(producer_avformat self)
         mlt_deque_close(self->vpackets);
         self->vpackets = NULL;
     }
+    self->vpackets_bytes = 0;
+    if (self->vframes) {
+        mlt_deque_close(self->vframes);
+        self->vframes = NULL;
+    }
     pthread_mutex_unlock(&self->audio_mutex);
     mlt_service_unlock(MLT_PRODUCER_SERVICE(self->parent));
 }
@@ -1444,6 +1545,156 @@ static void find_first_pts(producer_avformat self, int video_index)
     av_seek_frame(context, -1, 0, AVSEEK_FLAG_BACKWARD);
 }
 
+/** Record a video packet in the key frame index.
+ *
+ * The caller must hold packets_mutex.
+ */
+
+static void index_packet(producer_avformat self, AVPacket *pkt)
+{
+    int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+    if (pts == AV_NOPTS_VALUE)
+        return;
+    if (pkt->flags & AV_PKT_FLAG_KEY)
+        keyframe_index_add(self->key_index, pts);
+    // Packets are read in decoding order, but no key frame is decoded before
+    // a frame that is presented after it.
+    if (self->key_index_start == AV_NOPTS_VALUE)
+        self->key_index_start = pts;
+    else
+        keyframe_index_cover(self->key_index, self->key_index_start, pts);
+}
+
+/** Mark the key frame index complete if the stream was read from its start.
+ *
+ * The caller must hold packets_mutex and call this at the end of the stream.
+ */
+
+static void finish_keyframe_index(producer_avformat self)
+{
+    keyframe_index index = self->key_index;
+
+    if (index && !index->complete && index->range_count == 1 && index->first_pts != AV_NOPTS_VALUE
+        && index->ranges[0][0] <= index->first_pts) {
+        index->complete = 1;
+        index->dirty = 1;
+    }
+}
+
+/** Load the key frame index of the video stream, or build it when requested.
+ *
+ * The index provides the first timestamp and frame rate variability, so the
+ * stream need not be probed again.
+ * The caller must hold packets_mutex.
+ */
+
+static void open_keyframe_index(producer_avformat self)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
+    int mode = mlt_properties_exists(properties, "keyframe_index")
+                   ? mlt_properties_get_int(properties, "keyframe_index")
+                   : 1;
+    const char *directory = mlt_properties_get(properties, "keyframe_index_dir");
+    AVFormatContext *context = self->video_format;
+
+    if (mode <= 0 || self->key_index || !context || self->video_index < 0 || !self->video_seekable
+        || is_album_art(self))
+        return;
+
+    AVStream *stream = context->streams[self->video_index];
+    self->key_index = keyframe_index_init();
+    self->key_index_start = AV_NOPTS_VALUE;
+    if (!self->key_index)
+        return;
+    if (!directory)
+        directory = getenv("MLT_KEYFRAME_INDEX_DIR");
+    if (!directory)
+        directory = getenv("MLT_AVFORMAT_METADATA_DIR");
+    self->key_index_path = keyframe_index_path(directory, context->url, self->video_index);
+    if (self->key_index_path
+        && !keyframe_index_load(self->key_index,
+                                self->key_index_path,
+                                context->url,
+                                self->video_index,
+                                stream->time_base.num,
+                                stream->time_base.den)) {
+        mlt_log_verbose(MLT_PRODUCER_SERVICE(self->parent),
+                        "loaded key frame index %s\n",
+                        self->key_index_path);
+        if (self->first_pts == AV_NOPTS_VALUE)
+            self->first_pts = self->key_index->first_pts;
+        if (self->key_index->vfr)
+            mlt_properties_set_int(properties, "meta.media.variable_frame_rate", 1);
+    }
+
+    if (mode > 1 && !self->key_index->complete) {
+        // Read the whole stream without decoding
+        AVPacket *pkt = av_packet_alloc();
+        if (self->first_pts == AV_NOPTS_VALUE)
+            find_first_pts(self, self->video_index);
+        self->key_index->first_pts = self->first_pts;
+        self->key_index->vfr = mlt_properties_get_int(properties, "meta.media.variable_frame_rate");
+        av_seek_frame(context, -1, 0, AVSEEK_FLAG_BACKWARD);
+        while (pkt && av_read_frame(context, pkt) >= 0) {
+            if (pkt->stream_index == self->video_index)
+                index_packet(self, pkt);
+            av_packet_unref(pkt);
+        }
+        av_packet_free(&pkt);
+        finish_keyframe_index(self);
+        self->key_index_start = AV_NOPTS_VALUE;
+        av_seek_frame(context, -1, 0, AVSEEK_FLAG_BACKWARD);
+        if (self->key_index_path)
+            keyframe_index_save(self->key_index,
+                                self->key_index_path,
+                                context->url,
+                                self->video_index,
+                                stream->time_base.num,
+                                stream->time_base.den);
+    }
+}
+
+/** Save the key frame index if it changed.
+ */
+
+static void close_keyframe_index(producer_avformat self)
+{
+    if (self->key_index && self->key_index->dirty && self->key_index_path && self->video_format
+        && self->video_index >= 0) {
+        AVStream *stream = self->video_format->streams[self->video_index];
+        keyframe_index_save(self->key_index,
+                            self->key_index_path,
+                            self->video_format->url,
+                            self->video_index,
+                            stream->time_base.num,
+                            stream->time_base.den);
+    }
+    keyframe_index_close(self->key_index);
+    self->key_index = NULL;
+    free(self->key_index_path);
+    self->key_index_path = NULL;
+}
+
+/** Convert a position in source frames to a timestamp of the video stream.
+ */
+
+static int64_t position_to_timestamp(producer_avformat self,
+                                     int64_t req_position,
+                                     double source_fps)
+{
+    AVFormatContext *context = self->video_format;
+    int64_t timestamp = req_position / (av_q2d(self->video_time_base) * source_fps);
+
+    if (req_position <= 0)
+        timestamp = 0;
+    else if (self->first_pts != AV_NOPTS_VALUE)
+        timestamp += self->first_pts;
+    else if (context->start_time != AV_NOPTS_VALUE)
+        timestamp += context->start_time;
+    return timestamp;
+}
+
 static int seek_video(producer_avformat self,
                       mlt_position position,
                       int64_t req_position,
@@ -1456,6 +1707,11 @@ static int seek_video(producer_avformat self,
     if (seek_threshold <= 0)
         seek_threshold = 64;
 
+    // Frames decoded ahead only serve linear playback
+    if (position < self->video_expected || position - self->video_expected >= seek_threshold
+        || self->last_position < 0)
+        decode_ahead_stop(self);
+
     pthread_mutex_lock(&self->packets_mutex);
 
     if (self->video_seekable && (position != self->video_expected || self->last_position < 0)) {
@@ -1466,24 +1722,44 @@ static int seek_video(producer_avformat self,
         double source_fps = mlt_properties_get_double(properties, "meta.media.frame_rate_num")
                             / mlt_properties_get_double(properties, "meta.media.frame_rate_den");
 
-        if (self->first_pts == AV_NOPTS_VALUE && self->last_position == POSITION_INITIAL)
-            find_first_pts(self, self->video_index);
+        if (self->last_position == POSITION_INITIAL) {
+            open_keyframe_index(self);
+            if (self->first_pts == AV_NOPTS_VALUE) {
+                find_first_pts(self, self->video_index);
+                if (self->key_index) {
+                    self->key_index->first_pts = self->first_pts;
+                    self->key_index->vfr = mlt_properties_get_int(properties,
+                                                                  "meta.media.variable_frame_rate");
+                    self->key_index->dirty = 1;
+                }
+            }
+        }
+
+        // Calculate the timestamp for the requested frame
+        int64_t timestamp = position_to_timestamp(self, req_position, source_fps);
+        int seek = position < self->video_expected
+                   || position - self->video_expected >= seek_threshold
+                   || self->last_position < 0;
+        int64_t key = AV_NOPTS_VALUE;
+
+        if (!seek || position > self->video_expected) {
+            // Seek forward only to skip key frames, which the index can tell
+            int64_t current = position_to_timestamp(self, self->last_position, source_fps);
+            if (self->key_index && self->last_position >= 0 && current < timestamp) {
+                int between = keyframe_index_between(self->key_index, current, timestamp);
+                if (between >= 0)
+                    seek = between;
+            }
+        }
 
         if (self->video_frame && position + 1 == self->video_expected) {
             // We're paused - use last image
             paused = 1;
-        } else if (position < self->video_expected
-                   || position - self->video_expected >= seek_threshold
-                   || self->last_position < 0) {
-            // Calculate the timestamp for the requested frame
-            int64_t timestamp = req_position / (av_q2d(self->video_time_base) * source_fps);
-            if (req_position <= 0)
-                timestamp = 0;
-            else if (self->first_pts != AV_NOPTS_VALUE)
-                timestamp += self->first_pts;
-            else if (context->start_time != AV_NOPTS_VALUE)
-                timestamp += context->start_time;
-            if (preseek && av_q2d(self->video_time_base) != 0)
+        } else if (seek) {
+            if (self->key_index && keyframe_index_before(self->key_index, timestamp, &key))
+                // Seek to the exact key frame, which needs no allowance for reordering
+                timestamp = key;
+            else if (preseek && av_q2d(self->video_time_base) != 0)
                 timestamp -= 2 / av_q2d(self->video_time_base);
             if (timestamp < 0)
                 timestamp = 0;
@@ -1497,6 +1773,10 @@ static int seek_video(producer_avformat self,
 
             // Seek to the timestamp
             self->video_codec->skip_loop_filter = AVDISCARD_NONREF;
+            // Frames before the requested one that nothing refers to need no
+            // decoding when the timestamps are known to be reliable
+            self->video_codec->skip_frame = key != AV_NOPTS_VALUE ? AVDISCARD_NONREF
+                                                                  : AVDISCARD_DEFAULT;
             av_seek_frame(context, self->video_index, timestamp, AVSEEK_FLAG_BACKWARD);
 
             // flush any pictures still in decode buffer
@@ -1513,8 +1793,10 @@ static int seek_video(producer_avformat self,
                 AVPacket *tmp = (AVPacket *) mlt_deque_pop_front(self->vpackets);
                 av_packet_free(&tmp);
             }
+            self->vpackets_bytes = 0;
+            self->key_index_start = AV_NOPTS_VALUE;
 
-            pthread_cond_signal(&self->packets_cond);
+            pthread_cond_broadcast(&self->packets_cond);
 
             // Remove the cached info relating to the previous position
             self->current_position = POSITION_INVALID;
@@ -1690,13 +1972,92 @@ static void property_changed(mlt_service owner, producer_avformat self, char *na
             if (mlt_properties_get_int(properties, "_probe_complete")) {
                 mlt_properties_set_int(properties, "_probe_complete", 0);
             }
+        } else if (!strcmp("read_ahead", name) || !strcmp("read_ahead_bytes", name)
+                   || !strcmp("decode_ahead", name)) {
+            if (self->is_thread_init)
+                apply_read_ahead(self, properties);
         }
     }
 }
 
+static void sws_cache_close(struct sws_cache_s *cache)
+{
+    sws_freeContext(cache->context);
+    cache->context = NULL;
+}
+
+/** Get a swscale context for the given parameters, reusing the cached one when they match.
+ *
+ * Building a context allocates and initializes filter tables and colorspace
+ * lookup tables, which costs as much as converting a small slice. The video
+ * parameters rarely change within a clip, so this keeps the context between
+ * frames. Each cache entry must only be used by one thread at a time.
+ */
+
+static struct SwsContext *sws_cache_get(struct sws_cache_s *cache,
+                                        const struct sws_cache_key_s *key)
+{
+    int ret;
+
+    if (cache->context && !memcmp(&cache->key, key, sizeof(*key)))
+        return cache->context;
+
+    sws_cache_close(cache);
+    cache->key = *key;
+    cache->builds++;
+    cache->context = sws_alloc_context();
+    if (!cache->context)
+        return NULL;
+
+    av_opt_set_int(cache->context, "srcw", key->src_w, 0);
+    av_opt_set_int(cache->context, "srch", key->src_h, 0);
+    av_opt_set_int(cache->context, "src_format", key->src_format, 0);
+    av_opt_set_int(cache->context, "dstw", key->dst_w, 0);
+    av_opt_set_int(cache->context, "dsth", key->dst_h, 0);
+    av_opt_set_int(cache->context, "dst_format", key->dst_format, 0);
+    av_opt_set_int(cache->context, "sws_flags", key->flags, 0);
+
+    av_opt_set_int(cache->context, "src_h_chr_pos", -513, 0);
+    av_opt_set_int(cache->context, "src_v_chr_pos", key->src_v_chr_pos, 0);
+    av_opt_set_int(cache->context, "dst_h_chr_pos", -513, 0);
+    av_opt_set_int(cache->context, "dst_v_chr_pos", key->dst_v_chr_pos, 0);
+
+    if ((ret = sws_init_context(cache->context, NULL, NULL)) < 0) {
+        mlt_log_error(NULL, "%s:%d: sws_init_context failed, ret=%d\n", __FUNCTION__, __LINE__, ret);
+        sws_cache_close(cache);
+        return NULL;
+    }
+
+    cache->transfer_error = mlt_set_luma_transfer(cache->context,
+                                                  key->src_colorspace,
+                                                  key->dst_colorspace,
+                                                  key->src_full_range,
+                                                  key->dst_full_range);
+    return cache->context;
+}
+
+/** Set the number of swscale contexts built so far as the _sws_builds property.
+ *
+ * The property only changes on a cache miss, so it is only set then. The
+ * caller must hold video_mutex.
+ */
+
+static void update_sws_builds(producer_avformat self)
+{
+    int i, builds = self->sws_yuvp.builds + self->sws_rgb.builds;
+
+    for (i = 0; i < self->sws_slices_count; i++)
+        builds += self->sws_slices[i].builds;
+    if (builds != self->sws_builds) {
+        self->sws_builds = builds;
+        mlt_properties_set_int(MLT_PRODUCER_PROPERTIES(self->parent), "_sws_builds", builds);
+    }
+}
+
 struct sliced_pix_fmt_conv_t
 {
     int width, height, slice_w;
+    struct sws_cache_s *sws_slices;
     AVFrame *frame;
     uint8_t *out_data[4];
     int out_stride[4];
@@ -1710,11 +2071,12 @@ static int sliced_h_pix_fmt_conv_proc(int id, int idx, int jobs, void *cookie)
     uint8_t *out[4];
     const uint8_t *in[4];
     int in_stride[4], out_stride[4];
-    int src_v_chr_pos = -513, dst_v_chr_pos = -513, ret, i, slice_x, slice_w, h, mul, field, slices,
+    int src_v_chr_pos = -513, dst_v_chr_pos = -513, i, slice_x, slice_w, h, mul, field, slices,
         interlaced = 0;
 
     struct SwsContext *sws;
     struct sliced_pix_fmt_conv_t *ctx = (struct sliced_pix_fmt_conv_t *) cookie;
+    struct sws_cache_s *cache = &ctx->sws_slices[idx];
 
     interlaced = ctx->frame->interlaced_frame;
     field = (interlaced) ? (idx & 1) : 0;
@@ -1756,32 +2118,24 @@ static int sliced_h_pix_fmt_conv_proc(int id, int idx, int jobs, void *cookie)
     if (slice_w <= 0)
         return 0;
 
-    sws = sws_alloc_context();
-
-    av_opt_set_int(sws, "srcw", slice_w, 0);
-    av_opt_set_int(sws, "srch", h, 0);
-    av_opt_set_int(sws, "src_format", ctx->src_format, 0);
-    av_opt_set_int(sws, "dstw", slice_w, 0);
-    av_opt_set_int(sws, "dsth", h, 0);
-    av_opt_set_int(sws, "dst_format", ctx->dst_format, 0);
-    av_opt_set_int(sws, "sws_flags", ctx->flags, 0);
-
-    av_opt_set_int(sws, "src_h_chr_pos", -513, 0);
-    av_opt_set_int(sws, "src_v_chr_pos", src_v_chr_pos, 0);
-    av_opt_set_int(sws, "dst_h_chr_pos", -513, 0);
-    av_opt_set_int(sws, "dst_v_chr_pos", dst_v_chr_pos, 0);
-
-    if ((ret = sws_init_context(sws, NULL, NULL)) < 0) {
-        mlt_log_error(NULL, "%s:%d: sws_init_context failed, ret=%d\n", __FUNCTION__, __LINE__, ret);
-        sws_freeContext(sws);
+    struct sws_cache_key_s key = {
+        .src_w = slice_w,
+        .src_h = h,
+        .src_format = ctx->src_format,
+        .dst_w = slice_w,
+        .dst_h = h,
+        .dst_format = ctx->dst_format,
+        .flags = ctx->flags,
+        .src_v_chr_pos = src_v_chr_pos,
+        .dst_v_chr_pos = dst_v_chr_pos,
+        .src_colorspace = ctx->src_colorspace,
+        .dst_colorspace = ctx->dst_colorspace,
+        .src_full_range = ctx->src_full_range,
+        .dst_full_range = ctx->dst_full_range,
+    };
+    sws = sws_cache_get(cache, &key);
+    if (!sws)
         return 0;
-    }
-
-    mlt_set_luma_transfer(sws,
-                          ctx->src_colorspace,
-                          ctx->dst_colorspace,
-                          ctx->src_full_range,
-                          ctx->dst_full_range);
 
 #define PIX_DESC_BPP(DESC) (DESC.step)
 
@@ -1808,8 +2162,6 @@ static int sliced_h_pix_fmt_conv_proc(int id, int idx, int jobs, void *cookie)
 
     sws_scale(sws, in, in_stride, 0, h, out, out_stride);
 
-    sws_freeContext(sws);
-
     return 0;
 }
 
@@ -1825,18 +2177,29 @@ static int convert_image_yuvp(producer_avformat self,
                               int dst_full_range)
 {
     int result = self->yuv_colorspace;
-    int flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, dst_pix_fmt);
-    struct SwsContext *context = sws_getContext(
-        width, height, src_pix_fmt, width, height, dst_pix_fmt, flags, NULL, NULL, NULL);
+    struct sws_cache_key_s key = {
+        .src_w = width,
+        .src_h = height,
+        .src_format = src_pix_fmt,
+        .dst_w = width,
+        .dst_h = height,
+        .dst_format = dst_pix_fmt,
+        .flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, dst_pix_fmt),
+        .src_v_chr_pos = -513,
+        .dst_v_chr_pos = -513,
+        .src_colorspace = self->yuv_colorspace,
+        .dst_colorspace = profile->colorspace,
+        .src_full_range = self->full_range,
+        .dst_full_range = dst_full_range,
+    };
+    struct SwsContext *context = sws_cache_get(&self->sws_yuvp, &key);
     uint8_t *out_data[4];
     int out_stride[4];
 
+    if (!context)
+        return result;
     mlt_image_format_planes(format, width, height, buffer, out_data, out_stride);
-    if (!mlt_set_luma_transfer(context,
-                               self->yuv_colorspace,
-                               profile->colorspace,
-                               self->full_range,
-                               dst_full_range))
+    if (!self->sws_yuvp.transfer_error)
         result = profile->colorspace;
     sws_scale(context,
               (const uint8_t *const *) frame->data,
@@ -1845,7 +2208,6 @@ static int convert_image_yuvp(producer_avformat self,
               height,
               out_data,
               out_stride);
-    sws_freeContext(context);
 
     return result;
 }
@@ -1861,7 +2223,22 @@ static void convert_image_rgb(producer_avformat self,
                               int dst_pix_fmt,
                               int dst_full_range)
 {
-    int flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, dst_pix_fmt);
+    // libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
+    struct sws_cache_key_s key = {
+        .src_w = width,
+        .src_h = height,
+        .src_format = src_pix_fmt,
+        .dst_w = width,
+        .dst_h = height,
+        .dst_format = dst_pix_fmt,
+        .flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, dst_pix_fmt),
+        .src_v_chr_pos = -513,
+        .dst_v_chr_pos = -513,
+        .src_colorspace = self->yuv_colorspace,
+        .dst_colorspace = 601,
+        .src_full_range = self->full_range,
+        .dst_full_range = 1,
+    };
     uint8_t *out_data[4];
     int out_stride[4];
 
@@ -1870,18 +2247,10 @@ static void convert_image_rgb(producer_avformat self,
         int field_height = height / 2;
         const uint8_t *in_data[4];
         int in_stride[4];
-        struct SwsContext *context = sws_getContext(width,
-                                                    field_height,
-                                                    src_pix_fmt,
-                                                    width,
-                                                    field_height,
-                                                    dst_pix_fmt,
-                                                    flags,
-                                                    NULL,
-                                                    NULL,
-                                                    NULL);
-        // libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
-        mlt_set_luma_transfer(context, self->yuv_colorspace, 601, self->full_range, 1);
+        key.src_h = key.dst_h = field_height;
+        struct SwsContext *context = sws_cache_get(&self->sws_rgb, &key);
+        if (!context)
+            return;
         av_image_fill_arrays(out_data, out_stride, buffer, dst_pix_fmt, width, height, IMAGE_ALIGN);
         // Copy the input frame arrays
         for (int i = 0; i < 4; i++) {
@@ -1902,13 +2271,11 @@ static void convert_image_rgb(producer_avformat self,
         }
         // Convert the second field
         sws_scale(context, in_data, in_stride, 0, field_height, out_data, out_stride);
-        sws_freeContext(context);
     } else {
-        struct SwsContext *context = sws_getContext(
-            width, height, src_pix_fmt, width, height, dst_pix_fmt, flags, NULL, NULL, NULL);
+        struct SwsContext *context = sws_cache_get(&self->sws_rgb, &key);
+        if (!context)
+            return;
         av_image_fill_arrays(out_data, out_stride, buffer, dst_pix_fmt, width, height, IMAGE_ALIGN);
-        // libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
-        mlt_set_luma_transfer(context, self->yuv_colorspace, 601, self->full_range, 1);
         sws_scale(context,
                   (const uint8_t *const *) frame->data,
                   frame->linesize,
@@ -1916,7 +2283,6 @@ static void convert_image_rgb(producer_avformat self,
                   height,
                   out_data,
                   out_stride);
-        sws_freeContext(context);
     }
 }
 
@@ -2053,16 +2419,37 @@ static int convert_image(producer_avformat self,
         if (sliced && (last_slice_w % 8) == 0
             && !(ctx.src_format == AV_PIX_FMT_YUV422P && last_slice_w % 16)) {
             c *= frame->interlaced_frame ? 2 : 1;
-            mlt_slices_run_normal(c, sliced_h_pix_fmt_conv_proc, &ctx);
         } else {
+            sliced = 0;
             c = frame->interlaced_frame ? 2 : 1;
             ctx.slice_w = width;
+        }
+
+        // Every slice job keeps its own context; the jobs of one run never share one.
+        if (c > self->sws_slices_count) {
+            struct sws_cache_s *slices = realloc(self->sws_slices, c * sizeof(*slices));
+            if (!slices) {
+                mlt_log_timings_end(NULL, __FUNCTION__);
+                return result;
+            }
+            memset(slices + self->sws_slices_count,
+                   0,
+                   (c - self->sws_slices_count) * sizeof(*slices));
+            self->sws_slices = slices;
+            self->sws_slices_count = c;
+        }
+        ctx.sws_slices = self->sws_slices;
+
+        if (sliced) {
+            mlt_slices_run_normal(c, sliced_h_pix_fmt_conv_proc, &ctx);
+        } else {
             for (i = 0; i < c; i++)
                 sliced_h_pix_fmt_conv_proc(i, i, c, &ctx);
         }
 
         result = profile->colorspace;
     }
+    update_sws_builds(self);
     mlt_log_timings_end(NULL, __FUNCTION__);
 
     return result;
@@ -2144,7 +2531,9 @@ static void *packets_worker(void *param)
             return NULL;
         }
 
-        if (mlt_deque_count(self->vpackets) >= 1 || self->packets_thread_ret < 0) {
+        if (mlt_deque_count(self->vpackets) >= MAX(1, self->read_ahead)
+            || (self->read_ahead_bytes > 0 && self->vpackets_bytes >= self->read_ahead_bytes)
+            || self->packets_thread_ret < 0) {
             pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
             goto check_stop;
         }
@@ -2158,20 +2547,168 @@ static void *packets_worker(void *param)
             if (ret == 0) {
                 if (pkt->stream_index == self->video_index) {
                     mlt_deque_push_back(self->vpackets, av_packet_clone(pkt));
+                    self->vpackets_bytes += pkt->size;
+                    if (self->key_index)
+                        index_packet(self, pkt);
                 } else if (!self->video_seekable && pkt->stream_index == self->audio_index
                            && !is_album_art(self)) {
                     mlt_deque_push_back(self->apackets, av_packet_clone(pkt));
                 }
                 av_packet_unref(pkt);
-            } else if (ret != AVERROR_EOF) {
+            } else if (ret == AVERROR_EOF) {
+                finish_keyframe_index(self);
+            } else {
                 mlt_log_verbose(MLT_PRODUCER_SERVICE(self->parent),
                                 "av_read_frame returned error %d inside packets_worker\n",
                                 ret);
             }
 
-            pthread_cond_signal(&self->packets_cond);
+            pthread_cond_broadcast(&self->packets_cond);
+        }
+    }
+}
+
+/** Make a decoded frame that may be in hardware memory usable by convert_image.
+ *
+ * \return 0 on success
+ */
+
+static int transfer_hw_frame(producer_avformat self, AVFrame *frame)
+{
+    if (self->hwaccel.device_ctx && frame->format == self->hwaccel.pix_fmt) {
+        AVFrame *sw_frame = av_frame_alloc();
+        int error = av_hwframe_transfer_data(sw_frame, frame, 0);
+        if (error < 0) {
+            mlt_log_error(MLT_PRODUCER_SERVICE(self->parent),
+                          "av_hwframe_transfer_data() failed %d\n",
+                          error);
+            av_frame_free(&sw_frame);
+            return error;
+        }
+        av_frame_copy_props(sw_frame, frame);
+        sw_frame->width = frame->width;
+        sw_frame->height = frame->height;
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, sw_frame);
+        av_frame_free(&sw_frame);
+    }
+    return 0;
+}
+
+/** Decode a video packet and queue the frames it completes in vframes.
+ *
+ * \return 0 on success or the error from avcodec_send_packet
+ */
+
+static int decode_ahead_packet(producer_avformat self, AVPacket *pkt)
+{
+    int ret, received;
+
+    do {
+        ret = avcodec_send_packet(self->video_codec, pkt);
+        if (!ignore_send_packet_result(ret)) {
+            mlt_log_warning(MLT_PRODUCER_SERVICE(self->parent),
+                            "video avcodec_send_packet failed with %d\n",
+                            ret);
+            return ret;
+        }
+        received = 0;
+        for (;;) {
+            AVFrame *frame = av_frame_alloc();
+            if (avcodec_receive_frame(self->video_codec, frame) < 0) {
+                av_frame_free(&frame);
+                break;
+            }
+            if (transfer_hw_frame(self, frame)) {
+                av_frame_free(&frame);
+                continue;
+            }
+            pthread_mutex_lock(&self->packets_mutex);
+            mlt_deque_push_back(self->vframes, frame);
+            pthread_cond_broadcast(&self->packets_cond);
+            pthread_mutex_unlock(&self->packets_mutex);
+            received++;
+        }
+        // The decoder wanted its frames taken before accepting the packet.
+    } while (ret == AVERROR(EAGAIN) && received);
+
+    return 0;
+}
+
+/** Decode video ahead of linear playback.
+ *
+ * The thread keeps up to decode_ahead frames in vframes. It stops at the end
+ * of the stream or on an error and leaves those to producer_get_image.
+ */
+
+static void *decode_worker(void *param)
+{
+    producer_avformat self = param;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    while (!self->decode_thread_stop) {
+        if (self->decode_thread_ret || mlt_deque_count(self->vframes) >= self->decode_ahead) {
+            pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
+        } else if (mlt_deque_count(self->vpackets) > 0) {
+            AVPacket *pkt = mlt_deque_pop_front(self->vpackets);
+            self->vpackets_bytes -= pkt->size;
+            pthread_cond_broadcast(&self->packets_cond);
+            pthread_mutex_unlock(&self->packets_mutex);
+
+            int ret = decode_ahead_packet(self, pkt);
+            av_packet_free(&pkt);
+
+            pthread_mutex_lock(&self->packets_mutex);
+            if (ret < 0) {
+                self->decode_thread_ret = ret;
+                pthread_cond_broadcast(&self->packets_cond);
+            }
+        } else if (self->packets_thread_ret < 0) {
+            self->decode_thread_ret = self->packets_thread_ret;
+            pthread_cond_broadcast(&self->packets_cond);
+        } else {
+            pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
         }
     }
+    pthread_mutex_unlock(&self->packets_mutex);
+    return NULL;
+}
+
+/** Start decoding ahead if it is enabled and not already running.
+ *
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ */
+
+static void decode_ahead_start(producer_avformat self)
+{
+    if (!self->is_decode_thread_init && self->decode_ahead > 0 && self->vframes) {
+        self->decode_thread_stop = 0;
+        self->decode_thread_ret = 0;
+        if (!pthread_create(&self->decode_thread, NULL, decode_worker, self))
+            self->is_decode_thread_init = 1;
+    }
+}
+
+/** Stop decoding ahead and drop the frames decoded ahead.
+ *
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ */
+
+static void decode_ahead_stop(producer_avformat self)
+{
+    if (self->is_decode_thread_init) {
+        AVFrame *frame;
+
+        pthread_mutex_lock(&self->packets_mutex);
+        self->decode_thread_stop = 1;
+        pthread_cond_broadcast(&self->packets_cond);
+        pthread_mutex_unlock(&self->packets_mutex);
+        pthread_join(self->decode_thread, NULL);
+        self->is_decode_thread_init = 0;
+
+        while ((frame = mlt_deque_pop_back(self->vframes)))
+            av_frame_free(&frame);
+    }
 }
 
 static void init_cache(mlt_properties properties, mlt_cache *cache)
@@ -2189,12 +2726,424 @@ static void init_cache(mlt_properties properties, mlt_cache *cache)
         cache_supplied = 1;
         cache_size = 0;
     }
+    // byte budget supplied via property, otherwise the framework uses MLT_CACHE_BYTES
+    int64_t cache_bytes = mlt_properties_get(properties, "cache_bytes")
+                              ? mlt_properties_get_int64(properties, "cache_bytes")
+                              : -1;
     // create cache if not disabled
     if (!cache_supplied || cache_size > 0)
         *cache = mlt_cache_init();
-    // set cache size if supplied
-    if (*cache && cache_supplied)
-        mlt_cache_set_size(*cache, cache_size);
+    if (*cache) {
+        // set cache size if supplied
+        if (cache_supplied)
+            mlt_cache_set_size(*cache, cache_size);
+        if (cache_bytes >= 0)
+            mlt_cache_set_max_bytes(*cache, cache_bytes);
+        // a byte budget without a size is limited only by bytes
+        if (!cache_supplied && mlt_cache_get_max_bytes(*cache) > 0)
+            mlt_cache_set_size(*cache, INT_MAX);
+    }
+}
+
+/** Get the position of a decoded frame from its timestamp.
+ *
+ * \param position the position to return if the frame has no timestamp
+ */
+
+static int64_t decoded_frame_position(
+    producer_avformat self, AVFrame *frame, int64_t position, double delay, double source_fps)
+{
+    AVFormatContext *context = self->video_format;
+    int64_t pts = best_pts(self, frame->pts, frame->pkt_dts);
+
+    if (pts != AV_NOPTS_VALUE) {
+        // Some streams are not marking their key frames even though
+        // there are I frames, and find_first_pts() fails as a result.
+        // Try to set first_pts here after getting pict_type.
+        if (self->first_pts == AV_NOPTS_VALUE
+            && (frame->key_frame || frame->pict_type == AV_PICTURE_TYPE_I))
+            self->first_pts = pts;
+        if (self->first_pts != AV_NOPTS_VALUE)
+            pts -= self->first_pts;
+        else if (context->start_time != AV_NOPTS_VALUE)
+            pts -= context->start_time;
+        position = (int64_t) ((av_q2d(self->video_time_base) * pts + delay) * source_fps + 0.5);
+    }
+    return position;
+}
+
+/** Take the frame for a position from the frames decoded ahead.
+ *
+ * Frames before the position are dropped.
+ *
+ * \param position receives the position of the frame
+ * \return true if self->video_frame holds the frame, false if decoding ahead
+ * stopped and producer_get_image must decode the frame itself
+ */
+
+static int take_decoded_frame(producer_avformat self,
+                              int64_t req_position,
+                              double delay,
+                              double source_fps,
+                              int64_t *position)
+{
+    int got_picture = 0;
+
+    if (!self->is_decode_thread_init)
+        return 0;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    while (!got_picture) {
+        AVFrame *frame = mlt_deque_pop_front(self->vframes);
+        if (frame) {
+            pthread_cond_broadcast(&self->packets_cond);
+            *position = decoded_frame_position(self,
+                                               frame,
+                                               self->last_position + 1,
+                                               delay,
+                                               source_fps);
+            self->last_position = *position;
+            if (*position >= req_position) {
+                av_frame_unref(self->video_frame);
+                av_frame_move_ref(self->video_frame, frame);
+                got_picture = 1;
+            }
+            av_frame_free(&frame);
+        } else if (self->decode_thread_ret) {
+            break;
+        } else {
+            int64_t start = av_gettime_relative();
+            pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
+            self->decode_stall += av_gettime_relative() - start;
+        }
+    }
+    pthread_mutex_unlock(&self->packets_mutex);
+
+    if (!got_picture)
+        decode_ahead_stop(self);
+    return got_picture;
+}
+
+/** Get the number of bytes of image data that a decoded frame refers to.
+ */
+
+static int64_t frame_bytes(AVFrame *frame)
+{
+    int64_t size = 0;
+    int i;
+
+    for (i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    return size;
+}
+
+/** Keep a decoded frame for reverse playback.
+ *
+ * Reverse playback needs the highest positions first, so the lowest are
+ * dropped to stay within reverse_max_bytes.
+ */
+
+static void reverse_put(producer_avformat self, int64_t position, AVFrame *frame)
+{
+    int i;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    for (i = self->reverse_count; i > 0 && self->reverse_frames[i - 1].position >= position; i--)
+        ;
+    if (i < self->reverse_count && self->reverse_frames[i].position == position)
+        goto done;
+    if (self->reverse_count == self->reverse_size) {
+        int size = self->reverse_size ? self->reverse_size * 2 : 64;
+        struct reverse_frame_s *frames = realloc(self->reverse_frames,
+                                                 size * sizeof(*frames));
+        if (!frames)
+            goto done;
+        self->reverse_frames = frames;
+        self->reverse_size = size;
+    }
+    AVFrame *copy = av_frame_clone(frame);
+    if (!copy)
+        goto done;
+    memmove(&self->reverse_frames[i + 1],
+            &self->reverse_frames[i],
+            (self->reverse_count - i) * sizeof(*self->reverse_frames));
+    self->reverse_frames[i].position = position;
+    self->reverse_frames[i].frame = copy;
+    self->reverse_frames[i].size = frame_bytes(copy);
+    self->reverse_bytes += self->reverse_frames[i].size;
+    self->reverse_count++;
+
+    while (self->reverse_bytes > self->reverse_max_bytes && self->reverse_count > 1) {
+        self->reverse_bytes -= self->reverse_frames[0].size;
+        av_frame_free(&self->reverse_frames[0].frame);
+        self->reverse_count--;
+        memmove(&self->reverse_frames[0],
+                &self->reverse_frames[1],
+                self->reverse_count * sizeof(*self->reverse_frames));
+    }
+done:
+    pthread_mutex_unlock(&self->packets_mutex);
+}
+
+/** Decode a video packet for reverse playback.
+ *
+ * \return true when decoding reached the end position or failed
+ */
+
+static int reverse_decode_packet(producer_avformat self, AVPacket *pkt, int64_t end)
+{
+    AVFrame *frame = av_frame_alloc();
+    int ret, received, done = !frame;
+
+    while (!done) {
+        ret = avcodec_send_packet(self->video_codec, pkt);
+        if (!ignore_send_packet_result(ret)) {
+            done = 1;
+            break;
+        }
+        received = 0;
+        while (!done && avcodec_receive_frame(self->video_codec, frame) >= 0) {
+            received++;
+            if (!transfer_hw_frame(self, frame)
+                && best_pts(self, frame->pts, frame->pkt_dts) != AV_NOPTS_VALUE) {
+                int64_t position = decoded_frame_position(self,
+                                                          frame,
+                                                          end,
+                                                          self->reverse_delay,
+                                                          self->reverse_fps);
+                if (position >= end)
+                    done = 1;
+                else
+                    reverse_put(self, position, frame);
+            }
+            av_frame_unref(frame);
+        }
+        // The decoder wanted its frames taken before accepting the packet.
+        if (ret != AVERROR(EAGAIN) || !received)
+            break;
+    }
+    av_frame_free(&frame);
+    return done;
+}
+
+/** Decode the group of pictures before the frames kept for reverse playback.
+ *
+ * producer_get_image serves the kept frames meanwhile without touching the
+ * demuxer or decoder.
+ */
+
+static void *reverse_worker(void *param)
+{
+    producer_avformat self = param;
+    int64_t end = self->reverse_end;
+    int64_t timestamp = position_to_timestamp(self, end - 1, self->reverse_fps);
+    int64_t key;
+    AVPacket *pkt;
+    int done = 0;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    if (self->key_index && keyframe_index_before(self->key_index, timestamp, &key))
+        timestamp = key;
+    av_seek_frame(self->video_format, self->video_index, timestamp, AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(self->video_codec);
+    if (self->packets_thread_ret == AVERROR_EOF)
+        self->packets_thread_ret = 0;
+    while ((pkt = mlt_deque_pop_front(self->vpackets)))
+        av_packet_free(&pkt);
+    self->vpackets_bytes = 0;
+    self->key_index_start = AV_NOPTS_VALUE;
+    pthread_cond_broadcast(&self->packets_cond);
+
+    while (!self->reverse_thread_stop && !done) {
+        if (mlt_deque_count(self->vpackets) > 0) {
+            pkt = mlt_deque_pop_front(self->vpackets);
+            self->vpackets_bytes -= pkt->size;
+            pthread_cond_broadcast(&self->packets_cond);
+            pthread_mutex_unlock(&self->packets_mutex);
+
+            done = reverse_decode_packet(self, pkt, end);
+            av_packet_free(&pkt);
+
+            pthread_mutex_lock(&self->packets_mutex);
+        } else if (self->packets_thread_ret < 0) {
+            done = 1;
+        } else {
+            pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
+        }
+    }
+    self->reverse_thread_done = 1;
+    pthread_cond_broadcast(&self->packets_cond);
+    pthread_mutex_unlock(&self->packets_mutex);
+    return NULL;
+}
+
+/** Stop decoding for reverse playback.
+ *
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ *
+ * \param finish whether to wait for the thread to decode up to its end position
+ */
+
+static void reverse_stop(producer_avformat self, int finish)
+{
+    if (self->is_reverse_thread_init) {
+        pthread_mutex_lock(&self->packets_mutex);
+        if (!finish)
+            self->reverse_thread_stop = 1;
+        pthread_cond_broadcast(&self->packets_cond);
+        pthread_mutex_unlock(&self->packets_mutex);
+        pthread_join(self->reverse_thread, NULL);
+        self->is_reverse_thread_init = 0;
+
+        // The thread moved the demuxer and decoder, so the next decode must seek.
+        self->last_position = POSITION_INVALID;
+        self->current_position = POSITION_INVALID;
+        self->video_send_result = 0;
+    }
+}
+
+/** Start decoding the group of pictures before the frames kept for reverse
+ * playback, unless there is no room for it or it was already decoded.
+ *
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ */
+
+static void reverse_start(producer_avformat self, double delay, double source_fps)
+{
+    int64_t end;
+    int start;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    int running = self->is_reverse_thread_init && !self->reverse_thread_done;
+    pthread_mutex_unlock(&self->packets_mutex);
+    if (running)
+        return;
+    reverse_stop(self, 1);
+
+    pthread_mutex_lock(&self->packets_mutex);
+    end = self->reverse_count > 0 ? self->reverse_frames[0].position : 0;
+    start = self->is_thread_init && end > 0 && end != self->reverse_end
+            && self->reverse_bytes < self->reverse_max_bytes / 2;
+    pthread_mutex_unlock(&self->packets_mutex);
+
+    if (start) {
+        self->reverse_end = end;
+        self->reverse_delay = delay;
+        self->reverse_fps = source_fps;
+        self->reverse_thread_stop = 0;
+        self->reverse_thread_done = 0;
+        self->video_codec->skip_loop_filter = AVDISCARD_NONE;
+        self->video_codec->skip_frame = AVDISCARD_DEFAULT;
+        if (!pthread_create(&self->reverse_thread, NULL, reverse_worker, self))
+            self->is_reverse_thread_init = 1;
+    }
+}
+
+/** Take the frame for a position from the frames kept for reverse playback.
+ *
+ * The frames after the position were already played and are dropped.
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ *
+ * \return true if self->video_frame holds the frame
+ */
+
+static int reverse_take(producer_avformat self, int64_t req_position)
+{
+    int found = 0;
+
+    if (!self->video_frame)
+        self->video_frame = av_frame_alloc();
+    // The frame may be among those still being decoded
+    if (self->is_reverse_thread_init && req_position < self->reverse_end)
+        reverse_stop(self, 1);
+
+    pthread_mutex_lock(&self->packets_mutex);
+    while (self->reverse_count > 0) {
+        struct reverse_frame_s *last = &self->reverse_frames[self->reverse_count - 1];
+        if (last->position < req_position)
+            break;
+        if (last->position == req_position && self->video_frame) {
+            av_frame_unref(self->video_frame);
+            av_frame_move_ref(self->video_frame, last->frame);
+            found = 1;
+        }
+        self->reverse_bytes -= last->size;
+        av_frame_free(&last->frame);
+        self->reverse_count--;
+    }
+    pthread_mutex_unlock(&self->packets_mutex);
+    return found;
+}
+
+/** Stop decoding for reverse playback and drop the frames kept for it.
+ *
+ * The caller must hold video_mutex and must not hold packets_mutex.
+ */
+
+static void reverse_clear(producer_avformat self)
+{
+    reverse_stop(self, 0);
+    if (self->reverse_count > 0 && self->is_mutex_init) {
+        pthread_mutex_lock(&self->packets_mutex);
+        while (self->reverse_count > 0)
+            av_frame_free(&self->reverse_frames[--self->reverse_count].frame);
+        self->reverse_bytes = 0;
+        pthread_mutex_unlock(&self->packets_mutex);
+    }
+    self->reverse_end = POSITION_INVALID;
+}
+
+/** Apply the read-ahead properties.
+ *
+ * This is called when the packets thread starts and when one of the
+ * properties changes afterwards.
+ */
+
+static void apply_read_ahead(producer_avformat self, mlt_properties properties)
+{
+    pthread_mutex_lock(&self->packets_mutex);
+    self->read_ahead = mlt_properties_get_int(properties, "read_ahead");
+    self->read_ahead_bytes = mlt_properties_get_int64(properties, "read_ahead_bytes");
+    self->decode_ahead = mlt_properties_get_int(properties, "decode_ahead");
+    if (self->is_thread_init)
+        pthread_cond_broadcast(&self->packets_cond);
+    pthread_mutex_unlock(&self->packets_mutex);
+}
+
+/** Set a statistics property unless it already has the value.
+ *
+ * Setting a property fires property-changed, so this avoids that for every
+ * frame whose statistics did not change.
+ */
+
+static void set_stat(mlt_properties properties, const char *name, int64_t value)
+{
+    if (!mlt_properties_exists(properties, name)
+        || mlt_properties_get_int64(properties, name) != value)
+        mlt_properties_set_int64(properties, name, value);
+}
+
+/** Report the read-ahead and decode-ahead queue statistics.
+ */
+
+static void update_read_ahead(producer_avformat self, mlt_properties properties)
+{
+    int read_depth, decode_depth;
+    int64_t read_bytes, read_stall, decode_stall;
+
+    pthread_mutex_lock(&self->packets_mutex);
+    read_depth = self->vpackets ? mlt_deque_count(self->vpackets) : 0;
+    read_bytes = self->vpackets_bytes;
+    read_stall = self->read_stall;
+    decode_depth = self->vframes ? mlt_deque_count(self->vframes) : 0;
+    decode_stall = self->decode_stall;
+    pthread_mutex_unlock(&self->packets_mutex);
+
+    set_stat(properties, "_read_ahead.depth", read_depth);
+    set_stat(properties, "_read_ahead.depth_bytes", read_bytes);
+    set_stat(properties, "_read_ahead.stall_ms", read_stall / 1000);
+    set_stat(properties, "_decode_ahead.depth", decode_depth);
+    set_stat(properties, "_decode_ahead.stall_ms", decode_stall / 1000);
 }
 
 /** Get an image from a frame.
@@ -2249,6 +3198,7 @@ static int producer_get_image(mlt_frame frame,
         self->reset_image_cache = 0;
         mlt_cache_close(self->image_cache);
         self->image_cache = NULL;
+        reverse_clear(self);
         av_frame_free(&self->video_frame);
     }
 
@@ -2317,7 +3267,32 @@ static int producer_get_image(mlt_frame frame,
     // Seek if necessary
     double speed = mlt_producer_get_speed(producer);
     int preseek = must_decode && self->video_codec->has_b_frames && speed >= 0.0 && speed <= 1.0;
-    int paused = seek_video(self, position, req_position, preseek);
+    int paused = 0;
+
+    // Play backwards from frames decoded once per group of pictures
+    int64_t reverse_bytes = mlt_properties_get(properties, "reverse_cache_bytes")
+                                ? mlt_properties_get_int64(properties, "reverse_cache_bytes")
+                                : REVERSE_CACHE_BYTES;
+    if (self->is_mutex_init) {
+        pthread_mutex_lock(&self->packets_mutex);
+        self->reverse_max_bytes = reverse_bytes;
+        pthread_mutex_unlock(&self->packets_mutex);
+    }
+    int reverse = speed < 0.0 && must_decode && self->seekable && self->video_seekable
+                  && reverse_bytes > 0 && !is_album_art(self);
+    int reverse_hit = reverse && reverse_take(self, req_position);
+    if (!reverse_hit) {
+        if (speed > 0.0 || reverse_bytes <= 0)
+            reverse_clear(self);
+        else
+            reverse_stop(self, 0);
+        paused = seek_video(self, position, req_position, preseek);
+        if (reverse) {
+            // The frames before the requested one are kept, so decode them fully
+            self->video_codec->skip_loop_filter = AVDISCARD_NONE;
+            self->video_codec->skip_frame = AVDISCARD_DEFAULT;
+        }
+    }
 
     // Seek might have reopened the file
     context = self->video_format;
@@ -2334,7 +3309,7 @@ static int producer_get_image(mlt_frame frame,
 #endif
 
     // Duplicate the last image if necessary
-    if (self->video_frame && self->video_frame->linesize[0]
+    if (!reverse_hit && self->video_frame && self->video_frame->linesize[0]
         && (self->pkt.stream_index == self->video_index)
         && (paused || self->current_position >= req_position)) {
         // Duplicate it
@@ -2361,31 +3336,53 @@ static int producer_get_image(mlt_frame frame,
         // Construct an AVFrame for YUV422 conversion
         if (!self->video_frame)
             self->video_frame = av_frame_alloc();
-        else
+        else if (!reverse_hit)
             av_frame_unref(self->video_frame);
 
         if (!self->is_thread_init) {
             pthread_cond_init(&self->packets_cond, NULL);
+            apply_read_ahead(self, properties);
+            update_read_ahead(self, properties);
             pthread_create(&self->packets_thread, NULL, packets_worker, self);
             self->is_thread_init = 1;
         }
 
+        if (reverse_hit) {
+            int_position = req_position;
+            got_picture = 1;
+            goto got_decoded_frame;
+        }
+
+        // Use a frame decoded ahead when playing linearly
+        if (take_decoded_frame(self, req_position, delay, source_fps, &int_position)) {
+            got_picture = 1;
+            goto got_decoded_frame;
+        }
+
         while (!got_picture && ignore_send_packet_result(self->video_send_result)) {
+            // Continue from where decoding ahead left off
+            decode_ahead_stop(self);
+
             if (self->video_send_result != AVERROR(EAGAIN)) {
                 // Read a packet
                 if (self->pkt.stream_index == self->video_index)
                     av_packet_unref(&self->pkt);
                 av_init_packet(&self->pkt);
                 pthread_mutex_lock(&self->packets_mutex);
-                while (mlt_deque_count(self->vpackets) == 0 && self->packets_thread_ret == 0) {
-                    pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
+                if (mlt_deque_count(self->vpackets) == 0 && self->packets_thread_ret == 0) {
+                    int64_t start = av_gettime_relative();
+                    while (mlt_deque_count(self->vpackets) == 0 && self->packets_thread_ret == 0) {
+                        pthread_cond_wait(&self->packets_cond, &self->packets_mutex);
+                    }
+                    self->read_stall += av_gettime_relative() - start;
                 }
 
                 if (self->packets_thread_ret == 0) {
                     AVPacket *tmp = (AVPacket *) mlt_deque_pop_front(self->vpackets);
+                    self->vpackets_bytes -= tmp->size;
                     av_packet_ref(&self->pkt, tmp);
                     av_packet_free(&tmp);
-                    pthread_cond_signal(&self->packets_cond);
+                    pthread_cond_broadcast(&self->packets_cond);
                 } else {
                     if (self->packets_thread_ret == AVERROR_EOF) {
                         self->pkt.stream_index = self->video_index;
@@ -2393,7 +3390,7 @@ static int producer_get_image(mlt_frame frame,
 
                     // notify packets_worker that we've seen the error
                     self->packets_thread_ret = 0;
-                    pthread_cond_signal(&self->packets_cond);
+                    pthread_cond_broadcast(&self->packets_cond);
 
                     if (!self->video_seekable && mlt_properties_get_int(properties, "reconnect")) {
                         // Try to reconnect to live sources by closing context and codecs,
@@ -2465,8 +3462,10 @@ static int producer_get_image(mlt_frame frame,
 #if LIBAVCODEC_VERSION_MAJOR < 61
                     self->video_codec->reordered_opaque = int_position;
 #endif
-                    if (int_position >= req_position)
+                    if (int_position >= req_position) {
                         self->video_codec->skip_loop_filter = AVDISCARD_NONE;
+                        self->video_codec->skip_frame = AVDISCARD_DEFAULT;
+                    }
                     self->video_send_result = avcodec_send_packet(self->video_codec, &self->pkt);
                     mlt_log_debug(MLT_PRODUCER_SERVICE(producer),
                                   "decoded video packet with size %d => %d\n",
@@ -2487,26 +3486,8 @@ static int producer_get_image(mlt_frame frame,
                                 self->last_good_position = POSITION_INVALID;
                             }
                         } else {
-                            if (self->hwaccel.device_ctx
-                                && self->video_frame->format == self->hwaccel.pix_fmt) {
-                                AVFrame *sw_video_frame = av_frame_alloc();
-                                int transfer_data_result
-                                    = av_hwframe_transfer_data(sw_video_frame, self->video_frame, 0);
-                                if (transfer_data_result < 0) {
-                                    mlt_log_error(MLT_PRODUCER_SERVICE(producer),
-                                                  "av_hwframe_transfer_data() failed %d\n",
-                                                  transfer_data_result);
-                                    av_frame_free(&sw_video_frame);
-                                    goto exit_get_image;
-                                }
-                                av_frame_copy_props(sw_video_frame, self->video_frame);
-                                sw_video_frame->width = self->video_frame->width;
-                                sw_video_frame->height = self->video_frame->height;
-
-                                av_frame_unref(self->video_frame);
-                                av_frame_move_ref(self->video_frame, sw_video_frame);
-                                av_frame_free(&sw_video_frame);
-                            }
+                            if (transfer_hw_frame(self, self->video_frame))
+                                goto exit_get_image;
                             got_picture = 1;
                             decode_errors = 0;
                         }
@@ -2518,28 +3499,21 @@ static int producer_get_image(mlt_frame frame,
 #if LIBAVCODEC_VERSION_MAJOR < 61
                     int_position = self->video_frame->reordered_opaque;
 #endif
-                    pts = best_pts(self, self->video_frame->pts, self->video_frame->pkt_dts);
-                    if (pts != AV_NOPTS_VALUE) {
-                        // Some streams are not marking their key frames even though
-                        // there are I frames, and find_first_pts() fails as a result.
-                        // Try to set first_pts here after getting pict_type.
-                        if (self->first_pts == AV_NOPTS_VALUE
-                            && (self->video_frame->key_frame
-                                || self->video_frame->pict_type == AV_PICTURE_TYPE_I))
-                            self->first_pts = pts;
-                        if (self->first_pts != AV_NOPTS_VALUE)
-                            pts -= self->first_pts;
-                        else if (context->start_time != AV_NOPTS_VALUE)
-                            pts -= context->start_time;
-                        int_position = (int64_t) ((av_q2d(self->video_time_base) * pts + delay)
-                                                      * source_fps
-                                                  + 0.5);
-                    }
-
-                    if (int_position < req_position)
+                    int_position = decoded_frame_position(self,
+                                                          self->video_frame,
+                                                          int_position,
+                                                          delay,
+                                                          source_fps);
+
+                    if (int_position < req_position) {
+                        // Keep the frames before the requested one to play them next
+                        if (reverse)
+                            reverse_put(self, int_position, self->video_frame);
                         got_picture = 0;
-                    else if (int_position >= req_position)
+                    } else if (int_position >= req_position) {
                         self->video_codec->skip_loop_filter = AVDISCARD_NONE;
+                        self->video_codec->skip_frame = AVDISCARD_DEFAULT;
+                    }
                 } else if (!self->pkt.data) // draining decoder with null packets
                 {
                     self->video_send_result = -1;
@@ -2552,6 +3526,7 @@ static int producer_get_image(mlt_frame frame,
                               int_position);
             }
 
+        got_decoded_frame:
             // Now handle the picture if we have one
             if (got_picture) {
                 // Detect and correct scan type
@@ -2617,6 +3592,14 @@ static int producer_get_image(mlt_frame frame,
                 && !(!self->video_seekable && self->pkt.stream_index == self->audio_index))
                 av_packet_unref(&self->pkt);
         }
+
+        // Keep decoding ahead while playing forward at normal speed
+        if (got_picture && speed == 1.0 && self->seekable && self->video_seekable
+            && !is_album_art(self))
+            decode_ahead_start(self);
+        // Decode the previous group of pictures while playing backwards
+        else if (got_picture && reverse)
+            reverse_start(self, delay, source_fps);
     }
 
     // set alpha
@@ -2669,6 +3652,9 @@ static int producer_get_image(mlt_frame frame,
     self->video_expected = position + 1;
 
 exit_get_image:
+    mlt_cache_get_stats(self->image_cache, properties, "_image_cache.");
+    if (self->is_thread_init)
+        update_read_ahead(self, properties);
     pthread_mutex_unlock(&self->video_mutex);
 
     mlt_properties_set_int(frame_properties, "progressive", self->progressive);
@@ -3021,6 +4007,8 @@ static void producer_set_up_video(producer_avformat self, mlt_frame frame)
         // Reset the video properties if the index changed
         self->video_index = index;
         mlt_properties_set_int(properties, "_probe_complete", 0);
+        decode_ahead_stop(self);
+        reverse_clear(self);
         pthread_mutex_lock(&self->open_mutex);
         avcodec_free_context(&self->video_codec);
         set_up_discard(self, self->audio_index, index);
@@ -3473,6 +4461,7 @@ static int producer_get_audio(mlt_frame frame,
                 ret = av_read_frame(context, &pkt);
                 if (ret >= 0 && !self->seekable && pkt.stream_index == self->video_index) {
                     mlt_deque_push_back(self->vpackets, av_packet_clone(&pkt));
+                    self->vpackets_bytes += pkt.size;
                 } else if (ret == AVERROR(EAGAIN)) {
                     ret = 0;
                     pthread_mutex_unlock(&self->packets_mutex);
@@ -3641,6 +4630,9 @@ done_get_audio:
     if (!paused)
         self->audio_expected = position + 1;
 
+    mlt_cache_get_stats(self->audio_cache,
+                        MLT_PRODUCER_PROPERTIES(self->parent),
+                        "_audio_cache.");
     pthread_mutex_unlock(&self->audio_mutex);
 
     return 0;
@@ -3997,6 +4989,11 @@ static void producer_avformat_close(producer_avformat self)
         mlt_events_disconnect(MLT_PRODUCER_PROPERTIES(self->parent), self);
     pthread_mutex_unlock(&self->close_mutex);
 
+    // Stop decoding ahead before closing the codec
+    decode_ahead_stop(self);
+    reverse_clear(self);
+    free(self->reverse_frames);
+
     // Cleanup av contexts
     av_packet_unref(&self->pkt);
     av_frame_free(&self->video_frame);
@@ -4016,11 +5013,12 @@ static void producer_avformat_close(producer_avformat self)
     if (self->is_thread_init) {
         pthread_mutex_lock(&self->packets_mutex);
         self->packets_thread_stop = 1;
-        pthread_cond_signal(&self->packets_cond);
+        pthread_cond_broadcast(&self->packets_cond);
         pthread_mutex_unlock(&self->packets_mutex);
         pthread_join(self->packets_thread, NULL);
         pthread_cond_destroy(&self->packets_cond);
     }
+    close_keyframe_index(self);
     if (self->dummy_context)
         avformat_close_input(&self->dummy_context);
     if (self->seekable && self->audio_format)
@@ -4038,6 +5036,11 @@ static void producer_avformat_close(producer_avformat self)
     mlt_cache_close(self->audio_cache);
     if (self->last_good_frame)
         mlt_frame_close(self->last_good_frame);
+    sws_cache_close(&self->sws_yuvp);
+    sws_cache_close(&self->sws_rgb);
+    for (i = 0; i < self->sws_slices_count; i++)
+        sws_cache_close(&self->sws_slices[i]);
+    free(self->sws_slices);
 
     // Cleanup the mutexes
     if (self->is_mutex_init) {
@@ -4064,6 +5067,8 @@ static void producer_avformat_close(producer_avformat self)
         mlt_deque_close(self->vpackets);
         self->vpackets = NULL;
     }
+    if (self->vframes)
+        mlt_deque_close(self->vframes);
 
     free(self);
 }
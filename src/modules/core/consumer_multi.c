@@ -51,6 +51,8 @@ mlt_consumer consumer_multi_init(mlt_profile profile,
         mlt_properties_set(properties, "resource", arg);
         mlt_properties_set_int(properties, "real_time", -1);
         mlt_properties_set_int(properties, "terminate_on_pause", 1);
+        mlt_properties_set_int(properties, "put_buffer", 4);
+        mlt_properties_set_int(properties, "deep_clone", 1);
 
         // Init state
         mlt_properties_set_int(properties, "joined", 1);
@@ -189,7 +191,7 @@ static mlt_consumer generate_consumer(mlt_consumer consumer, mlt_properties prop
                                 NULL);
 
         mlt_properties_set_int(nested_props, "put_mode", 1);
-        mlt_properties_pass_list(nested_props, properties, "terminate_on_pause");
+        mlt_properties_pass_list(nested_props, properties, "terminate_on_pause put_buffer");
         mlt_properties_set(props, "consumer", NULL);
         // set mlt_profile before other properties to facilitate presets
         mlt_properties_pass_list(nested_props, props, "mlt_profile");
@@ -311,8 +313,7 @@ static void foreach_consumer_start(mlt_consumer consumer)
             mlt_properties_set_position(nested_props,
                                         "_multi_position",
                                         mlt_properties_get_position(properties, "in"));
-            mlt_properties_set_data(nested_props, "_multi_audio", NULL, 0, NULL, NULL);
-            mlt_properties_set_int(nested_props, "_multi_samples", 0);
+            mlt_audio_fifo_clear(mlt_properties_get_data(nested_props, "_multi_audio", NULL));
             mlt_consumer_start(nested);
         }
     } while (nested);
@@ -385,19 +386,22 @@ static void foreach_consumer_put(mlt_consumer consumer, mlt_frame frame)
                                 &channels,
                                 &current_samples);
             int current_size = mlt_audio_format_size(format, current_samples, channels);
-
-            // get any leftover audio
-            int prev_size = 0;
-            uint8_t *prev_buffer = mlt_properties_get_data(nested_props, "_multi_audio", &prev_size);
-            uint8_t *new_buffer = NULL;
-            if (prev_size > 0) {
-                new_buffer = mlt_pool_alloc(prev_size + current_size);
-                memcpy(new_buffer, prev_buffer, prev_size);
-                memcpy(new_buffer + prev_size, buffer, current_size);
-                buffer = new_buffer;
+            int sample_size = mlt_audio_format_size(format, 1, channels);
+
+            // queue the audio after any leftover audio
+            mlt_audio_fifo fifo = mlt_properties_get_data(nested_props, "_multi_audio", NULL);
+            if (!fifo) {
+                fifo = mlt_audio_fifo_new(current_size * 2);
+                mlt_properties_set_data(nested_props,
+                                        "_multi_audio",
+                                        fifo,
+                                        0,
+                                        (mlt_destructor) mlt_audio_fifo_close,
+                                        NULL);
             }
-            current_size += prev_size;
-            current_samples += mlt_properties_get_int(nested_props, "_multi_samples");
+            if (current_size > 0)
+                mlt_audio_fifo_write(fifo, buffer, current_size);
+            current_samples = sample_size > 0 ? mlt_audio_fifo_used(fifo) / sample_size : 0;
 
             // This log line somehow fixes a bug in release build on clang/macOS
             // https://forum.shotcut.org/t/shotcut-export-drops-frames/42676
@@ -408,7 +412,9 @@ static void foreach_consumer_put(mlt_consumer consumer, mlt_frame frame)
                           self_time);
             while (nested_time <= self_time) {
                 // put ideal number of samples into cloned frame
-                int deeply = index > 1 ? 1 : 0;
+                // Frames have no copy-on-write buffers, and filters of an output may write
+                // the image in place, so only share it with later outputs when asked to.
+                int deeply = index > 1 && mlt_properties_get_int(properties, "deep_clone");
                 mlt_frame clone_frame = mlt_frame_clone(frame, deeply);
                 mlt_properties clone_props = MLT_FRAME_PROPERTIES(clone_frame);
                 int nested_samples = mlt_audio_calculate_frame_samples(nested_fps,
@@ -418,22 +424,23 @@ static void foreach_consumer_put(mlt_consumer consumer, mlt_frame frame)
                 nested_samples = nested_samples > current_samples - 10 ? current_samples
                                                                        : nested_samples;
                 int nested_size = mlt_audio_format_size(format, nested_samples, channels);
+                uint8_t *nested_buffer = NULL;
                 if (nested_size > 0) {
-                    prev_buffer = mlt_pool_alloc(nested_size);
-                    memcpy(prev_buffer, buffer, nested_size);
+                    nested_buffer = mlt_pool_alloc(nested_size);
+                    mlt_audio_fifo_read(fifo, nested_buffer, nested_size);
                 } else {
-                    prev_buffer = NULL;
                     nested_size = 0;
                 }
-                mlt_frame_set_audio(clone_frame, prev_buffer, format, nested_size, mlt_pool_release);
+                mlt_frame_set_audio(clone_frame,
+                                    nested_buffer,
+                                    format,
+                                    nested_size,
+                                    mlt_pool_release);
                 mlt_properties_set_int(clone_props, "audio_samples", nested_samples);
                 mlt_properties_set_int(clone_props, "audio_frequency", frequency);
                 mlt_properties_set_int(clone_props, "audio_channels", channels);
 
-                // chomp the audio
                 current_samples -= nested_samples;
-                current_size -= nested_size;
-                buffer += nested_size;
 
                 // Fix some things
                 mlt_properties_set_int(clone_props,
@@ -449,23 +456,7 @@ static void foreach_consumer_put(mlt_consumer consumer, mlt_frame frame)
                 mlt_properties_set_position(nested_props, "_multi_position", ++nested_pos);
                 nested_time = nested_pos / nested_fps;
             }
-
-            // save any remaining audio
-            if (current_size > 0) {
-                prev_buffer = mlt_pool_alloc(current_size);
-                memcpy(prev_buffer, buffer, current_size);
-            } else {
-                prev_buffer = NULL;
-                current_size = 0;
-            }
-            mlt_pool_release(new_buffer);
-            mlt_properties_set_data(nested_props,
-                                    "_multi_audio",
-                                    prev_buffer,
-                                    current_size,
-                                    mlt_pool_release,
-                                    NULL);
-            mlt_properties_set_int(nested_props, "_multi_samples", current_samples);
+            // any remaining audio stays queued for the next frame
         }
     } while (nested);
 }
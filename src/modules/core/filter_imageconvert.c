@@ -22,8 +22,17 @@
 #include <framework/mlt_image.h>
 #include <framework/mlt_log.h>
 #include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
 
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#include <emmintrin.h>
+#endif
+
+/** The fewest lines given to each slice thread. */
+#define MIN_SLICE_HEIGHT 32
 
 /** This macro converts a YUV value to the RGB color space. */
 #define RGB2YUV_601_UNSCALED(r, g, b, y, u, v) \
@@ -55,19 +64,141 @@
 #define YUV2RGB_601 YUV2RGB_601_UNSCALED
 #endif
 
-static void convert_yuv422_to_rgba(mlt_image src, mlt_image dst)
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+
+/** Convert 8 pixels to RGBA using the same integer math as YUV2RGB_601_SCALED.
+ *
+ * \p y holds 8 16-bit luma samples, \p uv holds 4 16-bit u,v pairs (each shared by
+ * 2 pixels), and the low 8 bytes of \p a hold the alpha samples.
+ */
+static inline void yuv_to_rgba_sse2(__m128i y, __m128i uv, __m128i a, uint8_t *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+    uv = _mm_sub_epi16(uv, _mm_set1_epi16(128));
+
+    __m128i y_lo = _mm_madd_epi16(_mm_unpacklo_epi16(y, zero), _mm_set1_epi32(1192));
+    __m128i y_hi = _mm_madd_epi16(_mm_unpackhi_epi16(y, zero), _mm_set1_epi32(1192));
+    __m128i r = _mm_madd_epi16(uv, _mm_set_epi16(1634, 0, 1634, 0, 1634, 0, 1634, 0));
+    __m128i g = _mm_madd_epi16(uv,
+                               _mm_set_epi16(-832, -401, -832, -401, -832, -401, -832, -401));
+    __m128i b = _mm_madd_epi16(uv, _mm_set_epi16(0, 2066, 0, 2066, 0, 2066, 0, 2066));
+
+#define YUV_TO_RGBA_SSE2_CHANNEL(c) \
+    c = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(y_lo, _mm_shuffle_epi32(c, 0x50)), 10), \
+                        _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_shuffle_epi32(c, 0xfa)), 10)); \
+    c = _mm_packus_epi16(c, zero)
+
+    YUV_TO_RGBA_SSE2_CHANNEL(r);
+    YUV_TO_RGBA_SSE2_CHANNEL(g);
+    YUV_TO_RGBA_SSE2_CHANNEL(b);
+#undef YUV_TO_RGBA_SSE2_CHANNEL
+
+    __m128i rg = _mm_unpacklo_epi8(r, g);
+    __m128i ba = _mm_unpacklo_epi8(b, a);
+    _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+/** Convert 4 RGBA pixels using the same integer math as RGB2YUV_601_SCALED.
+ *
+ * This returns the luma of each pixel in \p y and the u,v averages of each pixel
+ * pair in \p uv, both as 32-bit lanes in yuv422 order.
+ */
+static inline void rgba_to_yuv_sse2(__m128i pixels, __m128i *y, __m128i *uv)
+{
+    __m128i rb = _mm_and_si128(pixels, _mm_set1_epi32(0x00ff00ff));
+    __m128i ga = _mm_srli_epi16(pixels, 8);
+    __m128i u, v;
+
+    *y = _mm_add_epi32(_mm_madd_epi16(rb, _mm_set_epi16(100, 263, 100, 263, 100, 263, 100, 263)),
+                       _mm_madd_epi16(ga, _mm_set1_epi32(516)));
+    *y = _mm_add_epi32(_mm_srai_epi32(*y, 10), _mm_set1_epi32(16));
+    u = _mm_add_epi32(_mm_madd_epi16(rb,
+                                     _mm_set_epi16(450, -152, 450, -152, 450, -152, 450, -152)),
+                      _mm_madd_epi16(ga, _mm_set1_epi32(-300 & 0xffff)));
+    u = _mm_add_epi32(_mm_srai_epi32(u, 10), _mm_set1_epi32(128));
+    v = _mm_add_epi32(_mm_madd_epi16(rb, _mm_set_epi16(-73, 450, -73, 450, -73, 450, -73, 450)),
+                      _mm_madd_epi16(ga, _mm_set1_epi32(-377 & 0xffff)));
+    v = _mm_add_epi32(_mm_srai_epi32(v, 10), _mm_set1_epi32(128));
+
+    // Average each pixel pair into lanes 0 and 2.
+    u = _mm_srai_epi32(_mm_add_epi32(u, _mm_srli_epi64(u, 32)), 1);
+    v = _mm_srai_epi32(_mm_add_epi32(v, _mm_srli_epi64(v, 32)), 1);
+    *uv = _mm_unpacklo_epi64(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+}
+
+static int yuv422_to_rgba_line_sse2(uint8_t *src, uint8_t *alpha, uint8_t *dst, int width)
+{
+    int n = width & ~7;
+    for (int i = 0; i < n; i += 8) {
+        __m128i in = _mm_loadu_si128((__m128i *) (src + i * 2));
+        __m128i a = alpha ? _mm_loadl_epi64((__m128i *) (alpha + i)) : _mm_set1_epi8(0xff);
+        yuv_to_rgba_sse2(_mm_and_si128(in, _mm_set1_epi16(0xff)),
+                         _mm_srli_epi16(in, 8),
+                         a,
+                         dst + i * 4);
+    }
+    return n;
+}
+
+static int yuv420p_to_rgba_line_sse2(
+    uint8_t *src_y, uint8_t *src_u, uint8_t *src_v, uint8_t *alpha, uint8_t *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int n = width & ~7;
+    for (int i = 0; i < n; i += 8) {
+        int32_t u, v;
+        memcpy(&u, src_u + i / 2, sizeof(u));
+        memcpy(&v, src_v + i / 2, sizeof(v));
+        __m128i y = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (src_y + i)), zero);
+        __m128i uv = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(u),
+                                                         _mm_cvtsi32_si128(v)),
+                                       zero);
+        __m128i a = alpha ? _mm_loadl_epi64((__m128i *) (alpha + i)) : _mm_set1_epi8(0xff);
+        yuv_to_rgba_sse2(y, uv, a, dst + i * 4);
+    }
+    return n;
+}
+
+static int rgba_to_yuv422_line_sse2(uint8_t *src, uint8_t *dst, uint8_t *alpha, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int n = width & ~7;
+    for (int i = 0; i < n; i += 8) {
+        __m128i p0 = _mm_loadu_si128((__m128i *) (src + i * 4));
+        __m128i p1 = _mm_loadu_si128((__m128i *) (src + i * 4 + 16));
+        __m128i y0, uv0, y1, uv1;
+        rgba_to_yuv_sse2(p0, &y0, &uv0);
+        rgba_to_yuv_sse2(p1, &y1, &uv1);
+        __m128i out0 = _mm_packs_epi32(_mm_unpacklo_epi32(y0, uv0), _mm_unpackhi_epi32(y0, uv0));
+        __m128i out1 = _mm_packs_epi32(_mm_unpacklo_epi32(y1, uv1), _mm_unpackhi_epi32(y1, uv1));
+        _mm_storeu_si128((__m128i *) (dst + i * 2), _mm_packus_epi16(out0, out1));
+        __m128i a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+        _mm_storel_epi64((__m128i *) (alpha + i), _mm_packus_epi16(a, zero));
+    }
+    return n;
+}
+
+#endif
+
+static void convert_yuv422_to_rgba(mlt_image src, mlt_image dst, int start, int count)
 {
     int yy, uu, vv;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pAlpha = src->planes[3] + src->strides[3] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
+        int done = 0;
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+        done = yuv422_to_rgba_line_sse2(pSrc, pAlpha, pDst, src->width);
+        pSrc += done * 2;
+        pAlpha += pAlpha ? done : 0;
+        pDst += done * 4;
+#endif
+        int total = (src->width - done) / 2 + 1;
 
         if (pAlpha)
             while (--total) {
@@ -110,15 +241,12 @@ static void convert_yuv422_to_rgba(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_yuv422_to_rgb(mlt_image src, mlt_image dst)
+static void convert_yuv422_to_rgb(mlt_image src, mlt_image dst, int start, int count)
 {
     int yy, uu, vv;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
         int total = src->width / 2 + 1;
@@ -141,20 +269,23 @@ static void convert_yuv422_to_rgb(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_rgba_to_yuv422(mlt_image src, mlt_image dst)
+static void convert_rgba_to_yuv422(mlt_image src, mlt_image dst, int start, int count)
 {
     int y0, y1, u0, u1, v0, v1;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-    mlt_image_alloc_alpha(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
         uint8_t *pAlpha = dst->planes[3] + dst->strides[3] * line;
-        int j = src->width / 2 + 1;
+        int done = 0;
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+        done = rgba_to_yuv422_line_sse2(pSrc, pDst, pAlpha, src->width);
+        pSrc += done * 4;
+        pDst += done * 2;
+        pAlpha += done;
+#endif
+        int j = (src->width - done) / 2 + 1;
         while (--j) {
             r = *pSrc++;
             g = *pSrc++;
@@ -183,15 +314,12 @@ static void convert_rgba_to_yuv422(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_rgb_to_yuv422(mlt_image src, mlt_image dst)
+static void convert_rgb_to_yuv422(mlt_image src, mlt_image dst, int start, int count)
 {
     int y0, y1, u0, u1, v0, v1;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
         int j = src->width / 2 + 1;
@@ -220,12 +348,9 @@ static void convert_rgb_to_yuv422(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_yuv420p_to_yuv422(mlt_image src, mlt_image dst)
+static void convert_yuv420p_to_yuv422(mlt_image src, mlt_image dst, int start, int count)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
         uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
         uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
@@ -240,15 +365,12 @@ static void convert_yuv420p_to_yuv422(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_yuv420p_to_rgb(mlt_image src, mlt_image dst)
+static void convert_yuv420p_to_rgb(mlt_image src, mlt_image dst, int start, int count)
 {
     int yy, uu, vv;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
         uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
         uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
@@ -272,21 +394,27 @@ static void convert_yuv420p_to_rgb(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_yuv420p_to_rgba(mlt_image src, mlt_image dst)
+static void convert_yuv420p_to_rgba(mlt_image src, mlt_image dst, int start, int count)
 {
     int yy, uu, vv;
     int r, g, b;
 
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
         uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
         uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
         uint8_t *pSrcA = src->planes[3] + src->strides[3] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
+        int done = 0;
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+        done = yuv420p_to_rgba_line_sse2(pSrcY, pSrcU, pSrcV, pSrcA, pDst, src->width);
+        pSrcY += done;
+        pSrcU += done / 2;
+        pSrcV += done / 2;
+        pSrcA += pSrcA ? done : 0;
+        pDst += done * 4;
+#endif
+        int total = (src->width - done) / 2 + 1;
         if (pSrcA)
             while (--total) {
                 yy = *pSrcY++;
@@ -326,16 +454,12 @@ static void convert_yuv420p_to_rgba(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst)
+static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst, int start, int count)
 {
-    int lines = src->height;
     int pixels = src->width;
 
-    mlt_image_set_values(dst, NULL, mlt_image_yuv420p, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
     // Y
-    for (int line = 0; line < lines; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
         for (int pixel = 0; pixel < pixels; pixel++) {
@@ -344,13 +468,15 @@ static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst)
         }
     }
 
-    lines = src->height / 2;
+    // Chroma rows are taken from the even lines of this slice.
+    int lines = MIN(start + count, src->height / 2 * 2);
+    start += start % 2;
     pixels = src->width / 2;
 
     // U
-    for (int line = 0; line < lines; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line * 2 + 1;
-        uint8_t *pDst = dst->planes[1] + dst->strides[1] * line;
+    for (int line = start; line < lines; line += 2) {
+        uint8_t *pSrc = src->planes[0] + src->strides[0] * line + 1;
+        uint8_t *pDst = dst->planes[1] + dst->strides[1] * (line / 2);
         for (int pixel = 0; pixel < pixels; pixel++) {
             *pDst++ = *pSrc;
             pSrc += 4;
@@ -358,9 +484,9 @@ static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst)
     }
 
     // V
-    for (int line = 0; line < lines; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line * 2 + 3;
-        uint8_t *pDst = dst->planes[2] + dst->strides[2] * line;
+    for (int line = start; line < lines; line += 2) {
+        uint8_t *pSrc = src->planes[0] + src->strides[0] * line + 3;
+        uint8_t *pDst = dst->planes[2] + dst->strides[2] * (line / 2);
         for (int pixel = 0; pixel < pixels; pixel++) {
             *pDst++ = *pSrc;
             pSrc += 4;
@@ -368,12 +494,9 @@ static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_rgb_to_rgba(mlt_image src, mlt_image dst)
+static void convert_rgb_to_rgba(mlt_image src, mlt_image dst, int start, int count)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pAlpha = src->planes[3] + src->strides[3] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
@@ -397,13 +520,9 @@ static void convert_rgb_to_rgba(mlt_image src, mlt_image dst)
     }
 }
 
-static void convert_rgba_to_rgb(mlt_image src, mlt_image dst)
+static void convert_rgba_to_rgb(mlt_image src, mlt_image dst, int start, int count)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-    mlt_image_alloc_alpha(dst);
-
-    for (int line = 0; line < src->height; line++) {
+    for (int line = start; line < start + count; line++) {
         uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
         uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
         uint8_t *pAlpha = dst->planes[3] + dst->strides[3] * line;
@@ -418,7 +537,10 @@ static void convert_rgba_to_rgb(mlt_image src, mlt_image dst)
     }
 }
 
-typedef void (*conversion_function)(mlt_image src, mlt_image dst);
+/** A conversion function converts \p count lines of \p src into \p dst starting at \p start.
+ */
+
+typedef void (*conversion_function)(mlt_image src, mlt_image dst, int start, int count);
 
 static conversion_function conversion_matrix[mlt_image_invalid - 1][mlt_image_invalid - 1] = {
     {NULL, convert_rgb_to_rgba, convert_rgb_to_yuv422, NULL, NULL, NULL, NULL},
@@ -436,6 +558,23 @@ static conversion_function conversion_matrix[mlt_image_invalid - 1][mlt_image_in
     {NULL, NULL, NULL, NULL, NULL, NULL, NULL},
 };
 
+struct sliced_desc
+{
+    conversion_function converter;
+    mlt_image src;
+    mlt_image dst;
+};
+
+static int sliced_proc(int id, int index, int jobs, void *cookie)
+{
+    (void) id; // unused
+    struct sliced_desc *desc = (struct sliced_desc *) cookie;
+    int slice_line_start,
+        slice_height = mlt_slices_size_slice(jobs, index, desc->src->height, &slice_line_start);
+    desc->converter(desc->src, desc->dst, slice_line_start, slice_height);
+    return 0;
+}
+
 static int convert_image(mlt_frame frame,
                          uint8_t **buffer,
                          mlt_image_format *format,
@@ -457,7 +596,7 @@ static int convert_image(mlt_frame frame,
                       height);
         if (converter) {
             struct mlt_image_s src;
-            struct mlt_image_s dst;
+            struct mlt_image_s dst = {0};
             mlt_image_set_values(&src, *buffer, *format, width, height);
             if (requested_format == mlt_image_rgba && mlt_frame_get_alpha(frame)) {
                 // imageconvert leaves the alpha buffer alone except in the case of rgba.
@@ -466,7 +605,20 @@ static int convert_image(mlt_frame frame,
                 src.planes[3] = mlt_frame_get_alpha(frame);
                 src.strides[3] = src.width;
             }
-            converter(&src, &dst);
+            mlt_image_set_values(&dst, NULL, requested_format, width, height);
+            mlt_image_alloc_data(&dst);
+            if (*format == mlt_image_rgba)
+                mlt_image_alloc_alpha(&dst);
+
+            // Small images are not worth the cost of waking up the slice threads.
+            int jobs = mlt_slices_count_normal();
+            jobs = MIN(jobs, height / MIN_SLICE_HEIGHT);
+            if (jobs > 1) {
+                struct sliced_desc desc = {converter, &src, &dst};
+                mlt_slices_run_normal(jobs, sliced_proc, &desc);
+            } else {
+                converter(&src, &dst, 0, height);
+            }
             mlt_frame_set_image(frame, dst.data, 0, dst.release_data);
             if (requested_format == mlt_image_rgba) {
                 // Clear the alpha buffer on the frame
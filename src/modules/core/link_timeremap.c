@@ -30,8 +30,12 @@
 // Private Types
 typedef struct
 {
-    mlt_position prev_integration_position;
-    double prev_integration_time;
+    double *integration_times; // source time at in + index, extended on demand
+    int integration_count;     // number of valid entries in integration_times
+    int integration_size;      // allocated entries in integration_times
+    mlt_position integration_in;
+    mlt_position integration_length;
+    double integration_fps;
     mlt_frame prev_frame;
     mlt_filter resample_filter;
     mlt_filter pitch_filter;
@@ -51,8 +55,7 @@ static void property_changed(mlt_service owner, mlt_link self, mlt_event_data ev
     } else if (strcmp("speed_map", name) == 0) {
         // speed_map changed. Need to re-integrate from the beginning.
         private_data *pdata = (private_data *) self->child;
-        pdata->prev_integration_position = 0;
-        pdata->prev_integration_time = 0.0;
+        pdata->integration_count = 0;
     }
 }
 
@@ -63,35 +66,51 @@ static double integrate_source_time(mlt_link self, mlt_position position)
     mlt_position length = mlt_producer_get_length(MLT_LINK_PRODUCER(self));
     mlt_position in = mlt_producer_get_in(MLT_LINK_PRODUCER(self));
     double link_fps = mlt_producer_get_fps(MLT_LINK_PRODUCER(self));
-    mlt_position integration_distance = abs(pdata->prev_integration_position - position);
+    double source_time = 0.0;
 
-    if (pdata->prev_integration_position < in || integration_distance > (position - in)) {
-        // Restart integration from the beginning
-        pdata->prev_integration_position = in;
-        pdata->prev_integration_time = 0.0;
+    if (position < in) {
+        // Integrate backwards from the in point. This is not cached.
+        for (mlt_position p = position; p < in; p++) {
+            double speed = mlt_properties_anim_get_double(properties, "speed_map", p - in, length);
+            source_time -= speed / link_fps;
+        }
+        return source_time;
     }
 
-    double source_time = pdata->prev_integration_time;
+    // The cached times depend on the in point and length through the animation.
+    if (pdata->integration_in != in || pdata->integration_length != length
+        || pdata->integration_fps != link_fps) {
+        pdata->integration_count = 0;
+        pdata->integration_in = in;
+        pdata->integration_length = length;
+        pdata->integration_fps = link_fps;
+    }
 
-    if (pdata->prev_integration_position < position) {
-        for (mlt_position p = pdata->prev_integration_position; p < position; p++) {
-            double speed = mlt_properties_anim_get_double(properties, "speed_map", p - in, length);
-            double time_delta = speed / link_fps;
-            source_time += time_delta;
-        }
-    } else if (pdata->prev_integration_position > position) {
-        for (mlt_position p = position; p < pdata->prev_integration_position; p++) {
-            double speed = mlt_properties_anim_get_double(properties, "speed_map", p - in, length);
-            double time_delta = speed / link_fps;
-            source_time -= time_delta;
-        }
+    // Extend the table of running sums up to the requested position.
+    int index = position - in;
+    if (index >= pdata->integration_size) {
+        int size = pdata->integration_size ? pdata->integration_size : 256;
+        while (size <= index)
+            size *= 2;
+        double *times = realloc(pdata->integration_times, size * sizeof(*times));
+        if (!times)
+            return pdata->integration_count ? pdata->integration_times[pdata->integration_count - 1]
+                                            : 0.0;
+        pdata->integration_times = times;
+        pdata->integration_size = size;
+    }
+    if (pdata->integration_count == 0) {
+        pdata->integration_times[0] = 0.0;
+        pdata->integration_count = 1;
+    }
+    for (int i = pdata->integration_count; i <= index; i++) {
+        double speed = mlt_properties_anim_get_double(properties, "speed_map", i - 1, length);
+        pdata->integration_times[i] = pdata->integration_times[i - 1] + speed / link_fps;
     }
+    if (index >= pdata->integration_count)
+        pdata->integration_count = index + 1;
 
-    // Remember the integration results so that the next frame can start
-    // integration from this position instead of from the beginning.
-    pdata->prev_integration_position = position;
-    pdata->prev_integration_time = source_time;
-    return source_time;
+    return pdata->integration_times[index];
 }
 
 static void link_configure(mlt_link self, mlt_profile chain_profile)
@@ -661,6 +680,7 @@ static void link_close(mlt_link self)
             mlt_frame_close(pdata->prev_frame);
             mlt_filter_close(pdata->resample_filter);
             mlt_filter_close(pdata->pitch_filter);
+            free(pdata->integration_times);
             free(pdata);
         }
         self->close = NULL;
@@ -21,6 +21,7 @@
 #include <ctype.h>
 #include <fnmatch.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +30,8 @@
 
 static mlt_properties dictionary = NULL;
 static mlt_properties normalizers = NULL;
+// Loaders may run on several threads, for example when producer_xml probes in parallel.
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static mlt_producer create_from(mlt_profile profile, char *file, char *services)
 {
@@ -84,12 +87,14 @@ static mlt_producer create_producer(mlt_profile profile, char *file)
         mlt_profile backup_profile = mlt_profile_clone(profile);
 
         // We only need to load the dictionary once
+        pthread_mutex_lock(&load_mutex);
         if (dictionary == NULL) {
             char temp[PATH_MAX];
             snprintf(temp, sizeof(temp), "%s/core/loader.dict", mlt_environment("MLT_DATA"));
             dictionary = mlt_properties_load(temp);
             mlt_factory_register_for_clean_up(dictionary, (mlt_destructor) mlt_properties_close);
         }
+        pthread_mutex_unlock(&load_mutex);
 
         // Convert the lookup string to lower case
         while (*p) {
@@ -204,12 +209,14 @@ static void attach_normalizers(mlt_profile profile, mlt_producer producer, int n
     mlt_tokeniser tokeniser = mlt_tokeniser_init();
 
     // We only need to load the normalizing properties once
+    pthread_mutex_lock(&load_mutex);
     if (normalizers == NULL) {
         char temp[PATH_MAX];
         snprintf(temp, sizeof(temp), "%s/core/loader.ini", mlt_environment("MLT_DATA"));
         normalizers = mlt_properties_load(temp);
         mlt_factory_register_for_clean_up(normalizers, (mlt_destructor) mlt_properties_close);
     }
+    pthread_mutex_unlock(&load_mutex);
 
     // Apply normalizers
     for (i = 0; i < mlt_properties_count(normalizers); i++) {
@@ -710,6 +710,7 @@ static uint16_t *get_luma(mlt_transition self, mlt_properties properties, int wi
 */
 
 static int get_b_frame_image(mlt_transition self,
+                             mlt_properties properties,
                              mlt_frame b_frame,
                              uint8_t **image,
                              int *width,
@@ -721,7 +722,6 @@ static int get_b_frame_image(mlt_transition self,
 
     // Get the properties objects
     mlt_properties b_props = MLT_FRAME_PROPERTIES(b_frame);
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(self);
     uint8_t resize_alpha = mlt_properties_get_int(b_props, "resize_alpha");
     double output_ar = mlt_profile_sar(mlt_service_profile(MLT_TRANSITION_SERVICE(self)));
 
@@ -840,11 +840,11 @@ static int get_b_frame_image(mlt_transition self,
     return !error && image;
 }
 
-static void crop_calculate(mlt_transition self, struct geometry_s *result, double position)
+static void crop_calculate(mlt_transition self,
+                           mlt_properties properties,
+                           struct geometry_s *result,
+                           double position)
 {
-    // Get the properties from the transition
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(self);
-
     // Initialize panning info
     result->x_src = 0;
     result->y_src = 0;
@@ -885,11 +885,11 @@ static void crop_calculate(mlt_transition self, struct geometry_s *result, doubl
     }
 }
 
-static void composite_calculate(mlt_transition self, struct geometry_s *result, double position)
+static void composite_calculate(mlt_transition self,
+                                mlt_properties properties,
+                                struct geometry_s *result,
+                                double position)
 {
-    // Get the properties from the transition
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(self);
-
     // Obtain the normalized width and height from the a_frame
     mlt_profile profile = mlt_service_profile(MLT_TRANSITION_SERVICE(self));
     int normalized_width = profile->width;
@@ -937,7 +937,7 @@ static void composite_calculate(mlt_transition self, struct geometry_s *result,
     result->halign = alignment_parse(mlt_properties_get(properties, "halign"));
     result->valign = alignment_parse(mlt_properties_get(properties, "valign"));
 
-    crop_calculate(self, result, position);
+    crop_calculate(self, properties, result, position);
 }
 
 /** Get the image.
@@ -961,15 +961,16 @@ static int transition_get_image(mlt_frame a_frame,
     int out = mlt_frame_pop_service_int(a_frame);
     int in = mlt_frame_pop_service_int(a_frame);
 
-    // Get the properties from the transition
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(self);
+    // Get the parameters from the snapshot of the transition
+    mlt_properties properties = mlt_service_get_snapshot(MLT_TRANSITION_SERVICE(self), a_frame);
 
     // TODO: clean up always_active behaviour
     if (mlt_properties_get_int(properties, "always_active")) {
-        mlt_events_block(properties, properties);
-        mlt_properties_set_int(properties, "in", in);
-        mlt_properties_set_int(properties, "out", out);
-        mlt_events_unblock(properties, properties);
+        mlt_properties transition_props = MLT_TRANSITION_PROPERTIES(self);
+        mlt_events_block(transition_props, transition_props);
+        mlt_properties_set_int(transition_props, "in", in);
+        mlt_properties_set_int(transition_props, "out", out);
+        mlt_events_unblock(transition_props, transition_props);
     }
 
     if (mlt_properties_get_int(properties, "invert")) {
@@ -1006,10 +1007,7 @@ static int transition_get_image(mlt_frame a_frame,
         uint8_t *alpha_b = NULL;
 
         // Do the calculation
-        // NB: Locks needed here since the properties are being modified
-        mlt_service_lock(MLT_TRANSITION_SERVICE(self));
-        composite_calculate(self, &result, position);
-        mlt_service_unlock(MLT_TRANSITION_SERVICE(self));
+        composite_calculate(self, properties, &result, position);
 
         // Manual option to deinterlace
         if (mlt_properties_get_int(properties, "deinterlace")) {
@@ -1029,7 +1027,7 @@ static int transition_get_image(mlt_frame a_frame,
 
         if (a_frame == b_frame) {
             double aspect_ratio = mlt_frame_get_aspect_ratio(b_frame);
-            get_b_frame_image(self, b_frame, &image_b, &width_b, &height_b, &result);
+            get_b_frame_image(self, properties, b_frame, &image_b, &width_b, &height_b, &result);
             alpha_b = mlt_frame_get_alpha(b_frame);
             mlt_properties_set_double(a_props, "aspect_ratio", aspect_ratio);
         }
@@ -1067,7 +1065,13 @@ static int transition_get_image(mlt_frame a_frame,
 
         if (*image != image_b
             && (image_b
-                || get_b_frame_image(self, b_frame, &image_b, &width_b, &height_b, &result))) {
+                || get_b_frame_image(self,
+                                     properties,
+                                     b_frame,
+                                     &image_b,
+                                     &width_b,
+                                     &height_b,
+                                     &result))) {
             int progressive = mlt_properties_get_int(a_props, "consumer.progressive")
                               || mlt_properties_get_int(properties, "progressive");
             int top_field_first = mlt_properties_get_int(a_props, "top_field_first");
@@ -1075,8 +1079,12 @@ static int transition_get_image(mlt_frame a_frame,
             int sliced = mlt_properties_get_int(properties, "sliced_composite");
 
             double luma_softness = mlt_properties_get_double(properties, "softness");
+            // The luma map is cached on the transition
             mlt_service_lock(MLT_TRANSITION_SERVICE(self));
-            uint16_t *luma_bitmap = get_luma(self, properties, width_b, height_b);
+            uint16_t *luma_bitmap = get_luma(self,
+                                             MLT_TRANSITION_PROPERTIES(self),
+                                             width_b,
+                                             height_b);
             mlt_service_unlock(MLT_TRANSITION_SERVICE(self));
             char *operator= mlt_properties_get(properties, "operator");
 
@@ -1107,10 +1115,7 @@ static int transition_get_image(mlt_frame a_frame,
                 int field_id = progressive ? -1 : (top_field_first ? (1 - field) : field);
 
                 // Do the calculation if we need to
-                // NB: Locks needed here since the properties are being modified
-                mlt_service_lock(MLT_TRANSITION_SERVICE(self));
-                composite_calculate(self, &result, field_position);
-                mlt_service_unlock(MLT_TRANSITION_SERVICE(self));
+                composite_calculate(self, properties, &result, field_position);
 
                 if (mlt_properties_get_int(properties, "titles")) {
                     result.item.w = rint(*width * (result.item.w / result.nw));
@@ -1172,6 +1177,8 @@ static int transition_get_image(mlt_frame a_frame,
 
 static mlt_frame composite_process(mlt_transition self, mlt_frame a_frame, mlt_frame b_frame)
 {
+    mlt_service_snapshot(MLT_TRANSITION_SERVICE(self), a_frame);
+
     // UGH - this is a TODO - find a more reliable means of obtaining in/out for the always_active case
     if (mlt_properties_get_int(MLT_TRANSITION_PROPERTIES(self), "always_active") == 0) {
         mlt_frame_push_service_int(a_frame,
@@ -387,6 +387,9 @@ static int transition_get_image(mlt_frame a_frame,
     // Get the properties of the transition
     mlt_properties properties = MLT_TRANSITION_PROPERTIES(transition);
 
+    // Get the parameters of the transition for this frame
+    mlt_properties params = mlt_service_get_snapshot(MLT_TRANSITION_SERVICE(transition), a_frame);
+
     // Get the properties of the a frame
     mlt_properties a_props = MLT_FRAME_PROPERTIES(a_frame);
 
@@ -573,22 +576,22 @@ static int transition_get_image(mlt_frame a_frame,
     // Arbitrary composite defaults
     float mix = mlt_transition_get_progress(transition, a_frame);
     float frame_delta = mlt_transition_get_progress_delta(transition, a_frame);
-    float luma_softness = mlt_properties_get_double(properties, "softness");
+    float luma_softness = mlt_properties_get_double(params, "softness");
     int progressive = mlt_properties_get_int(a_props, "consumer.progressive")
-                      || mlt_properties_get_int(properties, "progressive")
+                      || mlt_properties_get_int(params, "progressive")
                       || mlt_properties_get_int(b_props, "luma.progressive");
     int top_field_first = mlt_properties_get_int(b_props, "top_field_first");
-    int reverse = mlt_properties_get_int(properties, "reverse");
-    int invert = mlt_properties_get_int(properties, "invert");
-    int threads = CLAMP(mlt_properties_get_int(properties, "threads"), 0, mlt_slices_count_normal());
-    int alpha_over = mlt_properties_get_int(properties, "alpha_over");
+    int reverse = mlt_properties_get_int(params, "reverse");
+    int invert = mlt_properties_get_int(params, "invert");
+    int threads = CLAMP(mlt_properties_get_int(params, "threads"), 0, mlt_slices_count_normal());
+    int alpha_over = mlt_properties_get_int(params, "alpha_over");
 
     // Honour the reverse here
     if (mix >= 1.0)
         mix -= floor(mix);
 
-    if (mlt_properties_get(properties, "fixed"))
-        mix = mlt_properties_get_double(properties, "fixed");
+    if (mlt_properties_get(params, "fixed"))
+        mix = mlt_properties_get_double(params, "fixed");
 
     if (producer) {
         invert = !invert;
@@ -597,7 +600,7 @@ static int transition_get_image(mlt_frame a_frame,
         mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
     }
 
-    int fix_background_alpha = mlt_properties_get_int(properties, "fix_background_alpha");
+    int fix_background_alpha = mlt_properties_get_int(params, "fix_background_alpha");
     if (luma_width > 0 && luma_height > 0 && luma_bitmap != NULL) {
         reverse = invert ? !reverse : reverse;
         mix = reverse ? 1 - mix : mix;
@@ -646,6 +649,9 @@ static int transition_get_image(mlt_frame a_frame,
 
 static mlt_frame transition_process(mlt_transition transition, mlt_frame a_frame, mlt_frame b_frame)
 {
+    // Take the parameters for this frame
+    mlt_service_snapshot(MLT_TRANSITION_SERVICE(transition), a_frame);
+
     // Push the transition on to the frame
     mlt_frame_push_service(a_frame, transition);
 
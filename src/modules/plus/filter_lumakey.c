@@ -73,7 +73,7 @@ static int filter_get_image(mlt_frame frame,
     mlt_position length = mlt_filter_get_length2(filter, frame);
 
     *format = mlt_image_rgba;
-    int error = mlt_frame_get_image(frame, image, format, width, height, 0);
+    int error = mlt_frame_get_image(frame, image, format, width, height, 1);
 
     // Only process if we have no error and a valid colour space
     if (error == 0) {
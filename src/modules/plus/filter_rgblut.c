@@ -66,7 +66,7 @@ static int filter_get_image(mlt_frame frame,
     mlt_filter filter = mlt_frame_pop_service(frame);
 
     *format = mlt_image_rgb;
-    int error = mlt_frame_get_image(frame, image, format, width, height, 0);
+    int error = mlt_frame_get_image(frame, image, format, width, height, 1);
 
     // Only process if we have no error and a valid colour space
     if (error == 0) {
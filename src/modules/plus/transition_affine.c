@@ -266,13 +266,12 @@ static void affine_max_output(
 #define IN_RANGE(v, r) (v >= -r / 2 && v < r / 2)
 
 static inline void get_affine(affine_t *affine,
-                              mlt_transition transition,
+                              mlt_properties properties,
                               double position,
                               int length,
                               double scale_width,
                               double scale_height)
 {
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(transition);
     int keyed = mlt_properties_get_int(properties, "keyed");
 
     if (keyed == 0) {
@@ -385,8 +384,9 @@ static int transition_get_image(mlt_frame a_frame,
     // Get the transition object
     mlt_transition transition = mlt_frame_pop_service(a_frame);
 
-    // Get the properties of the transition
-    mlt_properties properties = MLT_TRANSITION_PROPERTIES(transition);
+    // Get the parameters of the transition for this frame
+    mlt_properties properties = mlt_service_get_snapshot(MLT_TRANSITION_SERVICE(transition),
+                                                         a_frame);
 
     // Get the properties of the a frame
     mlt_properties a_props = MLT_FRAME_PROPERTIES(a_frame);
@@ -443,8 +443,6 @@ static int transition_get_image(mlt_frame a_frame,
     double scale_height = mlt_profile_scale_height(profile, *height);
     mlt_rect result = {0, 0, normalized_width, normalized_height, 1.0};
 
-    mlt_service_lock(MLT_TRANSITION_SERVICE(transition));
-
     if (mlt_properties_get(properties, "rect")) {
         // Determine length and obtain cycle
         double cycle = mlt_properties_get_double(properties, "cycle");
@@ -469,8 +467,6 @@ static int transition_get_image(mlt_frame a_frame,
 
     int threads = mlt_properties_get_int(properties, "threads");
     threads = CLAMP(threads, 0, mlt_slices_count_normal());
-    if (threads == 1)
-        mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
 
     result.x *= scale_width;
     result.y *= scale_height;
@@ -559,8 +555,6 @@ static int transition_get_image(mlt_frame a_frame,
     if (error || !b_image) {
         // Remove potentially large image on the B frame.
         mlt_frame_set_image(b_frame, NULL, 0, NULL);
-        if (threads != 1)
-            mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
         return error;
     }
 
@@ -604,13 +598,10 @@ static int transition_get_image(mlt_frame a_frame,
         affine_init(desc.affine.matrix);
 
         // Compute the affine transform
-        get_affine(&desc.affine, transition, (double) position, length, scale_width, scale_height);
+        get_affine(&desc.affine, properties, (double) position, length, scale_width, scale_height);
         desc.dz = MapZ(desc.affine.matrix, 0, 0);
-        if ((int) fabs(desc.dz * 1000) < 25) {
-            if (threads != 1)
-                mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
+        if ((int) fabs(desc.dz * 1000) < 25)
             return 0;
-        }
 
         if (mlt_properties_get_int(properties, "invert_scale")) {
             scale_x = 1.0 / scale_x;
@@ -680,8 +671,6 @@ static int transition_get_image(mlt_frame a_frame,
         // Remove potentially large image on the B frame.
         mlt_frame_set_image(b_frame, NULL, 0, NULL);
     }
-    if (threads != 1)
-        mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
     return 0;
 }
 
@@ -690,6 +679,9 @@ static int transition_get_image(mlt_frame a_frame,
 
 static mlt_frame transition_process(mlt_transition transition, mlt_frame a_frame, mlt_frame b_frame)
 {
+    // Take the parameters for this frame
+    mlt_service_snapshot(MLT_TRANSITION_SERVICE(transition), a_frame);
+
     // Push the transition on to the frame
     mlt_frame_push_service(a_frame, transition);
 
@@ -20,6 +20,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+#define _GNU_SOURCE
 #ifdef _WIN32
 #include <winsock2.h>
 #else
@@ -46,6 +47,10 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#include <sys/uio.h>
+#endif
 #endif
 #endif
 #include <sys/time.h>
@@ -65,6 +70,10 @@
 #define REMUX_BUFFER_MAX (50)
 #define UDP_BUFFER_MINIMUM (100)
 #define UDP_BUFFER_DEFAULT (1000)
+#define UDP_BURST_DEFAULT (8)
+#define UDP_BURST_MAX (32)
+#define UDP_STATS_PERIOD_NS (1000000000ULL)
+#define PCR_WRAP ((1ULL << 33) * 300)
 #define RTP_VERSION (2)
 #define RTP_PAYLOAD (33)
 #define RTP_HZ (90000)
@@ -76,6 +85,24 @@
 
 typedef struct consumer_cbrts_s *consumer_cbrts;
 
+typedef struct
+{
+    uint64_t start;
+    uint64_t datagrams;
+    uint64_t batches;
+    uint64_t late;
+    unsigned period_datagrams;
+    uint64_t jitter_sum;
+    uint64_t jitter_max;
+    int has_pcr;
+    uint64_t pcr;
+    uint64_t pcr_time;
+    unsigned pcr_count;
+    int64_t pcr_offset;
+    int64_t pcr_offset_min;
+    int64_t pcr_offset_max;
+} udp_stats;
+
 struct consumer_cbrts_s
 {
     struct mlt_consumer_s parent;
@@ -104,10 +131,13 @@ struct consumer_cbrts_s
     uint64_t output_counter;
 #ifdef CBRTS_BSD_SOCKETS
     struct addrinfo *addr;
-    struct timespec timer;
+    uint64_t timer;
     uint32_t nsec_per_packet;
     uint32_t femto_per_packet;
     uint64_t femto_counter;
+    int udp_burst;
+    int udp_gso;
+    udp_stats stats;
 #endif
     int (*write_tsp)(consumer_cbrts, const void *buf, size_t count);
     uint8_t udp_packet[UDP_MTU];
@@ -444,7 +474,7 @@ static int writen(consumer_cbrts self, const void *buf, size_t count)
     return result;
 }
 
-#ifdef CBRTS_BSD_SOCKETS
+#if defined(CBRTS_BSD_SOCKETS) && !defined(__linux__)
 static int sendn(consumer_cbrts self, const void *buf, size_t count)
 {
     int result = 0;
@@ -471,21 +501,216 @@ static int sendn(consumer_cbrts self, const void *buf, size_t count)
 }
 #endif
 
-static int write_udp(consumer_cbrts self, const void *buf, size_t count)
+#ifdef CBRTS_BSD_SOCKETS
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void advance_timer(consumer_cbrts self, int count)
+{
+    while (count--) {
+        self->femto_counter += self->femto_per_packet;
+        self->timer += self->nsec_per_packet + self->femto_counter / 1000000;
+        self->femto_counter = self->femto_counter % 1000000;
+    }
+}
+
+static int send_udp(consumer_cbrts self, uint8_t **packets, int count, size_t size)
+{
+    int result = 0;
+
+#ifdef __linux__
+    struct iovec iov[UDP_BURST_MAX];
+    struct mmsghdr messages[UDP_BURST_MAX];
+    int i, sent = 0;
+
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = packets[i];
+        iov[i].iov_len = size;
+    }
+
+#ifdef UDP_SEGMENT
+    // With segmentation offload, the kernel splits one send into the datagrams.
+    if (self->udp_gso && count > 1) {
+        struct msghdr message = {0};
+        message.msg_name = self->addr->ai_addr;
+        message.msg_namelen = self->addr->ai_addrlen;
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        if ((result = sendmsg(self->fd, &message, 0)) >= 0)
+            return result;
+        if (errno != EIO && errno != EINVAL) {
+            mlt_log_error(MLT_CONSUMER_SERVICE(&self->parent),
+                          "Failed to send: %s\n",
+                          strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        // The network device can not do it after all.
+        mlt_log_verbose(MLT_CONSUMER_SERVICE(&self->parent),
+                        "UDP segmentation offload failed: %s\n",
+                        strerror(errno));
+        int segment = 0;
+        setsockopt(self->fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment));
+        self->udp_gso = 0;
+    }
+#endif
+
+    memset(messages, 0, count * sizeof(*messages));
+    for (i = 0; i < count; i++) {
+        messages[i].msg_hdr.msg_name = self->addr->ai_addr;
+        messages[i].msg_hdr.msg_namelen = self->addr->ai_addrlen;
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (sent < count) {
+        result = sendmmsg(self->fd, &messages[sent], count - sent, 0);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            mlt_log_error(MLT_CONSUMER_SERVICE(&self->parent),
+                          "Failed to send: %s\n",
+                          strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        sent += result;
+    }
+#else
+    int i;
+    for (i = 0; i < count && result >= 0; i++)
+        result = sendn(self, packets[i], size);
+#endif
+
+    return result;
+}
+
+static void update_pcr_stats(consumer_cbrts self, uint64_t pcr, uint64_t now)
+{
+    udp_stats *stats = &self->stats;
+
+    if (stats->has_pcr) {
+        // The time elapsed according to the PCR versus the time it took to send it
+        uint64_t elapsed = (pcr + PCR_WRAP - stats->pcr) % PCR_WRAP * 1000 / 27;
+        int64_t offset = (int64_t) (now - stats->pcr_time) - (int64_t) elapsed;
+
+        // Follow a discontinuity
+        if (offset > 1000000000LL || offset < -1000000000LL)
+            stats->has_pcr = 0;
+        else
+            stats->pcr_offset = offset;
+    }
+    if (!stats->has_pcr) {
+        stats->has_pcr = 1;
+        stats->pcr = pcr;
+        stats->pcr_time = now;
+        stats->pcr_offset = 0;
+    }
+    if (!stats->pcr_count++) {
+        stats->pcr_offset_min = stats->pcr_offset;
+        stats->pcr_offset_max = stats->pcr_offset;
+    } else if (stats->pcr_offset < stats->pcr_offset_min) {
+        stats->pcr_offset_min = stats->pcr_offset;
+    } else if (stats->pcr_offset > stats->pcr_offset_max) {
+        stats->pcr_offset_max = stats->pcr_offset;
+    }
+}
+
+static void update_udp_stats(consumer_cbrts self, uint8_t **packets, int count, uint64_t now)
+{
+    udp_stats *stats = &self->stats;
+    size_t offset = self->rtp_ssrc ? RTP_BYTES : 0;
+    uint64_t due = self->timer;
+    int i;
+    size_t j;
+
+    for (i = 0; i < count; i++, due += self->nsec_per_packet) {
+        // Measure how far from its due time each datagram was sent
+        uint64_t jitter = now > due ? now - due : due - now;
+        stats->jitter_sum += jitter;
+        if (jitter > stats->jitter_max)
+            stats->jitter_max = jitter;
+
+        for (j = 0; j < self->udp_packet_size; j += TSP_BYTES) {
+            uint8_t *packet = packets[i] + offset + j;
+            if (HASPCR(packet))
+                update_pcr_stats(self, get_pcr(packet), now);
+        }
+    }
+    stats->datagrams += count;
+    stats->period_datagrams += count;
+    stats->batches++;
+
+    if (!stats->start) {
+        stats->start = now;
+    } else if (now - stats->start >= UDP_STATS_PERIOD_NS) {
+        mlt_properties properties = MLT_CONSUMER_PROPERTIES(&self->parent);
+        double jitter_mean = (double) stats->jitter_sum / stats->period_datagrams / 1000.0;
+        double pcr_jitter = (double) (stats->pcr_offset_max - stats->pcr_offset_min) / 1000.0;
+
+        mlt_properties_set_int64(properties, "udp.stats.datagrams", stats->datagrams);
+        mlt_properties_set_int64(properties, "udp.stats.batches", stats->batches);
+        mlt_properties_set_int64(properties, "udp.stats.late", stats->late);
+        mlt_properties_set_double(properties, "udp.stats.jitter", stats->jitter_max / 1000.0);
+        mlt_properties_set_double(properties, "udp.stats.jitter_mean", jitter_mean);
+        if (stats->pcr_count) {
+            mlt_properties_set_double(properties, "udp.stats.pcr_jitter", pcr_jitter);
+            mlt_properties_set_double(properties,
+                                      "udp.stats.pcr_offset",
+                                      stats->pcr_offset / 1000.0);
+        }
+        mlt_log_verbose(MLT_CONSUMER_SERVICE(&self->parent),
+                        "UDP datagrams %" PRIu64 " batches %" PRIu64 " late %" PRIu64
+                        " jitter %.1f us (mean %.1f us) PCR jitter %.1f us offset %.1f us\n",
+                        stats->datagrams,
+                        stats->batches,
+                        stats->late,
+                        stats->jitter_max / 1000.0,
+                        jitter_mean,
+                        pcr_jitter,
+                        stats->pcr_offset / 1000.0);
+
+        stats->start = now;
+        stats->period_datagrams = 0;
+        stats->jitter_sum = 0;
+        stats->jitter_max = 0;
+        stats->pcr_count = 0;
+    }
+}
+#endif
+
+static int write_udp(consumer_cbrts self, uint8_t **packets, int count)
 {
     int result = 0;
 
 #ifdef CBRTS_BSD_SOCKETS
-    if (!self->timer.tv_sec)
-        clock_gettime(CLOCK_MONOTONIC, &self->timer);
-    self->femto_counter += self->femto_per_packet;
-    self->timer.tv_nsec += self->femto_counter / 1000000;
-    self->femto_counter = self->femto_counter % 1000000;
-    self->timer.tv_nsec += self->nsec_per_packet;
-    self->timer.tv_sec += self->timer.tv_nsec / 1000000000;
-    self->timer.tv_nsec = self->timer.tv_nsec % 1000000000;
-    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &self->timer, NULL);
-    result = sendn(self, buf, count);
+    size_t size = self->rtp_ssrc ? RTP_BYTES + self->udp_packet_size : self->udp_packet_size;
+    uint64_t depth = (uint64_t) self->udp_burst * self->nsec_per_packet;
+    uint64_t now = monotonic_ns();
+
+    // The timer is when the next datagram is due, so the time since then is the
+    // tokens in the bucket. The bucket only holds one burst; when the output is
+    // further behind, the rest is forfeit instead of sent at once.
+    if (!self->timer)
+        self->timer = now;
+    if (now > self->timer + depth) {
+        if (self->nsec_per_packet)
+            self->stats.late += (now - self->timer - depth) / self->nsec_per_packet;
+        self->timer = now - depth;
+    }
+
+    // Wait for the tokens of the whole batch.
+    uint64_t due = self->timer + (uint64_t) (count - 1) * self->nsec_per_packet;
+    if (due > now) {
+        struct timespec timer;
+        timer.tv_sec = due / 1000000000ULL;
+        timer.tv_nsec = due % 1000000000ULL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &timer, NULL);
+    }
+    result = send_udp(self, packets, count, size);
+    update_udp_stats(self, packets, count, monotonic_ns());
+    advance_timer(self, count);
 #endif
 
     return result;
@@ -618,28 +843,35 @@ static int create_socket(consumer_cbrts self)
 static void *output_thread(void *arg)
 {
     consumer_cbrts self = arg;
+    uint8_t *packets[UDP_BURST_MAX];
     int result = 0;
 
-    while (self->thread_running) {
+    while (self->thread_running && result >= 0) {
         pthread_mutex_lock(&self->udp_deque_mutex);
         while (self->thread_running && mlt_deque_count(self->udp_packets) < 1)
             pthread_cond_wait(&self->udp_deque_cond, &self->udp_deque_mutex);
+        int count = mlt_deque_count(self->udp_packets);
         pthread_mutex_unlock(&self->udp_deque_mutex);
+        if (!self->thread_running)
+            break;
 
-        // Dequeue the UDP packets and write them.
-        int i = mlt_deque_count(self->udp_packets);
-        mlt_log_debug(MLT_CONSUMER_SERVICE(&self->parent), "%s: count %d\n", __FUNCTION__, i);
-        while (self->thread_running && i-- && result >= 0) {
-            pthread_mutex_lock(&self->udp_deque_mutex);
-            uint8_t *packet = mlt_deque_pop_front(self->udp_packets);
-            pthread_cond_broadcast(&self->udp_deque_cond);
-            pthread_mutex_unlock(&self->udp_deque_mutex);
-
-            size_t size = self->rtp_ssrc ? RTP_BYTES + self->udp_packet_size
-                                         : self->udp_packet_size;
-            result = write_udp(self, packet, size);
-            free(packet);
-        }
+        // Send up to a burst of the UDP packets at once.
+        int i;
+#ifdef CBRTS_BSD_SOCKETS
+        count = MIN(count, self->udp_burst);
+#else
+        count = 1;
+#endif
+        mlt_log_debug(MLT_CONSUMER_SERVICE(&self->parent), "%s: count %d\n", __FUNCTION__, count);
+        pthread_mutex_lock(&self->udp_deque_mutex);
+        for (i = 0; i < count; i++)
+            packets[i] = mlt_deque_pop_front(self->udp_packets);
+        pthread_cond_broadcast(&self->udp_deque_cond);
+        pthread_mutex_unlock(&self->udp_deque_mutex);
+
+        result = write_udp(self, packets, count);
+        for (i = 0; i < count; i++)
+            free(packets[i]);
     }
     return NULL;
 }
@@ -1104,6 +1336,26 @@ static int consumer_start(mlt_consumer parent)
                 self->femto_per_packet = 1000000000000000ULL * self->udp_packet_size * 8
                                              / self->muxrate
                                          - self->nsec_per_packet * 1000000;
+                self->femto_counter = 0;
+                self->timer = 0;
+                memset(&self->stats, 0, sizeof(self->stats));
+
+                self->udp_burst = UDP_BURST_DEFAULT;
+                if (mlt_properties_get(properties, "udp.burst"))
+                    self->udp_burst = CLAMP(mlt_properties_get_int(properties, "udp.burst"),
+                                            1,
+                                            UDP_BURST_MAX);
+                self->udp_gso = 0;
+#ifdef UDP_SEGMENT
+                // Let the kernel split a burst into datagrams if it can.
+                if (self->udp_burst > 1
+                    && (mlt_properties_get_int(properties, "udp.gso")
+                        || !mlt_properties_get(properties, "udp.gso"))) {
+                    int segment = (self->rtp_ssrc ? RTP_BYTES : 0) + self->udp_packet_size;
+                    self->udp_gso
+                        = !setsockopt(self->fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment));
+                }
+#endif
 #endif
                 self->udp_buffer_max = mlt_properties_get_int(properties, "udp.buffer");
                 if (self->udp_buffer_max < UDP_BUFFER_MINIMUM)
@@ -18,6 +18,7 @@
  */
 
 #include "common.h"
+#include "text_layout.h"
 #include <framework/mlt.h>
 #include <framework/mlt_log.h>
 #include <QFile>
@@ -38,21 +39,14 @@ static QMutex g_mutex;
 static QRectF get_text_path(QPainterPath *qpath,
                             mlt_properties filter_properties,
                             const char *text,
-                            double scale)
+                            double scale,
+                            bool *cached)
 {
     int outline = mlt_properties_get_int(filter_properties, "outline") * scale;
     char halign = mlt_properties_get(filter_properties, "halign")[0];
     char style = mlt_properties_get(filter_properties, "style")[0];
     int pad = mlt_properties_get_int(filter_properties, "pad") * scale;
     int offset = pad + (outline / 2);
-    int width = 0;
-    int height = 0;
-
-    qpath->setFillRule(Qt::WindingFill);
-
-    // Get the strings to display
-    QString s = QString::fromUtf8(text);
-    QStringList lines = s.split("\n");
 
     // Configure the font
     QFont font;
@@ -69,75 +63,8 @@ static QRectF get_text_path(QPainterPath *qpath,
         font.setStyle(QFont::StyleItalic);
         break;
     }
-    QFontMetrics fm(font);
-
-    // Determine the text rectangle size
-    height = fm.lineSpacing() * lines.size();
-    for (int i = 0; i < lines.size(); ++i) {
-        const QString line = lines[i];
-#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
-        int line_width = fm.horizontalAdvance(line);
-#else
-        int line_width = fm.width(line);
-#endif
-        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-        if (line_width > width)
-            width = line_width;
-    }
-
-    // Lay out the text in the path
-    int x = 0;
-    int y = fm.ascent() + offset;
-    for (int i = 0; i < lines.size(); ++i) {
-        QString line = lines.at(i);
-        x = offset;
-#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
-        int line_width = fm.horizontalAdvance(line);
-#else
-        int line_width = fm.width(line);
-#endif
-        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
-
-        if (bearing < 0) {
-            line_width -= bearing;
-            x -= bearing;
-        }
-        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-
-        switch (halign) {
-        default:
-        case 'l':
-        case 'L':
-            break;
-        case 'c':
-        case 'C':
-            x += (width - line_width) / 2;
-            break;
-        case 'r':
-        case 'R':
-            x += width - line_width;
-            break;
-        }
-        qpath->addText(x, y, font, line);
-        y += fm.lineSpacing();
-    }
-
-    // Account for outline and pad
-    width += offset * 2;
-    height += offset * 2;
-    // Sanity check
-    if (width == 0)
-        width = 1;
-    height += 2; // I found some fonts whose descenders get cut off.
 
-    return QRectF(0, 0, width, height);
+    return text_layout_path(qpath, QString::fromUtf8(text), font, halign, offset, cached);
 }
 
 static QColor get_qcolor(mlt_properties filter_properties,
@@ -401,7 +328,9 @@ static int filter_get_image(mlt_frame frame,
                 doc->drawContents(&painter, drawRect);
             }
         } else {
-            path_rect = get_text_path(&text_path, filter_properties, argument, scale);
+            bool cached = false;
+            path_rect = get_text_path(&text_path, filter_properties, argument, scale, &cached);
+            mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "_qtext.cached", cached);
             transform_painter(&painter, rect, path_rect, filter_properties, profile);
             paint_background(&painter, path_rect, filter_properties, position, length);
             paint_text(&painter, &text_path, filter_properties, position, length);
@@ -18,6 +18,7 @@
  */
 
 #include "common.h"
+#include "text_layout.h"
 #include <framework/mlt.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -155,19 +156,12 @@ static void generate_qpath(mlt_properties producer_properties)
     char *encoding = mlt_properties_get(producer_properties, "encoding");
     int pad = mlt_properties_get_int(producer_properties, "pad");
     int offset = pad + (outline / 2);
-    int width = 0;
-    int height = 0;
-
-    // Make the path empty
-    *qPath = QPainterPath();
-    qPath->setFillRule(Qt::WindingFill);
 
     // Get the strings to display
     QTextCodec *codec = QTextCodec::codecForName(encoding);
     QTextDecoder *decoder = codec->makeDecoder();
     QString s = decoder->toUnicode(text);
     delete decoder;
-    QStringList lines = s.split("\n");
 
     // Configure the font
     QFont font;
@@ -180,75 +174,11 @@ static void generate_qpath(mlt_properties producer_properties)
         font.setStyle(QFont::StyleItalic);
         break;
     }
-    QFontMetrics fm(font);
-
-    // Determine the text rectangle size
-    height = fm.lineSpacing() * lines.size();
-    for (int i = 0; i < lines.size(); ++i) {
-        const QString line = lines[i];
-#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
-        int line_width = fm.horizontalAdvance(line);
-#else
-        int line_width = fm.width(line);
-#endif
-        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-        if (line_width > width)
-            width = line_width;
-    }
 
     // Lay out the text in the path
-    int x = 0;
-    int y = fm.ascent() + offset;
-    for (int i = 0; i < lines.size(); ++i) {
-        QString line = lines.at(i);
-        x = offset;
-#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
-        int line_width = fm.horizontalAdvance(line);
-#else
-        int line_width = fm.width(line);
-#endif
-        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
-
-        if (bearing < 0) {
-            line_width -= bearing;
-            x -= bearing;
-        }
-        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
-        if (bearing < 0)
-            line_width -= bearing;
-
-        switch (align[0]) {
-        default:
-        case 'l':
-        case 'L':
-            break;
-        case 'c':
-        case 'C':
-            x += (width - line_width) / 2;
-            break;
-        case 'r':
-        case 'R':
-            x += width - line_width;
-            break;
-        }
-        qPath->addText(x, y, font, line);
-        y += fm.lineSpacing();
-    }
-
-    // Account for outline and pad
-    width += offset * 2;
-    height += offset * 2;
-    // Sanity check
-    if (width == 0)
-        width = 1;
-    height += 2; // I found some fonts whose descenders get cut off.
-    mlt_properties_set_int(producer_properties, "meta.media.width", width);
-    mlt_properties_set_int(producer_properties, "meta.media.height", height);
+    QRectF rect = text_layout_path(qPath, s, font, align[0], offset);
+    mlt_properties_set_int(producer_properties, "meta.media.width", rect.width());
+    mlt_properties_set_int(producer_properties, "meta.media.height", rect.height());
 }
 
 static bool check_qimage(mlt_properties frame_properties)
@@ -0,0 +1,160 @@
+/*
+ * text_layout.cpp -- cached layout of text in painter paths
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "text_layout.h"
+#include <QCache>
+#include <QFontMetrics>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+// The cost of a layout is the number of elements in its path.
+#define TEXT_LAYOUT_CACHE_COST (1 << 20)
+
+struct TextLayout
+{
+    QPainterPath path;
+    QRectF rect;
+};
+
+static QMutex g_cache_mutex;
+static QCache<QString, TextLayout> g_cache(TEXT_LAYOUT_CACHE_COST);
+
+static QRectF layout_text(
+    QPainterPath *qpath, const QString &text, const QFont &font, char halign, int offset)
+{
+    QStringList lines = text.split("\n");
+    QFontMetrics fm(font);
+    int width = 0;
+    int height = 0;
+
+    qpath->setFillRule(Qt::WindingFill);
+
+    // Determine the text rectangle size
+    height = fm.lineSpacing() * lines.size();
+    for (int i = 0; i < lines.size(); ++i) {
+        const QString line = lines[i];
+#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
+        int line_width = fm.horizontalAdvance(line);
+#else
+        int line_width = fm.width(line);
+#endif
+        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
+        if (bearing < 0)
+            line_width -= bearing;
+        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
+        if (bearing < 0)
+            line_width -= bearing;
+        if (line_width > width)
+            width = line_width;
+    }
+
+    // Lay out the text in the path
+    int x = 0;
+    int y = fm.ascent() + offset;
+    for (int i = 0; i < lines.size(); ++i) {
+        QString line = lines.at(i);
+        x = offset;
+#if (QT_VERSION > QT_VERSION_CHECK(5, 11, 0))
+        int line_width = fm.horizontalAdvance(line);
+#else
+        int line_width = fm.width(line);
+#endif
+        int bearing = (line.size() > 0) ? fm.leftBearing(line.at(0)) : 0;
+
+        if (bearing < 0) {
+            line_width -= bearing;
+            x -= bearing;
+        }
+        bearing = (line.size() > 0) ? fm.rightBearing(line.at(line.size() - 1)) : 0;
+        if (bearing < 0)
+            line_width -= bearing;
+
+        switch (halign) {
+        default:
+        case 'l':
+        case 'L':
+            break;
+        case 'c':
+        case 'C':
+            x += (width - line_width) / 2;
+            break;
+        case 'r':
+        case 'R':
+            x += width - line_width;
+            break;
+        }
+        qpath->addText(x, y, font, line);
+        y += fm.lineSpacing();
+    }
+
+    // Account for outline and pad
+    width += offset * 2;
+    height += offset * 2;
+    // Sanity check
+    if (width == 0)
+        width = 1;
+    height += 2; // I found some fonts whose descenders get cut off.
+
+    return QRectF(0, 0, width, height);
+}
+
+/** Lay out lines of text in a painter path.
+ *
+ * The layouts are cached by font, alignment, offset, and text, and shared by
+ * all frames and instances. The cache has its own lock.
+ *
+ * \param qpath the path to which the text is set
+ * \param text the lines of text
+ * \param font the font, including its size
+ * \param halign the horizontal alignment: 'l', 'c', or 'r'
+ * \param offset the padding around the text
+ * \param[out] cached if not null, set to whether the layout came from the cache
+ * \return the rectangle of the text including the padding
+ */
+
+QRectF text_layout_path(QPainterPath *qpath,
+                        const QString &text,
+                        const QFont &font,
+                        char halign,
+                        int offset,
+                        bool *cached)
+{
+    QString key = font.key() + QLatin1Char('\n') + QLatin1Char(halign) + QLatin1Char('\n')
+                  + QString::number(offset) + QLatin1Char('\n') + text;
+
+    QMutexLocker locker(&g_cache_mutex);
+    TextLayout *layout = g_cache.object(key);
+    if (cached)
+        *cached = layout != nullptr;
+    if (layout) {
+        *qpath = layout->path;
+        return layout->rect;
+    }
+    locker.unlock();
+
+    layout = new TextLayout;
+    layout->rect = layout_text(&layout->path, text, font, halign, offset);
+    *qpath = layout->path;
+    QRectF rect = layout->rect;
+
+    locker.relock();
+    g_cache.insert(key, layout, qMax(1, layout->path.elementCount()));
+    return rect;
+}
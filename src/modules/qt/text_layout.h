@@ -0,0 +1,35 @@
+/*
+ * text_layout.h -- cached layout of text in painter paths
+ * Copyright (c) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <QFont>
+#include <QPainterPath>
+#include <QRectF>
+#include <QString>
+
+QRectF text_layout_path(QPainterPath *qpath,
+                        const QString &text,
+                        const QFont &font,
+                        char halign,
+                        int offset,
+                        bool *cached = nullptr);
+
+#endif // TEXT_LAYOUT_H
@@ -25,6 +25,7 @@
 #include <ctype.h>
 #include <framework/mlt.h>
 #include <framework/mlt_log.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -64,6 +65,16 @@ enum service_type {
     mlt_link_type,
 };
 
+/** A producer created by a probe thread ahead of the second pass. */
+struct probe_job_s
+{
+    char *argument; // the argument to mlt_factory_producer
+    mlt_producer producer;
+    int started;
+    int done;
+    int taken; // whether the second pass took the producer
+};
+
 struct deserialise_context_s
 {
     mlt_deque stack_types;
@@ -90,6 +101,19 @@ struct deserialise_context_s
     int consumer_count;
     int seekable;
     mlt_consumer qglsl;
+    mlt_properties probe_item; // the producer element the first pass is reading
+    char *probe_property;      // the name of the probe_item property being read
+    int probe_depth;           // the element depth within probe_item
+    struct probe_job_s *probe_jobs;
+    int probe_count;
+    int probe_size;
+    int probe_next;  // the first job not started by a probe thread
+    int probe_first; // the first job not taken by the second pass
+    pthread_t *probe_threads;
+    int probe_thread_count;
+    pthread_mutex_t probe_mutex;
+    pthread_cond_t probe_cond;
+    mlt_profile probe_profile; // the profile the probed producers were created with
 };
 typedef struct deserialise_context_s *deserialise_context;
 
@@ -280,6 +304,217 @@ static inline void qualify_property(deserialise_context context,
     }
 }
 
+/** Queue the creation of a producer read by the first pass.
+ *
+ * Only avformat producers are created ahead, since opening and probing media
+ * is what makes loading large projects slow.
+ */
+
+static void probe_add_job(deserialise_context context, mlt_properties properties)
+{
+    qualify_property(context, properties, "resource");
+    char *resource = mlt_properties_get(properties, "resource");
+    char *service_name = trim(mlt_properties_get(properties, "mlt_service"));
+
+    if (resource == NULL) {
+        qualify_property(context, properties, "src");
+        resource = mlt_properties_get(properties, "src");
+    }
+    if (!resource || !service_name || strcmp(service_name, "avformat"))
+        return;
+
+    if (context->probe_count == context->probe_size) {
+        int size = context->probe_size ? context->probe_size * 2 : 64;
+        struct probe_job_s *jobs = realloc(context->probe_jobs, size * sizeof(*jobs));
+        if (!jobs)
+            return;
+        context->probe_jobs = jobs;
+        context->probe_size = size;
+    }
+    struct probe_job_s *job = &context->probe_jobs[context->probe_count];
+    memset(job, 0, sizeof(*job));
+    job->argument = malloc(strlen(service_name) + strlen(resource) + 2);
+    if (job->argument) {
+        sprintf(job->argument, "%s:%s", service_name, resource);
+        context->probe_count++;
+    }
+}
+
+/** Read the producers of the document in the first pass.
+*/
+
+static void probe_start_element(deserialise_context context,
+                                const xmlChar *name,
+                                const xmlChar **atts)
+{
+    if (context->probe_item) {
+        context->probe_depth++;
+        if (context->probe_depth == 1 && xmlStrcmp(name, _x("property")) == 0) {
+            for (; atts != NULL && *atts != NULL; atts += 2) {
+                if (xmlStrcmp(atts[0], _x("name")) == 0) {
+                    free(context->probe_property);
+                    context->probe_property = strdup(_s(atts[1]));
+                }
+            }
+            if (context->probe_property)
+                mlt_properties_set_string(context->probe_item, context->probe_property, "");
+        }
+    } else if (xmlStrcmp(name, _x("producer")) == 0 || xmlStrcmp(name, _x("video")) == 0
+               || xmlStrcmp(name, _x("chain")) == 0) {
+        context->probe_item = mlt_properties_new();
+        context->probe_depth = 0;
+        for (; atts != NULL && *atts != NULL; atts += 2)
+            mlt_properties_set_string(context->probe_item,
+                                      _s(atts[0]),
+                                      atts[1] == NULL ? "" : _s(atts[1]));
+    } else if (xmlStrcmp(name, _x("westley")) == 0 || xmlStrcmp(name, _x("mlt")) == 0) {
+        // The second pass qualifies resources with this root, too.
+        for (; atts != NULL && *atts != NULL; atts += 2) {
+            if (xmlStrcmp(atts[0], _x("root")) == 0)
+                mlt_properties_set_string(context->producer_map, "root", _s(atts[1]));
+        }
+    }
+}
+
+static void probe_end_element(deserialise_context context, const xmlChar *name)
+{
+    if (!context->probe_item)
+        return;
+    if (context->probe_depth == 0) {
+        probe_add_job(context, context->probe_item);
+        mlt_properties_close(context->probe_item);
+        context->probe_item = NULL;
+    } else {
+        if (context->probe_depth == 1 && context->probe_property) {
+            free(context->probe_property);
+            context->probe_property = NULL;
+        }
+        context->probe_depth--;
+    }
+}
+
+static void *probe_worker(void *arg)
+{
+    deserialise_context context = arg;
+
+    pthread_mutex_lock(&context->probe_mutex);
+    while (context->probe_next < context->probe_count) {
+        struct probe_job_s *job = &context->probe_jobs[context->probe_next++];
+        if (job->started)
+            continue;
+        job->started = 1;
+        pthread_mutex_unlock(&context->probe_mutex);
+
+        mlt_producer producer = mlt_factory_producer(context->probe_profile, NULL, job->argument);
+
+        pthread_mutex_lock(&context->probe_mutex);
+        job->producer = producer;
+        job->done = 1;
+        pthread_cond_broadcast(&context->probe_cond);
+    }
+    pthread_mutex_unlock(&context->probe_mutex);
+    return NULL;
+}
+
+/** Start creating the producers read by the first pass on probe threads.
+*/
+
+static void probe_start(deserialise_context context)
+{
+    int i, count = context->probe_thread_count;
+
+    context->probe_thread_count = 0;
+    if (count <= 0 || context->probe_count == 0)
+        return;
+    if (count > context->probe_count)
+        count = context->probe_count;
+    context->probe_threads = calloc(count, sizeof(pthread_t));
+    if (!context->probe_threads)
+        return;
+    pthread_mutex_init(&context->probe_mutex, NULL);
+    pthread_cond_init(&context->probe_cond, NULL);
+    context->probe_profile = context->profile;
+    for (i = 0; i < count; i++) {
+        if (pthread_create(&context->probe_threads[i], NULL, probe_worker, context))
+            break;
+        context->probe_thread_count++;
+    }
+    mlt_log_verbose(NULL,
+                    "[producer_xml] probing %d producers on %d threads\n",
+                    context->probe_count,
+                    context->probe_thread_count);
+}
+
+/** Wait for the probe threads and close the producers the second pass did not take.
+*/
+
+static void probe_stop(deserialise_context context)
+{
+    int i;
+
+    if (context->probe_threads) {
+        for (i = 0; i < context->probe_thread_count; i++)
+            pthread_join(context->probe_threads[i], NULL);
+        free(context->probe_threads);
+        context->probe_threads = NULL;
+        context->probe_thread_count = 0;
+        pthread_cond_destroy(&context->probe_cond);
+        pthread_mutex_destroy(&context->probe_mutex);
+    }
+    for (i = 0; i < context->probe_count; i++) {
+        mlt_producer_close(context->probe_jobs[i].producer);
+        free(context->probe_jobs[i].argument);
+    }
+    free(context->probe_jobs);
+    context->probe_jobs = NULL;
+    context->probe_count = 0;
+    mlt_properties_close(context->probe_item);
+    context->probe_item = NULL;
+    free(context->probe_property);
+    context->probe_property = NULL;
+}
+
+/** Create a producer, taking it from the probe threads when they created it.
+ *
+ * The probe threads create the producers in document order, so the one
+ * wanted is usually the first not taken.
+ */
+
+static mlt_producer create_producer(deserialise_context context, const char *argument)
+{
+    mlt_producer producer = NULL;
+    int i, found = 0;
+
+    if (!context->probe_threads || context->profile != context->probe_profile)
+        return mlt_factory_producer(context->profile, NULL, argument);
+
+    pthread_mutex_lock(&context->probe_mutex);
+    for (i = context->probe_first; i < context->probe_count; i++) {
+        struct probe_job_s *job = &context->probe_jobs[i];
+        if (!job->taken && !strcmp(job->argument, argument)) {
+            job->taken = 1;
+            found = 1;
+            if (job->started) {
+                while (!job->done)
+                    pthread_cond_wait(&context->probe_cond, &context->probe_mutex);
+                producer = job->producer;
+                job->producer = NULL;
+            } else {
+                // No probe thread got to it yet
+                job->started = 1;
+                found = 0;
+            }
+            break;
+        }
+    }
+    while (context->probe_first < context->probe_count
+           && context->probe_jobs[context->probe_first].taken)
+        context->probe_first++;
+    pthread_mutex_unlock(&context->probe_mutex);
+
+    return found ? producer : mlt_factory_producer(context->profile, NULL, argument);
+}
+
 /** This function adds a producer to a playlist or multitrack when
     there is no entry or track element.
 */
@@ -639,7 +874,7 @@ static void on_end_chain(deserialise_context context, const xmlChar *name)
                     strcat(temp, service_name);
                     strcat(temp, ":");
                     strcat(temp, resource);
-                    source = mlt_factory_producer(context->profile, NULL, temp);
+                    source = create_producer(context, temp);
                     free(temp);
                 }
             } else {
@@ -808,7 +1043,7 @@ static void on_end_producer(deserialise_context context, const xmlChar *name)
                     strcat(temp, service_name);
                     strcat(temp, ":");
                     strcat(temp, resource);
-                    producer = MLT_SERVICE(mlt_factory_producer(context->profile, NULL, temp));
+                    producer = MLT_SERVICE(create_producer(context, temp));
                     free(temp);
                 }
             } else {
@@ -1558,6 +1793,8 @@ static void on_start_element(void *ctx, const xmlChar *name, const xmlChar **att
             on_start_profile(context, name, atts);
         if (xmlStrcmp(name, _x("consumer")) == 0)
             context->multi_consumer++;
+        if (context->probe_thread_count > 0)
+            probe_start_element(context, name, atts);
 
         // Check for a service beginning with glsl. or movit.
         for (; atts != NULL && *atts != NULL; atts += 2) {
@@ -1633,6 +1870,10 @@ static void on_end_element(void *ctx, const xmlChar *name)
     struct _xmlParserCtxt *xmlcontext = (struct _xmlParserCtxt *) ctx;
     deserialise_context context = (deserialise_context) (xmlcontext->_private);
 
+    if (context->pass == 0) {
+        probe_end_element(context, name);
+        return;
+    }
     if (context->is_value == 1 && context->pass == 1 && xmlStrcmp(name, _x("property")) != 0)
         context_pop_node(context);
     else if (xmlStrcmp(name, _x("multitrack")) == 0)
@@ -1676,7 +1917,16 @@ static void on_characters(void *ctx, const xmlChar *ch, int len)
     value[len] = 0;
     strncpy(value, (const char *) ch, len);
 
-    if (mlt_deque_count(context->stack_node))
+    if (context->pass == 0) {
+        if (context->probe_property) {
+            char *s = mlt_properties_get(context->probe_item, context->probe_property);
+            char *new = calloc(1, strlen(s ? s : "") + len + 1);
+            strcat(new, s ? s : "");
+            strcat(new, value);
+            mlt_properties_set_string(context->probe_item, context->probe_property, new);
+            free(new);
+        }
+    } else if (mlt_deque_count(context->stack_node))
         xmlNodeAddContent(mlt_deque_peek_back(context->stack_node), (xmlChar *) value);
 
     // libxml2 generates an on_characters immediately after a get_entity within
@@ -1973,6 +2223,7 @@ static deserialise_context context_new(mlt_profile profile)
 
 static void context_close(deserialise_context context)
 {
+    probe_stop(context);
     mlt_properties_close(context->producer_map);
     mlt_properties_close(context->destructors);
     mlt_properties_close(context->params);
@@ -2055,9 +2306,16 @@ mlt_producer producer_xml_init(mlt_profile profile,
     // We need to track the number of registered filters
     mlt_properties_set_int(context->destructors, "registered", 0);
 
+    // Create avformat producers on threads while parsing, if requested
+    if (mlt_properties_get(context->params, "probe_threads"))
+        context->probe_thread_count = mlt_properties_get_int(context->params, "probe_threads");
+    else if (getenv("MLT_XML_PROBE_THREADS"))
+        context->probe_thread_count = atoi(getenv("MLT_XML_PROBE_THREADS"));
+
     // Setup SAX callbacks for first pass
     sax = calloc(1, sizeof(xmlSAXHandler));
     sax->startElement = on_start_element;
+    sax->endElement = on_end_element;
     sax->characters = on_characters;
     sax->warning = on_error;
     sax->error = on_error;
@@ -2103,6 +2361,7 @@ mlt_producer producer_xml_init(mlt_profile profile,
 
     // Setup the second pass
     context->pass++;
+    probe_start(context);
     if (is_filename)
         xmlcontext = xmlCreateFileParserCtxt(filename);
     else
@@ -2136,7 +2395,6 @@ mlt_producer producer_xml_init(mlt_profile profile,
         context->qglsl = mlt_factory_consumer(profile, "qglsl", NULL);
 
     // Setup SAX callbacks for second pass
-    sax->endElement = on_end_element;
     sax->cdataBlock = on_characters;
     sax->internalSubset = on_internal_subset;
     sax->entityDecl = on_entity_declaration;
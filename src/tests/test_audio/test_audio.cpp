@@ -51,6 +51,44 @@ private Q_SLOTS:
         free(data);
         a.set_data(nullptr);
     }
+
+    void FifoWrapsAround()
+    {
+        mlt_audio_fifo fifo = mlt_audio_fifo_new(8);
+        uint8_t in[6] = {1, 2, 3, 4, 5, 6};
+        uint8_t out[8] = {0};
+        QCOMPARE(mlt_audio_fifo_write(fifo, in, 6), 6);
+        QCOMPARE(mlt_audio_fifo_read(fifo, out, 4), 4);
+        QCOMPARE(out[3], uint8_t(4));
+        // This write wraps around the end of the buffer.
+        QCOMPARE(mlt_audio_fifo_write(fifo, in, 6), 6);
+        QCOMPARE(mlt_audio_fifo_used(fifo), 8);
+        QCOMPARE(mlt_audio_fifo_read(fifo, out, 8), 8);
+        uint8_t expected[8] = {5, 6, 1, 2, 3, 4, 5, 6};
+        QVERIFY(!memcmp(out, expected, 8));
+        QCOMPARE(mlt_audio_fifo_read(fifo, out, 8), 0);
+        mlt_audio_fifo_close(fifo);
+    }
+
+    void FifoGrowsKeepingOrder()
+    {
+        mlt_audio_fifo fifo = mlt_audio_fifo_new(0);
+        uint8_t in[100], out[100];
+        int next_in = 0, next_out = 0;
+        // Mix write and read sizes so that growth happens while wrapped.
+        for (int i = 0; i < 50; i++) {
+            for (int j = 0; j < 7 + i % 5; j++)
+                in[j] = uint8_t(next_in++);
+            mlt_audio_fifo_write(fifo, in, 7 + i % 5);
+            int n = mlt_audio_fifo_read(fifo, out, 5 + i % 3);
+            for (int j = 0; j < n; j++)
+                QCOMPARE(out[j], uint8_t(next_out++));
+        }
+        QCOMPARE(mlt_audio_fifo_used(fifo), next_in - next_out);
+        mlt_audio_fifo_clear(fifo);
+        QCOMPARE(mlt_audio_fifo_used(fifo), 0);
+        mlt_audio_fifo_close(fifo);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestAudio)
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+static int destroyed = 0;
+
+static void destroy(void *data)
+{
+    ++destroyed;
+    free(data);
+}
+
+// Put data of a size for an owner, which only serves as a key
+static void put(mlt_cache cache, int owner, int size)
+{
+    mlt_cache_put(cache, (void *) (intptr_t) owner, malloc(size), size, destroy);
+}
+
+// Whether the cache holds data for an owner, which makes it the most recently used
+static bool has(mlt_cache cache, int owner)
+{
+    mlt_cache_item item = mlt_cache_get(cache, (void *) (intptr_t) owner);
+    bool found = item && mlt_cache_item_data(item, NULL);
+    mlt_cache_item_close(item);
+    return found;
+}
+
+static int statistic(mlt_cache cache, const char *name)
+{
+    mlt_properties stats = mlt_properties_new();
+    mlt_cache_get_stats(cache, stats, NULL);
+    int value = mlt_properties_get_int(stats, name);
+    mlt_properties_close(stats);
+    return value;
+}
+
+class TestCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCache() { Factory::init(); }
+
+private Q_SLOTS:
+
+    void init() { destroyed = 0; }
+
+    void ByteLimitEvictsLeastRecentlyUsed()
+    {
+        mlt_cache cache = mlt_cache_init();
+        mlt_cache_set_size(cache, 10);
+        mlt_cache_set_max_bytes(cache, 300);
+        put(cache, 1, 100);
+        put(cache, 2, 100);
+        put(cache, 3, 100);
+        QCOMPARE(statistic(cache, "bytes"), 300);
+        QCOMPARE(destroyed, 0);
+
+        // The fourth item does not fit, so the first goes
+        put(cache, 4, 100);
+        QCOMPARE(destroyed, 1);
+        QCOMPARE(statistic(cache, "count"), 3);
+        QCOMPARE(statistic(cache, "bytes"), 300);
+        QCOMPARE(statistic(cache, "evictions"), 1);
+        QVERIFY(!has(cache, 1));
+
+        // A large item evicts as many as needed
+        put(cache, 5, 200);
+        QCOMPARE(destroyed, 3);
+        QCOMPARE(statistic(cache, "count"), 2);
+        QCOMPARE(statistic(cache, "bytes"), 300);
+        QVERIFY(has(cache, 4));
+        QVERIFY(has(cache, 5));
+
+        // An item larger than the budget is kept on its own
+        put(cache, 6, 1000);
+        QCOMPARE(statistic(cache, "count"), 1);
+        QVERIFY(has(cache, 6));
+
+        // Lowering the budget evicts at once
+        put(cache, 7, 10);
+        mlt_cache_set_max_bytes(cache, 50);
+        QCOMPARE(statistic(cache, "count"), 1);
+        QVERIFY(has(cache, 7));
+        mlt_cache_close(cache);
+        QCOMPARE(destroyed, 7);
+    }
+
+    void GetMakesItemMostRecentlyUsed()
+    {
+        mlt_cache cache = mlt_cache_init();
+        mlt_cache_set_size(cache, 3);
+        put(cache, 1, 10);
+        put(cache, 2, 10);
+        put(cache, 3, 10);
+
+        // Getting the oldest item protects it, so the next oldest goes
+        QVERIFY(has(cache, 1));
+        put(cache, 4, 10);
+        QVERIFY(has(cache, 1));
+        QVERIFY(has(cache, 3));
+        QVERIFY(has(cache, 4));
+        QVERIFY(!has(cache, 2));
+
+        // Putting an item again also makes it the most recently used
+        put(cache, 3, 10);
+        put(cache, 5, 10);
+        QVERIFY(!has(cache, 1));
+        QVERIFY(has(cache, 3));
+        QCOMPARE(statistic(cache, "hits"), 5);
+        QCOMPARE(statistic(cache, "misses"), 2);
+        mlt_cache_close(cache);
+    }
+
+    void HeldItemOutlivesEviction()
+    {
+        mlt_cache cache = mlt_cache_init();
+        mlt_cache_set_size(cache, 1);
+        put(cache, 1, 10);
+        mlt_cache_item item = mlt_cache_get(cache, (void *) 1);
+        QVERIFY(item);
+        void *data = mlt_cache_item_data(item, NULL);
+        QVERIFY(data);
+
+        // Another item evicts the first, but its data stays until the item is closed
+        put(cache, 2, 10);
+        QVERIFY(!has(cache, 1));
+        QCOMPARE(destroyed, 0);
+        QCOMPARE(mlt_cache_item_data(item, NULL), data);
+        mlt_cache_item_close(item);
+        QCOMPARE(destroyed, 1);
+
+        // Replacing the data of a held item keeps the old data until the item is closed
+        item = mlt_cache_get(cache, (void *) 2);
+        data = mlt_cache_item_data(item, NULL);
+        put(cache, 2, 20);
+        QCOMPARE(destroyed, 1);
+        QCOMPARE(mlt_cache_item_data(item, NULL), data);
+        mlt_cache_item_close(item);
+        QCOMPARE(destroyed, 2);
+
+        // The cache keeps the new data
+        item = mlt_cache_get(cache, (void *) 2);
+        int size = 0;
+        QVERIFY(mlt_cache_item_data(item, &size));
+        QCOMPARE(size, 20);
+        mlt_cache_item_close(item);
+        mlt_cache_close(cache);
+        QCOMPARE(destroyed, 3);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestCache)
+
+#include "test_cache.moc"
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+#include <atomic>
+
+#ifndef Q_OS_WIN
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+static std::atomic<int> imagesBeforeAudio(0);
+static std::atomic<int> imagesRendered(0);
+
+static int orderedGetAudio(mlt_frame frame,
+                           void **buffer,
+                           mlt_audio_format *format,
+                           int *frequency,
+                           int *channels,
+                           int *samples)
+{
+    // Make the audio slow enough for an image to overtake it.
+    QTest::qSleep(5);
+    mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "test.audio_done", 1);
+    return mlt_frame_get_audio(frame, buffer, format, frequency, channels, samples);
+}
+
+static int orderedGetImage(mlt_frame frame,
+                           uint8_t **image,
+                           mlt_image_format *format,
+                           int *width,
+                           int *height,
+                           int writable)
+{
+    if (!mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "test.audio_done"))
+        ++imagesBeforeAudio;
+    ++imagesRendered;
+    return mlt_frame_get_image(frame, image, format, width, height, writable);
+}
+
+static int orderedGetFrame(mlt_producer producer, mlt_frame_ptr frame, int)
+{
+    *frame = mlt_frame_init(MLT_PRODUCER_SERVICE(producer));
+    mlt_frame_set_position(*frame, mlt_producer_position(producer));
+    mlt_frame_push_audio(*frame, (void *) orderedGetAudio);
+    mlt_frame_push_get_image(*frame, orderedGetImage);
+    mlt_producer_prepare_next(producer);
+    return 0;
+}
+
+class TestConsumer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestConsumer() { Factory::init(); }
+
+private Q_SLOTS:
+
+    void CbrtsPacesUdpOnLoopback()
+    {
+#ifdef Q_OS_WIN
+        QSKIP("cbrts UDP pacing requires BSD sockets");
+#else
+        const int muxrate = 2000000;
+        const int datagramSize = 7 * 188;
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_sample_aspect(1, 1);
+        profile.set_display_aspect(4, 3);
+        profile.set_frame_rate(25, 1);
+        profile.set_progressive(1);
+        profile.set_explicit(1);
+        Consumer avformat(profile, "avformat");
+        if (!avformat.is_valid())
+            QSKIP("cbrts requires the avformat consumer");
+
+        // Bind the receiver to an ephemeral port on the loopback interface.
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        QVERIFY(fd >= 0);
+        int bufsize = 8 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+        struct timeval timeout = {0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        QCOMPARE(bind(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+        socklen_t addrlen = sizeof(addr);
+        QCOMPARE(getsockname(fd, (struct sockaddr *) &addr, &addrlen), 0);
+
+        std::atomic<bool> done(false);
+        int received = 0;
+        int wrongSize = 0;
+        qint64 first = -1;
+        qint64 last = -1;
+        QElapsedTimer clock;
+        clock.start();
+        std::thread receiver([&] {
+            char buffer[65536];
+            while (!done) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n < 0)
+                    continue;
+                if (n != datagramSize)
+                    ++wrongSize;
+                last = clock.nsecsElapsed();
+                if (first < 0)
+                    first = last;
+                ++received;
+            }
+        });
+
+        Producer producer(profile, "color:red");
+        producer.set("length", 75);
+        producer.set_in_and_out(0, 74);
+        Consumer consumer(profile, "cbrts");
+        QVERIFY(consumer.is_valid());
+        consumer.set("udp.address", "127.0.0.1");
+        consumer.set("udp.port", ntohs(addr.sin_port));
+        consumer.set("udp.rtp", 0);
+        consumer.set("udp.burst", 4);
+        consumer.set("muxrate", muxrate);
+        consumer.set("vcodec", "mpeg2video");
+        consumer.set("vb", "500k");
+        consumer.set("acodec", "mp2");
+        consumer.set("ab", "64k");
+        consumer.set("terminate_on_pause", 1);
+        consumer.connect(producer);
+        consumer.start();
+        QElapsedTimer running;
+        running.start();
+        while (!consumer.is_stopped() && running.elapsed() < 30000)
+            QTest::qSleep(50);
+        QVERIFY(consumer.is_stopped());
+
+        // The statistics are published once per second while sending.
+        qint64 datagrams = consumer.get_int64("udp.stats.datagrams");
+        qint64 batches = consumer.get_int64("udp.stats.batches");
+        qint64 late = consumer.get_int64("udp.stats.late");
+        double jitter = consumer.get_double("udp.stats.jitter");
+        double jitterMean = consumer.get_double("udp.stats.jitter_mean");
+        consumer.stop();
+        QTest::qSleep(200);
+        done = true;
+        receiver.join();
+        close(fd);
+
+        QCOMPARE(wrongSize, 0);
+        QVERIFY(datagrams > 0);
+        QVERIFY(received >= datagrams);
+        QVERIFY(batches <= datagrams);
+        QVERIFY(batches * 4 >= datagrams);
+        QVERIFY(late <= datagrams);
+        QVERIFY(jitterMean >= 0.0);
+        QVERIFY(jitter >= jitterMean);
+
+        // The datagrams arrive at the mux rate rather than as fast as they are encoded.
+        QVERIFY(received > 1);
+        double seconds = (last - first) / 1e9;
+        double rate = (received - 1) * datagramSize * 8.0 / seconds;
+        QVERIFY2(qAbs(rate - muxrate) < muxrate * 0.1,
+                 qPrintable(QString("rate %1 bit/s").arg(rate)));
+#endif
+    }
+
+    void ParallelAudioRendersAudioBeforeImage()
+    {
+        Profile profile;
+        mlt_producer ordered = mlt_producer_new(profile.get_profile());
+        ordered->get_frame = orderedGetFrame;
+        Producer producer(ordered);
+        mlt_producer_close(ordered);
+        producer.set("length", 50);
+        producer.set_in_and_out(0, 49);
+        Consumer consumer(profile, "null");
+        consumer.set("real_time", -4);
+        consumer.set("parallel_audio", 1);
+        consumer.set("terminate_on_pause", 1);
+        consumer.connect(producer);
+        imagesBeforeAudio = 0;
+        imagesRendered = 0;
+        consumer.run();
+        QVERIFY(imagesRendered >= 50);
+        QCOMPARE(imagesBeforeAudio.load(), 0);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestConsumer)
+
+#include "test_consumer.moc"
@@ -18,6 +18,9 @@
 
 #include <mlt++/Mlt.h>
 #include <QtTest>
+
+#include <thread>
+#include <vector>
 using namespace Mlt;
 
 class TestFilter : public QObject
@@ -71,6 +74,254 @@ private Q_SLOTS:
 
         delete frame;
     }
+
+    void ImageConvertYuv422ToRgbaMatchesScalar()
+    {
+        Profile profile("dv_ntsc");
+        Filter filter(profile, "imageconvert");
+        // The width is not a multiple of 8 to cover the unvectorized tail of each line.
+        const int width = 726;
+        const int height = 64;
+        int size = mlt_image_format_size(mlt_image_yuv422, width, height, NULL);
+        uint8_t *image = (uint8_t *) mlt_pool_alloc(size);
+        for (int i = 0; i < size; i++)
+            image[i] = (i * 97 + i / 251) & 0xff;
+
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_frame_set_image(frame, image, size, mlt_pool_release);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "format", mlt_image_yuv422);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "width", width);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "height", height);
+        mlt_filter_process(filter.get_filter(), frame);
+
+        mlt_image_format format = mlt_image_rgba;
+        uint8_t *rgba = NULL;
+        int w = 0;
+        int h = 0;
+        QCOMPARE(mlt_frame_get_image(frame, &rgba, &format, &w, &h, 0), 0);
+        QCOMPARE(format, mlt_image_rgba);
+
+        for (int i = 0; i < width * height; i++) {
+            uint8_t *yuv = image + (i / 2) * 4;
+            int y = yuv[i % 2 * 2];
+            int u = yuv[1];
+            int v = yuv[3];
+            int r, g, b;
+            YUV2RGB_601_SCALED(y, u, v, r, g, b);
+            QCOMPARE(rgba[i * 4], uint8_t(r));
+            QCOMPARE(rgba[i * 4 + 1], uint8_t(g));
+            QCOMPARE(rgba[i * 4 + 2], uint8_t(b));
+            QCOMPARE(rgba[i * 4 + 3], uint8_t(0xff));
+        }
+        mlt_frame_close(frame);
+    }
+
+    void ImageConvertRgbaToYuv422MatchesScalar()
+    {
+        Profile profile("dv_ntsc");
+        Filter filter(profile, "imageconvert");
+        const int width = 726;
+        const int height = 64;
+        int size = mlt_image_format_size(mlt_image_rgba, width, height, NULL);
+        uint8_t *image = (uint8_t *) mlt_pool_alloc(size);
+        for (int i = 0; i < size; i++)
+            image[i] = (i * 97 + i / 251) & 0xff;
+
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_frame_set_image(frame, image, size, mlt_pool_release);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "format", mlt_image_rgba);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "width", width);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "height", height);
+        mlt_filter_process(filter.get_filter(), frame);
+
+        mlt_image_format format = mlt_image_yuv422;
+        uint8_t *yuv = NULL;
+        int w = 0;
+        int h = 0;
+        QCOMPARE(mlt_frame_get_image(frame, &yuv, &format, &w, &h, 0), 0);
+        QCOMPARE(format, mlt_image_yuv422);
+        uint8_t *alpha = mlt_frame_get_alpha(frame);
+        QVERIFY(alpha != NULL);
+
+        for (int i = 0; i < width * height; i += 2) {
+            uint8_t *p = image + i * 4;
+            int y0, u0, v0, y1, u1, v1;
+            RGB2YUV_601_SCALED(p[0], p[1], p[2], y0, u0, v0);
+            RGB2YUV_601_SCALED(p[4], p[5], p[6], y1, u1, v1);
+            QCOMPARE(yuv[i * 2], uint8_t(y0));
+            QCOMPARE(yuv[i * 2 + 1], uint8_t((u0 + u1) >> 1));
+            QCOMPARE(yuv[i * 2 + 2], uint8_t(y1));
+            QCOMPARE(yuv[i * 2 + 3], uint8_t((v0 + v1) >> 1));
+            QCOMPARE(alpha[i], p[3]);
+            QCOMPARE(alpha[i + 1], p[7]);
+        }
+        mlt_frame_close(frame);
+    }
+
+    void QtextRendersFromThreadsAndCachesLayout()
+    {
+        if (!qEnvironmentVariableIsSet("DISPLAY") && !qEnvironmentVariableIsSet("WAYLAND_DISPLAY"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        Profile profile("dv_pal");
+        profile.set_width(320);
+        profile.set_height(240);
+        Producer producer(profile, "color:black");
+        Filter filter(profile, "qtext");
+        if (!filter.is_valid())
+            QSKIP("qtext requires the Qt module");
+        filter.set("argument", "Threads share the qtext layout");
+        filter.set("geometry", "0 0 320 240");
+        filter.set("fgcolour", "#ffffffff");
+        filter.set("size", 24);
+
+        auto render = [](Frame *frame, QByteArray *image, bool *cached) {
+            mlt_image_format format = mlt_image_rgba;
+            int width = 320;
+            int height = 240;
+            uint8_t *data = frame->get_image(format, width, height);
+            if (data && format == mlt_image_rgba)
+                *image = QByteArray(reinterpret_cast<const char *>(data),
+                                    mlt_image_format_size(format, width, height, NULL));
+            *cached = frame->get_int("_qtext.cached");
+        };
+
+        // The first frame lays out the text and renders the reference image.
+        QByteArray reference;
+        bool cached = true;
+        Frame *first = producer.get_frame();
+        filter.process(*first);
+        render(first, &reference, &cached);
+        delete first;
+        QVERIFY(!reference.isEmpty());
+        QVERIFY(!cached);
+        QVERIFY(reference.count(char(0xff)) > 0);
+
+        // Every later frame gets the layout from the cache, from whichever thread renders it.
+        const int threadCount = 4;
+        const int framesPerThread = 8;
+        QVector<Frame *> frames;
+        for (int i = 0; i < threadCount * framesPerThread; ++i) {
+            Frame *frame = producer.get_frame();
+            filter.process(*frame);
+            frames << frame;
+        }
+        QVector<QByteArray> images(frames.size());
+        QVector<char> hits(frames.size(), 0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = t; i < frames.size(); i += threadCount) {
+                    bool hit = false;
+                    render(frames[i], &images[i], &hit);
+                    hits[i] = hit;
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (int i = 0; i < frames.size(); ++i) {
+            QVERIFY(hits[i]);
+            QCOMPARE(images[i], reference);
+            delete frames[i];
+        }
+    }
+
+    void AvfilterPoolsOnlyStatelessGraphsAndResetsThem()
+    {
+        Profile profile("dv_pal");
+        const int width = 320;
+        const int height = 240;
+        const int threadCount = 4;
+        const int framesPerThread = 4;
+
+        // A frame with a pattern that blurring changes
+        auto patternFrame = [&]() {
+            int size = mlt_image_format_size(mlt_image_rgba, width, height, NULL);
+            uint8_t *image = (uint8_t *) mlt_pool_alloc(size);
+            for (int i = 0; i < size; i++) {
+                int x = i / 4 % width;
+                int y = i / 4 / width;
+                image[i] = (i % 4 == 3 || (x / 8 + y / 8) % 2) ? 0xff : 0;
+            }
+            mlt_frame frame = mlt_frame_init(NULL);
+            mlt_frame_set_image(frame, image, size, mlt_pool_release);
+            mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "format", mlt_image_rgba);
+            mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "width", width);
+            mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "height", height);
+            mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "progressive", 1);
+            return frame;
+        };
+        auto render = [&](mlt_frame frame) {
+            mlt_image_format format = mlt_image_rgba;
+            uint8_t *image = NULL;
+            int w = width;
+            int h = height;
+            QByteArray bytes;
+            if (!mlt_frame_get_image(frame, &image, &format, &w, &h, 0) && image
+                && format == mlt_image_rgba)
+                bytes = QByteArray(reinterpret_cast<const char *>(image),
+                                   mlt_image_format_size(format, w, h, NULL));
+            mlt_frame_close(frame);
+            return bytes;
+        };
+        auto reference = [&](const char *radius) {
+            Filter filter(profile, "avfilter.boxblur");
+            filter.set("av.luma_radius", radius);
+            mlt_frame frame = patternFrame();
+            mlt_filter_process(filter.get_filter(), frame);
+            return render(frame);
+        };
+        // Render frames through a filter on several threads at once
+        auto renderOnThreads = [&](Filter &filter) {
+            QVector<mlt_frame> frames;
+            for (int i = 0; i < threadCount * framesPerThread; ++i) {
+                mlt_frame frame = patternFrame();
+                mlt_properties_set_position(MLT_FRAME_PROPERTIES(frame), "_position", i);
+                mlt_filter_process(filter.get_filter(), frame);
+                frames << frame;
+            }
+            QVector<QByteArray> images(frames.size());
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t] {
+                    for (int i = t; i < frames.size(); i += threadCount)
+                        images[i] = render(frames[i]);
+                });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            return images;
+        };
+
+        Filter filter(profile, "avfilter.boxblur");
+        if (!filter.is_valid())
+            QSKIP("avfilter.boxblur requires the avformat module with avfilter");
+        filter.set("av.luma_radius", "1");
+        QByteArray small = reference("1");
+        QByteArray large = reference("6");
+        QVERIFY(!small.isEmpty());
+        QVERIFY(small != large);
+
+        // Frames pass through pooled graphs and match a serial render
+        for (auto &image : renderOnThreads(filter))
+            QCOMPARE(image, small);
+        int graphs = filter.get_int("_avfilter.graphs");
+        QVERIFY(graphs >= 1 && graphs <= threadCount);
+
+        // Changing an option resets the pooled graphs before their next use
+        filter.set("av.luma_radius", "6");
+        for (auto &image : renderOnThreads(filter))
+            QCOMPARE(image, large);
+        QVERIFY(filter.get_int("_avfilter.graphs") <= threadCount);
+
+        // A filter that is not listed as stateless is never pooled
+        Filter stateful(profile, "avfilter.tmix");
+        QVERIFY(stateful.is_valid());
+        stateful.set("av.frames", "2");
+        for (auto &image : renderOnThreads(stateful))
+            QVERIFY(!image.isEmpty());
+        QCOMPARE(stateful.get_int("_avfilter.graphs"), 0);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestFilter)
@@ -18,6 +18,8 @@
 
 #include <mlt++/Mlt.h>
 #include <QtTest>
+
+#include <algorithm>
 using namespace Mlt;
 
 class TestFrame : public QObject
@@ -25,7 +27,7 @@ class TestFrame : public QObject
     Q_OBJECT
 
 public:
-    TestFrame() {}
+    TestFrame() { Factory::init(); }
 
 private Q_SLOTS:
     void FrameConstructorAddsReference()
@@ -93,6 +95,83 @@ private Q_SLOTS:
         QCOMPARE(f1.ref_count(), 2);
         mlt_frame_close(frame);
     }
+
+    void WritingOriginalDoesNotChangeDeepClone()
+    {
+        mlt_frame original = imageFrame(0x10);
+        mlt_frame clone = mlt_frame_clone(original, 1);
+        // Filters often write to an image they did not request writable.
+        std::fill_n(frameImage(original), SIZE, 0x20);
+        std::fill_n(static_cast<uint8_t *>(frameAudio(original)), AUDIO_SIZE, 0x20);
+        QCOMPARE(frameImage(clone)[0], uint8_t(0x10));
+        QCOMPARE(frameImage(clone)[SIZE - 1], uint8_t(0x10));
+        QCOMPARE(static_cast<uint8_t *>(frameAudio(clone))[0], uint8_t(0x10));
+        mlt_frame_close(clone);
+        mlt_frame_close(original);
+    }
+
+    void WritingDeepCloneDoesNotChangeOriginal()
+    {
+        mlt_frame original = imageFrame(0x10);
+        mlt_frame first = mlt_frame_clone(original, 1);
+        mlt_frame second = mlt_frame_clone(original, 1);
+        std::fill_n(frameImage(first), SIZE, 0x20);
+        std::fill_n(static_cast<uint8_t *>(frameAudio(first)), AUDIO_SIZE, 0x20);
+        QCOMPARE(frameImage(original)[0], uint8_t(0x10));
+        QCOMPARE(frameImage(second)[SIZE - 1], uint8_t(0x10));
+        QCOMPARE(static_cast<uint8_t *>(frameAudio(original))[0], uint8_t(0x10));
+        QCOMPARE(static_cast<uint8_t *>(frameAudio(second))[0], uint8_t(0x10));
+        mlt_frame_close(second);
+        mlt_frame_close(first);
+        mlt_frame_close(original);
+    }
+
+private:
+    static const int WIDTH = 4;
+    static const int HEIGHT = 2;
+    static const int SIZE = WIDTH * HEIGHT * 3;
+    static const int SAMPLES = 16;
+    static const int AUDIO_SIZE = SAMPLES * 2 * sizeof(int16_t);
+
+    mlt_frame imageFrame(uint8_t value)
+    {
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        uint8_t *image = static_cast<uint8_t *>(mlt_pool_alloc(SIZE));
+        std::fill_n(image, SIZE, value);
+        mlt_frame_set_image(frame, image, SIZE, mlt_pool_release);
+        mlt_properties_set_int(properties, "format", mlt_image_rgb);
+        mlt_properties_set_int(properties, "width", WIDTH);
+        mlt_properties_set_int(properties, "height", HEIGHT);
+        uint8_t *audio = static_cast<uint8_t *>(mlt_pool_alloc(AUDIO_SIZE));
+        std::fill_n(audio, AUDIO_SIZE, value);
+        mlt_frame_set_audio(frame, audio, mlt_audio_s16, AUDIO_SIZE, mlt_pool_release);
+        mlt_properties_set_int(properties, "audio_frequency", 48000);
+        mlt_properties_set_int(properties, "audio_channels", 2);
+        mlt_properties_set_int(properties, "audio_samples", SAMPLES);
+        return frame;
+    }
+
+    uint8_t *frameImage(mlt_frame frame)
+    {
+        mlt_image_format format = mlt_image_rgb;
+        int width = WIDTH;
+        int height = HEIGHT;
+        uint8_t *image = NULL;
+        mlt_frame_get_image(frame, &image, &format, &width, &height, 0);
+        return image;
+    }
+
+    void *frameAudio(mlt_frame frame)
+    {
+        mlt_audio_format format = mlt_audio_s16;
+        int frequency = 48000;
+        int channels = 2;
+        int samples = SAMPLES;
+        void *audio = NULL;
+        mlt_frame_get_audio(frame, &audio, &format, &frequency, &channels, &samples);
+        return audio;
+    }
 };
 
 QTEST_APPLESS_MAIN(TestFrame)
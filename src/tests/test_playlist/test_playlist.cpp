@@ -263,6 +263,80 @@ private Q_SLOTS:
         delete pp2;
         delete pp3;
     }
+
+    void ClipIndexAtFollowsEdits()
+    {
+        Playlist pl(profile);
+        Producer p(profile, "noise");
+        QVERIFY(p.is_valid());
+        // Lengths: 10, 5 (blank), 20, 30
+        pl.append(p, 0, 9);
+        pl.append(p, 0, 19);
+        pl.append(p, 0, 29);
+        pl.insert_blank(1, 4);
+        QCOMPARE(pl.count(), 4);
+        QCOMPARE(pl.get_clip_index_at(9), 0);
+        QCOMPARE(pl.get_clip_index_at(10), 1);
+        QCOMPARE(pl.get_clip_index_at(15), 2);
+        QCOMPARE(pl.get_clip_index_at(34), 2);
+        QCOMPARE(pl.get_clip_index_at(35), 3);
+        QCOMPARE(pl.get_clip_index_at(64), 3);
+        QCOMPARE(pl.get_clip_index_at(65), 4);
+        QCOMPARE(pl.clip_start(3), 35);
+
+        // Lengths: 10, 5, 5, 30
+        pl.resize_clip(2, 0, 4);
+        QCOMPARE(pl.get_clip_index_at(20), 3);
+        QCOMPARE(pl.clip_start(3), 20);
+
+        // Lengths: 30, 10, 5, 5
+        pl.move(3, 0);
+        QCOMPARE(pl.get_clip_index_at(29), 0);
+        QCOMPARE(pl.get_clip_index_at(30), 1);
+        QCOMPARE(pl.get_clip_index_at(45), 3);
+        QCOMPARE(pl.clip_start(3), 45);
+
+        // Lengths: 30, 5, 5
+        pl.remove(1);
+        QCOMPARE(pl.get_clip_index_at(30), 1);
+        QCOMPARE(pl.get_clip_index_at(35), 2);
+        QCOMPARE(pl.clip_start(3), 40);
+    }
+
+    void PrefetchKeepsFrames()
+    {
+        Playlist pl(profile);
+        Producer *red = new Producer(profile, "color:red");
+        Producer *blue = new Producer(profile, "color:blue");
+        QVERIFY(red->is_valid());
+        QVERIFY(blue->is_valid());
+        pl.append(*red, 0, 9);
+        pl.append(*blue, 0, 9);
+        pl.append(*red, 0, 9);
+        // Only the playlist holds blue, so it is prefetched; red is shared and is not.
+        delete red;
+        delete blue;
+        pl.set("prefetch", 5);
+        pl.set_speed(1);
+        for (int i = 0; i < pl.get_playtime(); i++) {
+            Frame *frame = pl.get_frame();
+            QVERIFY(frame);
+            QCOMPARE(frame->get_position(), i);
+            mlt_image_format format = mlt_image_rgb;
+            int width = profile.width();
+            int height = profile.height();
+            uint8_t *image = frame->get_image(format, width, height);
+            QVERIFY(image);
+            if (i / 10 == 1) {
+                QVERIFY(image[0] < 0x10);
+                QVERIFY(image[2] > 0xf0);
+            } else {
+                QVERIFY(image[0] > 0xf0);
+                QVERIFY(image[2] < 0x10);
+            }
+            delete frame;
+        }
+    }
 };
 
 QTEST_APPLESS_MAIN(TestPlaylist)
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Read a statistic of the pool in bytes
+static qint64 statistic(const char *name)
+{
+    mlt_properties stats = mlt_properties_new();
+    mlt_pool_get_stats(stats);
+    qint64 value = mlt_properties_get_int64(stats, name);
+    mlt_properties_close(stats);
+    return value;
+}
+
+class TestPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPool() { Factory::init(); }
+
+private Q_SLOTS:
+    void AllocReleaseAcrossThreads()
+    {
+        const int threadCount = 8;
+        const int rounds = 2000;
+        const qint64 used = statistic("used");
+        std::atomic<int> corrupt(0);
+
+        // Blocks handed from one thread to another and released there
+        std::mutex lock;
+        std::vector<std::pair<unsigned char *, int>> handed;
+
+        // A block nobody else wrote to still holds the value of its owner
+        auto release = [&](unsigned char *block, int size) {
+            for (int i = 0; i < size; i++) {
+                if (block[i] != block[0]) {
+                    corrupt++;
+                    break;
+                }
+            }
+            mlt_pool_release(block);
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < rounds; i++) {
+                    int size = 100 + (i * 37 + t * 101) % 20000;
+                    unsigned char *block = (unsigned char *) mlt_pool_alloc(size);
+                    memset(block, t, size);
+                    if (i % 3) {
+                        release(block, size);
+                    } else {
+                        std::lock_guard<std::mutex> guard(lock);
+                        handed.emplace_back(block, size);
+                    }
+
+                    // Release a block another thread may have allocated
+                    std::pair<unsigned char *, int> other(nullptr, 0);
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (handed.size() > 1) {
+                            other = handed.front();
+                            handed.erase(handed.begin());
+                        }
+                    }
+                    if (other.first)
+                        release(other.first, other.second);
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto &block : handed)
+            release(block.first, block.second);
+        // This thread keeps the blocks it released last for itself
+        mlt_pool_purge();
+
+        QCOMPARE(corrupt.load(), 0);
+        // The blocks that exited threads kept for themselves are back in the pool
+        QCOMPARE(statistic("used"), used);
+    }
+
+    void ThreadExitReturnsItsBlocks()
+    {
+        const int size = 1000;
+        const int blocks = 4;
+        const qint64 used = statistic("used");
+        std::mutex lock;
+        std::condition_variable changed;
+        bool released = false;
+        bool done = false;
+
+        std::thread thread([&]() {
+            std::vector<void *> allocated;
+            for (int i = 0; i < blocks; i++)
+                allocated.push_back(mlt_pool_alloc(size));
+            for (auto block : allocated)
+                mlt_pool_release(block);
+            std::unique_lock<std::mutex> guard(lock);
+            released = true;
+            changed.notify_all();
+            changed.wait(guard, [&]() { return done; });
+        });
+
+        // The released blocks stay with the thread while it runs
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return released; });
+        }
+        QVERIFY(statistic("used") > used);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done = true;
+            changed.notify_all();
+        }
+        thread.join();
+
+        // They return to the pool when it exits
+        QCOMPARE(statistic("used"), used);
+        const qint64 allocated = statistic("allocated");
+        std::vector<void *> reused;
+        for (int i = 0; i < blocks; i++)
+            reused.push_back(mlt_pool_alloc(size));
+        QCOMPARE(statistic("allocated"), allocated);
+        for (auto block : reused)
+            mlt_pool_release(block);
+    }
+
+    void PurgeFreesIdleBlocks()
+    {
+        const int size = 50000;
+        void *held = mlt_pool_alloc(size);
+        std::vector<void *> idle;
+        for (int i = 0; i < 10; i++)
+            idle.push_back(mlt_pool_alloc(size));
+        for (auto block : idle)
+            mlt_pool_release(block);
+        QVERIFY(statistic("allocated") > statistic("used"));
+
+        // Only the blocks in use remain, including the calling thread's own
+        mlt_pool_purge();
+        QCOMPARE(statistic("allocated"), statistic("used"));
+        QVERIFY(statistic("used") >= size);
+        memset(held, 0, size);
+        mlt_pool_release(held);
+
+        mlt_pool_purge();
+        QCOMPARE(statistic("allocated"), statistic("used"));
+    }
+};
+
+QTEST_APPLESS_MAIN(TestPool)
+
+#include "test_pool.moc"
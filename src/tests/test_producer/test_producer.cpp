@@ -16,17 +16,20 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
 #include <QString>
+#include <QTemporaryDir>
+#include <QVector>
 #include <QtTest>
 
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
-#include <QString>
-#include <QtTest>
-
-#include <mlt++/Mlt.h>
-using namespace Mlt;
+#include <thread>
+#include <vector>
 
 class TestProducer : public QObject
 {
@@ -37,6 +40,33 @@ public:
 
 private Q_SLOTS:
 
+    // This runs first so that the loader loads its dictionary and normalizers on the threads.
+    void LoaderCreatesProducersOnThreads()
+    {
+        Profile profile;
+        const int threadCount = 8;
+        std::vector<int> valid(threadCount, 0);
+        std::vector<int> filters(threadCount, -1);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t] {
+                Producer producer(profile, "color:red");
+                valid[t] = producer.is_valid();
+                filters[t] = producer.filter_count();
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        Producer serial(profile, "color:red");
+        QVERIFY(serial.is_valid());
+        QVERIFY(serial.filter_count() > 0);
+        for (int t = 0; t < threadCount; ++t) {
+            QVERIFY(valid[t]);
+            QCOMPARE(filters[t], serial.filter_count());
+        }
+    }
+
     void DefaultConstructorIsInvalid()
     {
         Producer p;
@@ -59,6 +89,403 @@ private Q_SLOTS:
 
         delete cutService;
     }
+
+    void AvformatMetadataCacheSavesLoadsAndInvalidates()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        QString cacheDir = dir.filePath("cache");
+        QVERIFY(QDir().mkpath(cacheDir));
+
+        // Write a short clip to probe
+        Producer color(profile, "color:red");
+        color.set_in_and_out(0, 24);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("the metadata cache requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(color);
+        writer.run();
+        qputenv("MLT_AVFORMAT_METADATA_DIR", cacheDir.toUtf8());
+
+        // Probing the file saves its properties
+        int length;
+        {
+            Producer first(profile, "avformat", media.toUtf8().constData());
+            QVERIFY(first.is_valid());
+            length = first.get_length();
+            QCOMPARE(length, 25);
+        }
+        QStringList files = QDir(cacheDir).entryList({"*.mltmeta"}, QDir::Files);
+        QCOMPARE(files.size(), 1);
+
+        // The next producer takes its properties from the cache file
+        QFile cache(QDir(cacheDir).filePath(files[0]));
+        QVERIFY(cache.open(QIODevice::ReadOnly));
+        QString yaml = QString::fromUtf8(cache.readAll());
+        cache.close();
+        yaml.replace(QRegularExpression("\\n  length: [^\\n]*"), "\n  length: 7");
+        QVERIFY(cache.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        cache.write(yaml.toUtf8());
+        cache.close();
+        {
+            Producer second(profile, "avformat", media.toUtf8().constData());
+            QVERIFY(second.is_valid());
+            QCOMPARE(second.get_length(), 7);
+        }
+
+        // Changing the file invalidates the cache file
+        QFile file(media);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(60),
+                                 QFileDevice::FileModificationTime));
+        file.close();
+        {
+            Producer third(profile, "avformat", media.toUtf8().constData());
+            QVERIFY(third.is_valid());
+            QCOMPARE(third.get_length(), length);
+        }
+        QCOMPARE(QDir(cacheDir).entryList({"*.mltmeta"}, QDir::Files).size(), 2);
+        qunsetenv("MLT_AVFORMAT_METADATA_DIR");
+    }
+
+    void XmlProbeThreadsMatchSerialLoad()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        Producer color(profile, "color:red");
+        color.set_in_and_out(0, 24);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("probing on threads requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(color);
+        writer.run();
+
+        // A playlist of several producers of the clip, each with its own in point
+        QString xml = "<mlt>";
+        for (int i = 0; i < 6; ++i)
+            xml += QString("<producer id=\"p%1\" in=\"%1\" out=\"24\">"
+                           "<property name=\"resource\">%2</property>"
+                           "<property name=\"mlt_service\">avformat</property></producer>")
+                       .arg(i)
+                       .arg(media.toHtmlEscaped());
+        xml += "<playlist id=\"main\">";
+        for (int i = 0; i < 6; ++i)
+            xml += QString("<entry producer=\"p%1\"/>").arg(i);
+        xml += "</playlist></mlt>";
+        QString project = dir.filePath("project.mlt");
+        QFile file(project);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(xml.toUtf8());
+        file.close();
+
+        Producer serial(profile, "xml", project.toUtf8().constData());
+        Producer parallel(profile,
+                          "xml",
+                          (project + "?probe_threads=4").toUtf8().constData());
+        QVERIFY(serial.is_valid());
+        QVERIFY(parallel.is_valid());
+        QCOMPARE(parallel.get_playtime(), serial.get_playtime());
+        Playlist serialList(serial);
+        Playlist parallelList(parallel);
+        QVERIFY(serialList.is_valid());
+        QVERIFY(parallelList.is_valid());
+        QCOMPARE(parallelList.count(), 6);
+        QCOMPARE(parallelList.count(), serialList.count());
+        for (int i = 0; i < serialList.count(); ++i) {
+            Producer *a = serialList.get_clip(i);
+            Producer *b = parallelList.get_clip(i);
+            QVERIFY(a && b);
+            QCOMPARE(b->get_in(), a->get_in());
+            QCOMPARE(b->get_length(), a->get_length());
+            QCOMPARE(b->parent().get_int("video_index"), a->parent().get_int("video_index"));
+            QCOMPARE(b->parent().filter_count(), a->parent().filter_count());
+            delete a;
+            delete b;
+        }
+    }
+
+    void AvformatProbeCacheMatchesColdProbe()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        QString copy = dir.filePath("copy.nut");
+        Producer noise(profile, "noise");
+        noise.set_in_and_out(0, 24);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("the probe cache requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("acodec", "pcm_s16le");
+        writer.set("frequency", 48000);
+        writer.set("channels", 2);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(noise);
+        writer.run();
+        QVERIFY(QFile::copy(media, copy));
+
+        // The second producer of a file takes its stream information from the cache
+        Producer first(profile, "avformat", media.toUtf8().constData());
+        Producer cached(profile, "avformat", media.toUtf8().constData());
+        QVERIFY(first.is_valid());
+        QVERIFY(cached.is_valid());
+        QVERIFY(cached.get_int("_probe_cached"));
+
+        // A copy was never probed, so its producer probes it
+        Producer cold(profile, "avformat", copy.toUtf8().constData());
+        QVERIFY(cold.is_valid());
+        QVERIFY(!cold.get_int("_probe_cached"));
+
+        QCOMPARE(cached.get_int("meta.media.nb_streams"), 2);
+        QCOMPARE(cached.get_length(), cold.get_length());
+        QCOMPARE(cached.get_int("seekable"), cold.get_int("seekable"));
+        QCOMPARE(cached.get_int("audio_index"), cold.get_int("audio_index"));
+        QCOMPARE(cached.get_int("video_index"), cold.get_int("video_index"));
+        int count = 0;
+        for (int i = 0; i < cold.count(); ++i) {
+            QString name = cold.get_name(i);
+            if (name.startsWith("meta.media.")) {
+                QCOMPARE(QString(cached.get(name.toUtf8().constData())), QString(cold.get(i)));
+                ++count;
+            }
+        }
+        for (int i = 0; i < cached.count(); ++i)
+            count -= QString(cached.get_name(i)).startsWith("meta.media.");
+        QCOMPARE(count, 0);
+    }
+
+    void AvformatDecodeAheadMatchesLinearDecode()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        Producer noise(profile, "noise");
+        noise.set_in_and_out(0, 49);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("decoding ahead requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(noise);
+        writer.run();
+
+        Producer plain(profile, "avformat", media.toUtf8().constData());
+        Producer ahead(profile, "avformat", media.toUtf8().constData());
+        QVERIFY(plain.is_valid());
+        QVERIFY(ahead.is_valid());
+        ahead.set("read_ahead", 8);
+        ahead.set("decode_ahead", 4);
+        auto image = [](Producer &producer) {
+            Frame *frame = producer.get_frame();
+            mlt_image_format format = mlt_image_rgba;
+            int width = 320;
+            int height = 240;
+            const uint8_t *data = frame->get_image(format, width, height);
+            QByteArray bytes(reinterpret_cast<const char *>(data), data ? width * height * 4 : 0);
+            delete frame;
+            return bytes;
+        };
+
+        // Play both producers linearly and compare every frame
+        for (int i = 0; i < 50; ++i) {
+            QByteArray expected = image(plain);
+            QVERIFY(!expected.isEmpty());
+            QCOMPARE(image(ahead), expected);
+            int depth = ahead.get_int("_decode_ahead.depth");
+            QVERIFY(depth >= 0 && depth <= 4);
+            QVERIFY(ahead.get_int("_read_ahead.depth") <= 8);
+        }
+
+        // A seek drops what was decoded ahead and decoding continues from there
+        plain.seek(10);
+        ahead.seek(10);
+        for (int i = 10; i < 20; ++i)
+            QCOMPARE(image(ahead), image(plain));
+    }
+
+    void AvformatReversePlaybackCrossesGops()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.mkv");
+        Producer noise(profile, "noise");
+        noise.set_in_and_out(0, 29);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("reverse playback requires the avformat module");
+        // Groups of pictures of 8 frames, so playing back 30 frames crosses several
+        writer.set("vcodec", "mpeg2video");
+        writer.set("g", 8);
+        writer.set("bf", 2);
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(noise);
+        writer.run();
+
+        auto image = [](Producer &producer, int &position) {
+            Frame *frame = producer.get_frame();
+            position = frame->get_position();
+            mlt_image_format format = mlt_image_rgba;
+            int width = 320;
+            int height = 240;
+            const uint8_t *data = frame->get_image(format, width, height);
+            QByteArray bytes(reinterpret_cast<const char *>(data), data ? width * height * 4 : 0);
+            delete frame;
+            return bytes;
+        };
+
+        // Decode every frame forwards for reference
+        Producer forward(profile, "avformat", media.toUtf8().constData());
+        QVERIFY(forward.is_valid());
+        QVERIFY(forward.get_length() >= 30);
+        QVector<QByteArray> expected;
+        for (int i = 0; i < 30; ++i) {
+            int position;
+            expected << image(forward, position);
+            QCOMPARE(position, i);
+            QVERIFY(!expected.last().isEmpty());
+        }
+
+        // Play backwards with room for all frames and with room for only a few
+        for (int budget : {0, 320 * 240 * 2 * 3}) {
+            Producer reverse(profile, "avformat", media.toUtf8().constData());
+            QVERIFY(reverse.is_valid());
+            if (budget)
+                reverse.set("reverse_cache_bytes", budget);
+            reverse.seek(29);
+            reverse.set_speed(-1);
+            for (int i = 29; i >= 0; --i) {
+                int position;
+                QByteArray actual = image(reverse, position);
+                QCOMPARE(position, i);
+                QVERIFY(actual == expected[i]);
+            }
+        }
+    }
+
+    void AvformatReusesSwscaleContexts()
+    {
+        Profile profile;
+        profile.set_width(320);
+        profile.set_height(240);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        Producer noise(profile, "noise");
+        noise.set_in_and_out(0, 29);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("converting images requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("pix_fmt", "yuv422p");
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(noise);
+        writer.run();
+
+        Producer producer(profile, "avformat", media.toUtf8().constData());
+        QVERIFY(producer.is_valid());
+        auto convert = [&](int first, int count, mlt_image_format format) {
+            for (int i = first; i < first + count; ++i) {
+                producer.seek(i);
+                Frame *frame = producer.get_frame();
+                int width = 320;
+                int height = 240;
+                QVERIFY(frame->get_image(format, width, height) != nullptr);
+                delete frame;
+            }
+        };
+
+        // The first frame builds the context and the next frames reuse it
+        convert(0, 1, mlt_image_rgba);
+        int builds = producer.get_int("_sws_builds");
+        QVERIFY(builds > 0);
+        convert(1, 9, mlt_image_rgba);
+        QCOMPARE(producer.get_int("_sws_builds"), builds);
+
+        // Another format builds its own contexts, sliced ones for YUV 4:2:2
+        convert(10, 1, mlt_image_yuv422);
+        QVERIFY(producer.get_int("_sws_builds") > builds);
+        builds = producer.get_int("_sws_builds");
+        convert(11, 9, mlt_image_yuv422);
+        QCOMPARE(producer.get_int("_sws_builds"), builds);
+        convert(20, 1, mlt_image_yuv420p);
+        QVERIFY(producer.get_int("_sws_builds") > builds);
+        builds = producer.get_int("_sws_builds");
+        convert(21, 4, mlt_image_yuv420p);
+        QCOMPARE(producer.get_int("_sws_builds"), builds);
+
+        // Going back to RGBA finds its context still cached
+        convert(25, 5, mlt_image_rgba);
+        QCOMPARE(producer.get_int("_sws_builds"), builds);
+    }
+
+    void AvformatDecodeAndConvertBenchmark()
+    {
+        Profile profile;
+        profile.set_width(1280);
+        profile.set_height(720);
+        profile.set_frame_rate(25, 1);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString media = dir.filePath("clip.nut");
+        Producer noise(profile, "noise");
+        noise.set_in_and_out(0, 49);
+        Consumer writer(profile, "avformat", media.toUtf8().constData());
+        if (!writer.is_valid())
+            QSKIP("converting images requires the avformat module");
+        writer.set("vcodec", "ffv1");
+        writer.set("pix_fmt", "yuv420p");
+        writer.set("an", 1);
+        writer.set("terminate_on_pause", 1);
+        writer.connect(noise);
+        writer.run();
+
+        Producer producer(profile, "avformat", media.toUtf8().constData());
+        QVERIFY(producer.is_valid());
+        producer.set("noimagecache", 1);
+        QBENCHMARK {
+            producer.seek(0);
+            for (int i = 0; i < 50; ++i) {
+                Frame *frame = producer.get_frame();
+                mlt_image_format format = i % 2 ? mlt_image_yuv422 : mlt_image_rgba;
+                int width = 1280;
+                int height = 720;
+                frame->get_image(format, width, height);
+                delete frame;
+            }
+        }
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProducer)
@@ -423,6 +423,20 @@ private Q_SLOTS:
         QCOMPARE(p.get("new key"), "value");
     }
 
+    void RenamePropertyKeepsOthers()
+    {
+        Properties p;
+        for (int i = 0; i < 100; i++)
+            p.set(QByteArray("key").append(QByteArray::number(i)).constData(), i);
+        p.rename("key50", "new key");
+        QVERIFY(p.get("key50") == 0);
+        QCOMPARE(p.get_int("new key"), 50);
+        for (int i = 0; i < 100; i++) {
+            if (i != 50)
+                QCOMPARE(p.get_int(QByteArray("key").append(QByteArray::number(i)).constData()), i);
+        }
+    }
+
     void SequenceDetected()
     {
         Properties p;
@@ -1510,6 +1524,43 @@ private Q_SLOTS:
         QCOMPARE(p.get_int("foo"), 123);
         QCOMPARE(p.get_double("foo"), 123.4);
     }
+
+    void ManyPropertiesLookup()
+    {
+        Properties p;
+        const int count = 5000;
+        for (int i = 0; i < count; i++)
+            p.set(QByteArray("meta.").append(QByteArray::number(i)).constData(), i);
+        QCOMPARE(p.count(), count);
+        for (int i = 0; i < count; i++)
+            QCOMPARE(p.get_int(QByteArray("meta.").append(QByteArray::number(i)).constData()), i);
+        QVERIFY(p.get("meta.") == 0);
+        QVERIFY(p.get("meta.5000") == 0);
+    }
+
+    void LookupBenchmark_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+    }
+
+    void LookupBenchmark()
+    {
+        QFETCH(int, count);
+        Properties p;
+        p.set("width", 1920);
+        for (int i = 0; i < count; i++)
+            p.set(QByteArray("meta.").append(QByteArray::number(i)).constData(), i);
+        int width = 0;
+        QBENCHMARK
+        {
+            width = p.get_int("width");
+        }
+        QCOMPARE(width, 1920);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProperties)
@@ -98,6 +98,69 @@ private Q_SLOTS:
         delete service;
     }
 
+    void SnapshotKeepsValuesOfFrame()
+    {
+        Profile profile;
+        Filter filter(profile, "resize");
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_rect rect = {1.0, 2.0, 3.0, 4.0, 0.123456789};
+        filter.set("double", 0.123456789);
+        filter.set("rect", rect);
+        filter.set("anim", "0=0;10=100");
+        filter.set("data", &profile, 0);
+
+        mlt_properties snapshot = mlt_service_snapshot(filter.get_service(), frame);
+        QCOMPARE(mlt_service_get_snapshot(filter.get_service(), frame), snapshot);
+        filter.set("double", 1.0);
+        filter.set("anim", "0=0;10=200");
+
+        QCOMPARE(mlt_properties_get_double(snapshot, "double"), 0.123456789);
+        QCOMPARE(mlt_properties_get_rect(snapshot, "rect").o, 0.123456789);
+        QCOMPARE(mlt_properties_anim_get_double(snapshot, "anim", 5, 10), 50.0);
+        QVERIFY(!mlt_properties_get_data(snapshot, "data", NULL));
+
+        // Without a snapshot, the service supplies its properties
+        mlt_frame other = mlt_frame_init(NULL);
+        QCOMPARE(mlt_service_get_snapshot(filter.get_service(), other), filter.get_properties());
+        mlt_frame_close(other);
+        mlt_frame_close(frame);
+    }
+
+    void SnapshotIsSharedUntilPropertiesChange()
+    {
+        Profile profile;
+        Filter filter(profile, "resize");
+        filter.set("anim", "0=0;10=100");
+        mlt_frame first = mlt_frame_init(NULL);
+        mlt_frame second = mlt_frame_init(NULL);
+
+        // Frames share the snapshot and its parsed animation
+        mlt_properties snapshot = mlt_service_snapshot(filter.get_service(), first);
+        QCOMPARE(mlt_properties_anim_get_double(snapshot, "anim", 5, 10), 50.0);
+        mlt_animation animation = mlt_properties_get_animation(snapshot, "anim");
+        QVERIFY(animation);
+        QCOMPARE(mlt_service_snapshot(filter.get_service(), second), snapshot);
+        QCOMPARE(mlt_properties_anim_get_double(snapshot, "anim", 2, 10), 20.0);
+        QCOMPARE(mlt_properties_get_animation(snapshot, "anim"), animation);
+        QCOMPARE(mlt_properties_get_data(snapshot, "_profile", NULL), (void *) profile.get_profile());
+
+        // The snapshot outlives the frame that took it
+        mlt_frame_close(first);
+        QCOMPARE(mlt_properties_anim_get_double(snapshot, "anim", 5, 10), 50.0);
+
+        // A change, even with events blocked, makes the next frame take a new snapshot
+        filter.block();
+        filter.set("anim", "0=0;10=200");
+        filter.unblock();
+        mlt_frame third = mlt_frame_init(NULL);
+        mlt_properties changed = mlt_service_snapshot(filter.get_service(), third);
+        QVERIFY(changed != snapshot);
+        QCOMPARE(mlt_properties_anim_get_double(changed, "anim", 5, 10), 100.0);
+        QCOMPARE(mlt_properties_anim_get_double(snapshot, "anim", 5, 10), 50.0);
+        mlt_frame_close(second);
+        mlt_frame_close(third);
+    }
+
 private:
     Repository *repo;
 };
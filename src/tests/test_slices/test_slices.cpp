@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// What one run of slices saw
+struct SlicesRun
+{
+    int count;                             // the number of slices of the pool
+    std::vector<std::atomic<int>> slices;  // how often each slice ran
+    std::vector<std::thread::id> owners;   // the thread that used each id
+    std::vector<std::atomic<int>> claimed; // whether an id was used
+    std::atomic<int> badIds;               // ids out of range or used by two threads
+    int nested;                            // the number of slices of a run nested in each slice
+
+    SlicesRun(int jobs, int nested = 0)
+        : count(mlt_slices_count_normal())
+        , slices(jobs)
+        , owners(count)
+        , claimed(count)
+        , badIds(0)
+        , nested(nested)
+    {}
+};
+
+static int recordSlice(int id, int idx, int jobs, void *cookie)
+{
+    SlicesRun *run = static_cast<SlicesRun *>(cookie);
+    if (id < 0 || id >= run->count) {
+        ++run->badIds;
+    } else if (!run->claimed[id].exchange(1)) {
+        run->owners[id] = std::this_thread::get_id();
+    } else if (run->owners[id] != std::this_thread::get_id()) {
+        ++run->badIds;
+    }
+    if (run->nested > 0) {
+        SlicesRun inner(run->nested);
+        mlt_slices_run_normal(run->nested, recordSlice, &inner);
+        for (auto &slice : inner.slices)
+            if (slice != 1)
+                ++run->badIds;
+        run->badIds += inner.badIds;
+    } else {
+        // Give other threads the chance to join the run
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    ++run->slices[idx];
+    return 0;
+}
+
+class TestSlices : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSlices() { Factory::init(); }
+
+private Q_SLOTS:
+
+    void RunProcessesEverySliceOnce()
+    {
+        SlicesRun run(4 * mlt_slices_count_normal() + 1);
+        mlt_slices_run_normal(run.slices.size(), recordSlice, &run);
+        for (auto &slice : run.slices)
+            QCOMPARE(slice.load(), 1);
+        QCOMPARE(run.badIds.load(), 0);
+    }
+
+    void ConcurrentRunsGiveEachThreadItsOwnId()
+    {
+        const int callers = 4;
+        std::vector<SlicesRun *> runs;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < callers; ++i)
+            runs.push_back(new SlicesRun(4 * mlt_slices_count_normal()));
+        for (int i = 0; i < callers; ++i) {
+            threads.emplace_back([&runs, i] {
+                for (int repeat = 0; repeat < 20; ++repeat) {
+                    SlicesRun run(runs[i]->slices.size());
+                    mlt_slices_run_normal(run.slices.size(), recordSlice, &run);
+                    for (auto &slice : run.slices)
+                        runs[i]->slices[&slice - &run.slices[0]] += slice;
+                    runs[i]->badIds += run.badIds;
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto run : runs) {
+            for (auto &slice : run->slices)
+                QCOMPARE(slice.load(), 20);
+            QCOMPARE(run->badIds.load(), 0);
+            delete run;
+        }
+    }
+
+    void NestedRunsGiveEachThreadItsOwnId()
+    {
+        SlicesRun run(2 * mlt_slices_count_normal(), mlt_slices_count_normal() + 1);
+        mlt_slices_run_normal(run.slices.size(), recordSlice, &run);
+        for (auto &slice : run.slices)
+            QCOMPARE(slice.load(), 1);
+        QCOMPARE(run.badIds.load(), 0);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestSlices)
+
+#include "test_slices.moc"
@@ -402,6 +402,171 @@ private Q_SLOTS:
         QCOMPARE(t.count(), 1);
         QCOMPARE(filter.get_track(), 0);
     }
+
+    void ParallelTracksMatchSerial()
+    {
+        QList<QByteArray> results[2];
+        for (int parallel = 0; parallel < 2; parallel++) {
+            Tractor t(profile);
+            Producer p1(profile, "color:red");
+            Producer p2(profile, "tone");
+            Producer p3(profile, "color:#8000ff00");
+            t.set_track(p1, 0);
+            t.set_track(p2, 1);
+            t.set_track(p3, 2);
+            Transition composite(profile, "composite");
+            composite.set("geometry", "10%/10%:50%x50%");
+            t.plant_transition(composite, 0, 2);
+            Transition mix(profile, "mix");
+            mix.set("always_active", 1);
+            t.plant_transition(mix, 0, 1);
+            t.set("parallel_tracks", parallel);
+            for (int i = 0; i < 10; i++) {
+                Frame *frame = t.get_frame();
+                mlt_image_format format = mlt_image_rgba;
+                int width = profile.width();
+                int height = profile.height();
+                const uint8_t *image = frame->get_image(format, width, height);
+                QVERIFY(image != nullptr);
+                // The two tracks with images are rendered ahead once their requests repeat
+                if (parallel && i >= 2)
+                    QCOMPARE(frame->get_int("_parallel_tracks.image"), 2);
+                results[parallel] << QByteArray((const char *) image, width * height * 4);
+                mlt_audio_format audio_format = mlt_audio_s16;
+                int frequency = 48000;
+                int channels = 2;
+                int samples = 1920;
+                const int16_t *audio = (int16_t *) frame->get_audio(audio_format,
+                                                                   frequency,
+                                                                   channels,
+                                                                   samples);
+                QVERIFY(audio != nullptr);
+                results[parallel] << QByteArray((const char *) audio, samples * channels * 2);
+                delete frame;
+            }
+        }
+        QCOMPARE(results[1].size(), results[0].size());
+        for (int i = 0; i < results[0].size(); i++)
+            QVERIFY(results[1][i] == results[0][i]);
+    }
+
+    void ParallelTracksRenderMispredictedTracksAgain()
+    {
+        QList<QByteArray> results[2];
+        for (int parallel = 0; parallel < 2; parallel++) {
+            Tractor t(profile);
+            Producer p1(profile, "color:red");
+            Producer p2(profile, "color:#8000ff00");
+            t.set_track(p1, 0);
+            t.set_track(p2, 1);
+            // The request of the top track repeats, then changes at frame 6
+            Transition composite(profile, "composite");
+            composite.set("geometry", "0=10%/10%:50%x50%;5=10%/10%:50%x50%;6=0%/0%:25%x25%");
+            t.plant_transition(composite, 0, 1);
+            t.set("parallel_tracks", parallel);
+            for (int i = 0; i < 10; i++) {
+                Frame *frame = t.get_frame();
+                mlt_image_format format = mlt_image_rgba;
+                int width = profile.width();
+                int height = profile.height();
+                const uint8_t *image = frame->get_image(format, width, height);
+                QVERIFY(image != nullptr);
+                if (parallel && i == 6)
+                    QCOMPARE(frame->get_int("_parallel_tracks.image"), 2);
+                results[parallel] << QByteArray((const char *) image, width * height * 4);
+                delete frame;
+            }
+        }
+        QCOMPARE(results[1].size(), results[0].size());
+        for (int i = 0; i < results[0].size(); i++)
+            QVERIFY(results[1][i] == results[0][i]);
+    }
+
+    void AudioBusSumsTracks()
+    {
+        Tractor t(profile);
+        Producer low(profile, "tone");
+        low.set("frequency", 300);
+        low.set("level", -20);
+        Producer high(profile, "tone");
+        high.set("frequency", 500);
+        high.set("level", -20);
+        t.set_track(low, 0);
+        t.set_track(high, 1);
+        t.set("audio_bus", 1);
+
+        QByteArray bus = floatAudio(t);
+        QByteArray first = floatAudio(low);
+        QByteArray second = floatAudio(high);
+        QVERIFY(!bus.isEmpty());
+        QCOMPARE(bus.size(), first.size());
+        const float *sum = (const float *) bus.constData();
+        const float *a = (const float *) first.constData();
+        const float *b = (const float *) second.constData();
+        for (int i = 0; i < bus.size() / 4; i++)
+            QVERIFY(qAbs(sum[i] - (a[i] + b[i])) < 1e-6f);
+    }
+
+    void AudioBusAppliesGainAndMap()
+    {
+        Tractor t(profile);
+        Producer tone(profile, "tone");
+        t.set_track(tone, 0);
+        t.set("audio_bus", 1);
+        t.set("audio_bus.gain.0", 0.5);
+        t.set("audio_bus.map.0", "-1,0");
+
+        QByteArray bus = floatAudio(t);
+        QByteArray track = floatAudio(tone);
+        QVERIFY(!bus.isEmpty());
+        QCOMPARE(bus.size(), track.size());
+        const float *out = (const float *) bus.constData();
+        const float *in = (const float *) track.constData();
+        // The right channel goes to the left and the left channel is dropped
+        for (int i = 0; i < SAMPLES; i++) {
+            QCOMPARE(out[i], 0.5f * in[SAMPLES + i]);
+            QCOMPARE(out[SAMPLES + i], 0.0f);
+        }
+    }
+
+    void AudioBusRampsAnimatedGain()
+    {
+        Tractor t(profile);
+        Producer tone(profile, "tone");
+        t.set_track(tone, 0);
+        t.set("audio_bus", 1);
+        t.set("audio_bus.gain.0", "0=0;1=1");
+
+        // The gain ramps from its value at the previous frame
+        QByteArray bus = floatAudio(t, 1);
+        QByteArray track = floatAudio(tone, 1);
+        QVERIFY(!bus.isEmpty());
+        QCOMPARE(bus.size(), track.size());
+        const float *out = (const float *) bus.constData();
+        const float *in = (const float *) track.constData();
+        QCOMPARE(out[0], 0.0f);
+        for (int i = 0; i < SAMPLES; i++)
+            QVERIFY(qAbs(out[i] - float(i) / SAMPLES * in[i]) < 1e-6f);
+    }
+
+private:
+    static const int SAMPLES = 1920;
+
+    QByteArray floatAudio(Producer &producer, int position = 0)
+    {
+        producer.seek(position);
+        Frame *frame = producer.get_frame();
+        mlt_audio_format format = mlt_audio_float;
+        int frequency = 48000;
+        int channels = 2;
+        int samples = SAMPLES;
+        void *audio = frame->get_audio(format, frequency, channels, samples);
+        QByteArray result;
+        if (audio && format == mlt_audio_float && samples == SAMPLES && channels == 2)
+            result = QByteArray((const char *) audio, samples * channels * 4);
+        delete frame;
+        return result;
+    }
 };
 
 QTEST_APPLESS_MAIN(TestTractor)